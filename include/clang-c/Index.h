@@ -21,6 +21,7 @@
 #include <stdio.h>
 
 #include "clang-c/Platform.h"
+#include "clang-c/CXCompilationDatabase.h"
 #include "clang-c/CXString.h"
 
 /**
@@ -32,7 +33,7 @@
  * compatible, thus CINDEX_VERSION_MAJOR is expected to remain stable.
  */
 #define CINDEX_VERSION_MAJOR 0
-#define CINDEX_VERSION_MINOR 9
+#define CINDEX_VERSION_MINOR 18
 
 #define CINDEX_VERSION_ENCODE(major, minor) ( \
       ((major) * 10000)                       \
@@ -274,6 +275,29 @@ CINDEX_LINKAGE void clang_CXIndex_setGlobalOptions(CXIndex, unsigned options);
  */
 CINDEX_LINKAGE unsigned clang_CXIndex_getGlobalOptions(CXIndex);
 
+/**
+ * \brief Sets the directory in which \c clang_parseTranslationUnit() caches
+ * the translation units it parses.
+ *
+ * Once set, a translation unit that parsed without any diagnostics is saved
+ * to the cache, keyed by its command line, working directory and parsing
+ * options. Parsing the same translation unit again loads it from the cache,
+ * deserializing declarations only as they are needed, provided that the
+ * contents of every file it was built from are unchanged.
+ *
+ * The cache is not used when there are unsaved files, or when any of
+ * \c CXTranslationUnit_PrecompiledPreamble,
+ * \c CXTranslationUnit_CacheCompletionResults,
+ * \c CXTranslationUnit_Incomplete or \c CXTranslationUnit_ForSerialization
+ * is passed, since a translation unit loaded from the cache behaves like one
+ * created with \c clang_createTranslationUnit() and cannot be reparsed.
+ *
+ * \param Path The cache directory, which is created if needed. Passing NULL
+ * or an empty string disables the cache.
+ */
+CINDEX_LINKAGE void
+clang_CXIndex_setTranslationUnitCacheDirectory(CXIndex, const char *Path);
+
 /**
  * \defgroup CINDEX_FILES File manipulation routines
  *
@@ -1095,7 +1119,38 @@ enum CXTranslationUnit_Flags {
    * included into the set of code completions returned from this translation
    * unit.
    */
-  CXTranslationUnit_IncludeBriefCommentsInCodeCompletion = 0x80
+  CXTranslationUnit_IncludeBriefCommentsInCodeCompletion = 0x80,
+
+  /**
+   * \brief Used to indicate that a precompiled preamble that has gone out of
+   * date should be rebuilt on a background thread.
+   *
+   * Without this flag, \c clang_reparseTranslationUnit() rebuilds the
+   * preamble as soon as it notices that one of the headers it includes has
+   * changed, which can take a while. With it, the reparse starts rebuilding
+   * the preamble in the background and returns at once, keeping the current
+   * AST and the old preamble, which code completion also keeps using.
+   * Reparses made while the rebuild is in progress do the same; the first
+   * one after it has finished switches to the new preamble and parses the
+   * latest unsaved files.
+   *
+   * This option only has an effect together with
+   * \c CXTranslationUnit_PrecompiledPreamble.
+   */
+  CXTranslationUnit_AsynchronousPreambleRebuild = 0x100,
+
+  /**
+   * \brief Used to indicate that \c clang_getCursor() should answer queries
+   * from an index of cursor extents.
+   *
+   * The index for a file is built by walking every cursor in it the first
+   * time \c clang_getCursor() is called for a location in that file. Later
+   * queries for that file only look at the cursors whose extents contain the
+   * location, which makes them much faster on large files, at the cost of
+   * the memory used by the index. The index is discarded when the
+   * translation unit is reparsed.
+   */
+  CXTranslationUnit_IndexCursorExtents = 0x200
 };
 
 /**
@@ -1265,7 +1320,18 @@ enum CXReparse_Flags {
   /**
    * \brief Used to indicate that no special reparsing options are needed.
    */
-  CXReparse_None = 0x0
+  CXReparse_None = 0x0,
+
+  /**
+   * \brief Used to indicate that a precompiled preamble that is being rebuilt
+   * in the background should be waited for, so that this reparse uses it.
+   *
+   * This option only has an effect if the translation unit was parsed with
+   * \c CXTranslationUnit_AsynchronousPreambleRebuild. It mostly exists so
+   * that tests can tell deterministically when the new preamble is adopted;
+   * an interactive client would normally not wait.
+   */
+  CXReparse_WaitForPreambleRebuild = 0x1
 };
  
 /**
@@ -1323,6 +1389,33 @@ CINDEX_LINKAGE int clang_reparseTranslationUnit(CXTranslationUnit TU,
                                           struct CXUnsavedFile *unsaved_files,
                                                 unsigned options);
 
+/**
+ * \brief Suspend a translation unit in order to free most of the memory
+ * associated with it.
+ *
+ * Suspending a translation unit frees its AST, including function bodies,
+ * and its preprocessor state, including the detailed preprocessing record.
+ * Its precompiled preamble, cached code-completion results and diagnostics
+ * are kept. This is intended for clients that keep many translation units
+ * open but only work with a few of them at a time.
+ *
+ * Suspending a translation unit invalidates all cursors, tokens and source
+ * locations that refer into it. Any call that takes the translation unit and
+ * needs its AST or preprocessor, such as \c clang_getCursor(),
+ * \c clang_getInclusions() or \c clang_isFileMultipleIncludeGuarded(),
+ * rebuilds it by reparsing the main file with the same unsaved files as
+ * before. Calling \c clang_reparseTranslationUnit() resumes it as well.
+ * Resuming invalidates \c CXFile handles as well, although the call that
+ * resumes may still be given one; retrieve them again with
+ * \c clang_getFile() afterwards. Diagnostics can be retrieved without
+ * resuming, but resuming replaces them, which invalidates \c CXDiagnostic
+ * objects retrieved before it.
+ *
+ * \returns Non-zero if the translation unit was suspended, zero otherwise,
+ * for example because it was loaded from an AST file.
+ */
+CINDEX_LINKAGE unsigned clang_suspendTranslationUnit(CXTranslationUnit TU);
+
 /**
   * \brief Categorizes how memory is being used by a translation unit.
   */
@@ -4722,6 +4815,36 @@ CXCodeCompleteResults *clang_codeCompleteAt(CXTranslationUnit TU,
                                             unsigned num_unsaved_files,
                                             unsigned options);
 
+/**
+ * \brief Perform code completion at a given location, keeping only the
+ * results that match the text typed so far.
+ *
+ * This behaves like \c clang_codeCompleteAt(), except that results whose
+ * typed text does not start with \p typed_prefix, ignoring case, are dropped
+ * while the results are computed rather than afterwards, which saves building
+ * completion strings for them.
+ *
+ * \param typed_prefix The identifier text the user has typed so far at the
+ * completion location, or NULL or the empty string to keep all results.
+ *
+ * \param max_results The maximum number of results to return, or zero for
+ * no limit. When there are more, those that match \p typed_prefix
+ * case-sensitively are preferred, then those with the best priority.
+ *
+ * The other parameters and the result are as for \c clang_codeCompleteAt().
+ */
+CINDEX_LINKAGE
+CXCodeCompleteResults *
+clang_codeCompleteAtWithPrefix(CXTranslationUnit TU,
+                               const char *complete_filename,
+                               unsigned complete_line,
+                               unsigned complete_column,
+                               struct CXUnsavedFile *unsaved_files,
+                               unsigned num_unsaved_files,
+                               unsigned options,
+                               const char *typed_prefix,
+                               unsigned max_results);
+
 /**
  * \brief Sort the code-completion results in case-insensitive alphabetical 
  * order.
@@ -4732,6 +4855,37 @@ CXCodeCompleteResults *clang_codeCompleteAt(CXTranslationUnit TU,
 CINDEX_LINKAGE
 void clang_sortCodeCompletionResults(CXCompletionResult *Results,
                                      unsigned NumResults);
+
+/**
+ * \brief Narrow a set of code-completion results down to those that match
+ * the text typed so far, best matches first.
+ *
+ * This lets a client perform code completion once, at the start of the
+ * token being typed, and then update the results on each keystroke without
+ * going back to the parser. Only when the cursor leaves the token do the
+ * results need to be recomputed with \c clang_codeCompleteAt().
+ *
+ * A result matches if the characters of \p Filter appear in its typed text
+ * in order, ignoring case, though not necessarily next to each other.
+ * Results whose typed text starts with \p Filter, or whose matched
+ * characters start words or match case exactly, rank higher; ties are
+ * broken by completion priority.
+ *
+ * The results are filtered in place: \c Results->Results is reordered and
+ * \c Results->NumResults updated. Each call filters from the full set of
+ * results that \c clang_codeCompleteAt() produced, so the filter may
+ * shrink as well as grow; when it grows, only the current results are
+ * examined.
+ *
+ * \param Results The code-completion results to filter.
+ *
+ * \param Filter The text typed so far. An empty filter keeps every result.
+ *
+ * \returns the number of results that remain.
+ */
+CINDEX_LINKAGE
+unsigned clang_codeCompleteFilterResults(CXCodeCompleteResults *Results,
+                                         const char *Filter);
   
 /**
  * \brief Free the given set of code-completion results.
@@ -5407,6 +5561,36 @@ CINDEX_LINKAGE CXIndexAction clang_IndexAction_create(CXIndex CIdx);
  */
 CINDEX_LINKAGE void clang_IndexAction_dispose(CXIndexAction);
 
+/**
+ * \brief Merge the set of already-indexed regions saved by
+ * \c clang_IndexAction_saveSkippedBodies() into the given index action.
+ *
+ * When indexing with \c CXIndexOpt_SkipParsedBodiesInSession, function bodies
+ * in header regions that were indexed earlier in the session are skipped.
+ * Loading a saved set lets a new session (e.g. after the client restarts)
+ * skip the bodies that a previous session already indexed. Regions are tied
+ * to the identity and modification time of their file, so entries for files
+ * that have changed since they were saved are ignored.
+ *
+ * \param path The file previously written by
+ * \c clang_IndexAction_saveSkippedBodies().
+ *
+ * \returns 0 on success, non-zero if the file could not be read or is not a
+ * valid skipped-bodies file.
+ */
+CINDEX_LINKAGE int clang_IndexAction_loadSkippedBodies(CXIndexAction,
+                                                       const char *path);
+
+/**
+ * \brief Save the set of regions indexed so far in the given index action,
+ * so that a later session can load it with
+ * \c clang_IndexAction_loadSkippedBodies().
+ *
+ * \returns 0 on success, non-zero if an error occurred.
+ */
+CINDEX_LINKAGE int clang_IndexAction_saveSkippedBodies(CXIndexAction,
+                                                       const char *path);
+
 typedef enum {
   /**
    * \brief Used to indicate that no special indexing options are needed.
@@ -5483,6 +5667,42 @@ CINDEX_LINKAGE int clang_indexSourceFile(CXIndexAction,
                                          CXTranslationUnit *out_TU,
                                          unsigned TU_options);
 
+/**
+ * \brief Index a set of compile commands, running up to \p num_threads
+ * translation units concurrently.
+ *
+ * Each command is indexed as if by #clang_indexSourceFile, with its working
+ * directory taken from the command rather than from the current directory of
+ * the process. All translation units share the index action, so with
+ * \c CXIndexOpt_SkipParsedBodiesInSession a body parsed by one worker is
+ * skipped by the others.
+ *
+ * \param client_data An array of \p num_threads pointers. The callbacks
+ * invoked while a worker indexes a translation unit receive that worker's
+ * entry, so a client can keep per-thread state without locking. Callbacks
+ * of different workers may run at the same time.
+ *
+ * \param num_threads The number of worker threads; 0 is treated as 1. On
+ * hosts without thread support the commands are indexed one after the other.
+ *
+ * \param commands The compile commands to index, e.g. from
+ * #clang_CompilationDatabase_getAllCompileCommands.
+ *
+ * \param results If non-NULL, an array with one entry per command that
+ * receives the value #clang_indexSourceFile would have returned for it.
+ *
+ * \returns 0 if every command was indexed successfully, non-zero otherwise.
+ */
+CINDEX_LINKAGE int clang_indexSourceFiles(CXIndexAction,
+                                          CXClientData *client_data,
+                                          unsigned num_threads,
+                                          IndexerCallbacks *index_callbacks,
+                                          unsigned index_callbacks_size,
+                                          unsigned index_options,
+                                          CXCompileCommands commands,
+                                          unsigned TU_options,
+                                          int *results);
+
 /**
  * \brief Index the given translation unit via callbacks implemented through
  * #IndexerCallbacks.
@@ -35,6 +35,7 @@
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/Support/Allocator.h"
 #include <vector>
@@ -199,6 +200,28 @@ class ASTContext : public RefCountedBase<ASTContext> {
   TemplateTemplateParmDecl *
     getCanonicalTemplateTemplateParmDecl(TemplateTemplateParmDecl *TTP) const;
 
+  /// \brief A list of template arguments shared by every template argument
+  /// list with the same arguments. The arguments follow this object in
+  /// memory.
+  class UniquedTemplateArgs : public llvm::FoldingSetNode {
+    unsigned NumArgs;
+
+  public:
+    explicit UniquedTemplateArgs(unsigned NumArgs) : NumArgs(NumArgs) { }
+
+    const TemplateArgument *getArgs() const {
+      return reinterpret_cast<const TemplateArgument *>(this + 1);
+    }
+
+    void Profile(llvm::FoldingSetNodeID &ID) {
+      Profile(ID, getArgs(), NumArgs);
+    }
+
+    static void Profile(llvm::FoldingSetNodeID &ID,
+                        const TemplateArgument *Args, unsigned NumArgs);
+  };
+  mutable llvm::FoldingSet<UniquedTemplateArgs> UniquedTemplateArgLists;
+
   /// \brief The typedef for the __int128_t type.
   mutable TypedefDecl *Int128Decl;
 
@@ -351,6 +374,27 @@ class ASTContext : public RefCountedBase<ASTContext> {
   /// that value exceeds the bitfield size of ParmVarDeclBits.ParameterIndex.
   typedef llvm::DenseMap<const VarDecl *, unsigned> ParameterIndexTable;
   ParameterIndexTable ParamIndices;  
+
+public:
+  /// \brief The memoized result of a constexpr function call, with the cost
+  /// of evaluating it.
+  struct ConstexprCallResult {
+    APValue Value;
+
+    /// \brief The number of evaluation steps the call took, counting those
+    /// of nested calls, memoized or not.
+    uint64_t Steps;
+
+    /// \brief The depth of the deepest call made while evaluating it, where
+    /// the call itself has depth 1.
+    unsigned Depth;
+  };
+
+private:
+  /// \brief The results of constexpr function calls that have already been
+  /// evaluated, keyed by an encoding of the callee and its arguments which
+  /// is private to the constant evaluator.
+  llvm::StringMap<ConstexprCallResult> ConstexprCallResults;
   
   ImportDecl *FirstLocalImport;
   ImportDecl *LastLocalImport;
@@ -2017,6 +2061,28 @@ public:
   /// \brief Used by ParmVarDecl to retrieve on the side the
   /// index of the parameter when it exceeds the size of the normal bitfield.
   unsigned getParameterIndex(const ParmVarDecl *D) const;
+
+  /// \brief Retrieve the memoized result of a constexpr function call, or
+  /// null if that call has not been evaluated yet.
+  ///
+  /// \param Key An encoding of the callee and argument values, as built by
+  /// the constant evaluator.
+  const ConstexprCallResult *getConstexprCallResult(StringRef Key) const;
+
+  /// \brief Memoize the result of a constexpr function call.
+  void setConstexprCallResult(StringRef Key,
+                              const ConstexprCallResult &Result);
+
+  /// \brief Retrieve storage holding a copy of the given template
+  /// arguments.
+  ///
+  /// The storage is shared with every other caller that passes the very same
+  /// arguments, so that the function template specializations that use one
+  /// argument list only store it once. The
+  /// arguments are compared exactly, without canonicalization, so the copy
+  /// is indistinguishable from the original.
+  const TemplateArgument *getUniquedTemplateArgs(const TemplateArgument *Args,
+                                                 unsigned NumArgs) const;
   
   //===--------------------------------------------------------------------===//
   //                    Statistics
@@ -2063,6 +2129,18 @@ public:
   /// \brief The number of implicitly-declared destructors for which 
   /// declarations were built.
   static unsigned NumImplicitDestructorsDeclared;
+
+  /// \brief The number of constexpr function calls whose result was found
+  /// among the memoized results.
+  static unsigned NumConstexprCallCacheHits;
+
+  /// \brief The number of constexpr function calls that could have been
+  /// memoized but had to be evaluated.
+  static unsigned NumConstexprCallCacheMisses;
+
+  /// \brief The number of requests for uniqued template arguments that found
+  /// an existing copy.
+  static unsigned NumUniquedTemplateArgsReused;
   
 private:
   ASTContext(const ASTContext &) LLVM_DELETED_FUNCTION;
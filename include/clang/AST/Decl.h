@@ -1692,7 +1692,9 @@ public:
   bool isPure() const { return IsPure; }
   void setPure(bool P = true);
 
-  /// Whether this templated function will be late parsed.
+  /// Whether this function will be late parsed: a templated function under
+  /// -fdelayed-template-parsing, or an inline function from a header under
+  /// -fdelayed-inline-function-parsing.
   bool isLateTemplateParsed() const { return IsLateTemplateParsed; }
   void setLateTemplateParsed(bool ILT = true) { IsLateTemplateParsed = ILT; }
 
@@ -167,6 +167,19 @@ public:
                                           const TemplateArgument *Args,
                                           unsigned NumArgs);
 
+  /// \brief Create a new template argument list for the given set of
+  /// template arguments, storing the arguments themselves in memory shared
+  /// with every other such list that has identical arguments.
+  ///
+  /// This is meant for the argument lists of function template
+  /// specializations formed during instantiation, where many function
+  /// templates tend to be specialized for the same arguments. Lists that
+  /// are used as scratch space during template argument deduction must be
+  /// created with CreateCopy.
+  static TemplateArgumentList *CreateShared(ASTContext &Context,
+                                            const TemplateArgument *Args,
+                                            unsigned NumArgs);
+
   /// \brief Construct a new, temporary template argument list on the stack.
   ///
   /// The template argument list does not own the template arguments
@@ -57,11 +57,25 @@ struct Info {
   bool operator!=(const Info &RHS) const { return !(*this == RHS); }
 };
 
+class NameIndex;
+
 /// \brief Holds information about both target-independent and
 /// target-specific builtins, allowing easy queries by clients.
 class Context {
   const Info *TSRecords;
   unsigned NumTSRecords;
+
+  /// \brief Name index over the target-specific builtins, shared with every
+  /// other context for the same target.
+  const NameIndex *TSIndex;
+
+  /// \brief Whether library builtins (those with the 'f' attribute) are
+  /// disabled, as with -fno-builtin.
+  bool NoBuiltins;
+
+  /// \brief Whether Objective-C-only builtins are enabled.
+  bool ObjCBuiltins;
+
 public:
   Context();
 
@@ -71,8 +85,16 @@ public:
   /// \brief Mark the identifiers for all the builtins with their
   /// appropriate builtin ID # and mark any non-portable builtin identifiers as
   /// such.
+  ///
+  /// Builtin identifiers are not entered into \p Table up front.  Instead,
+  /// this context is registered with the table, which asks it for the builtin
+  /// ID of each identifier the first time that identifier is created.
   void InitializeBuiltins(IdentifierTable &Table, const LangOptions& LangOpts);
 
+  /// \brief Return the ID of the builtin with the given name that is enabled
+  /// for the current language, or 0 if there is none.
+  unsigned getBuiltinIDForName(StringRef Name) const;
+
   /// \brief Popular the vector with the names of all of the builtins.
   void GetBuiltinNames(SmallVectorImpl<const char *> &Names,
                        bool NoBuiltins);
@@ -157,6 +179,14 @@ public:
 
 private:
   const Info &GetRecord(unsigned ID) const;
+
+  /// \brief Whether the builtin with the given record is enabled for the
+  /// current language.
+  bool isEnabled(const Info &Record) const {
+    if (NoBuiltins && strchr(Record.Attribute, 'f'))
+      return false;
+    return ObjCBuiltins || Record.builtin_lang != clang::OBJC_LANG;
+  }
 };
 
 }
@@ -36,6 +36,7 @@ namespace clang {
   class SourceLocation;
   class MultiKeywordSelector; // private class used by Selector
   class DeclarationName;      // AST class that stores declaration names
+  namespace Builtin { class Context; }
 
   /// \brief A simple pair of identifier info and location.
   typedef std::pair<IdentifierInfo*, SourceLocation> IdentifierLocPair;
@@ -426,6 +427,14 @@ class IdentifierTable {
 
   IdentifierInfoLookup* ExternalLookup;
 
+  /// \brief The builtin information used to assign builtin IDs to newly
+  /// created identifiers, if any.
+  const Builtin::Context *BuiltinInfo;
+
+  /// \brief Set the builtin ID of the newly-created identifier \p II, if
+  /// \p Name names a builtin.
+  void setBuiltinIDFromName(IdentifierInfo &II, StringRef Name);
+
 public:
   /// \brief Create the identifier table, populating it with info about the
   /// language keywords for the language specified by \p LangOpts.
@@ -441,6 +450,12 @@ public:
   IdentifierInfoLookup *getExternalIdentifierLookup() const {
     return ExternalLookup;
   }
+
+  /// \brief Set the builtin information used to classify identifiers as
+  /// they are created.
+  void setBuiltinInfo(const Builtin::Context *Builtins) {
+    BuiltinInfo = Builtins;
+  }
   
   llvm::BumpPtrAllocator& getAllocator() {
     return HashTable.getAllocator();
@@ -474,6 +489,9 @@ public:
     // contents.
     II->Entry = &Entry;
 
+    if (BuiltinInfo)
+      setBuiltinIDFromName(*II, Name);
+
     return *II;
   }
 
@@ -509,6 +527,9 @@ public:
       // If this is the 'import' contextual keyword, mark it as such.
       if (Name.equals("import"))
         II->setModulesImport(true);
+
+      if (BuiltinInfo)
+        setBuiltinIDFromName(*II, Name);
     }
 
     return *II;
@@ -49,6 +49,7 @@
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <cassert>
+#include <cstring>
 #include <map>
 #include <vector>
 
@@ -381,10 +382,15 @@ namespace SrcMgr {
   ///
   /// SourceManager keeps an array of these objects, and they are uniquely
   /// identified by the FileID datatype.
+  ///
+  /// Macro expansions vastly outnumber files in macro-heavy code, so the
+  /// (larger) FileInfo is kept out of line and only a pointer to it is stored
+  /// here.  The pointer is held in 4-byte-aligned storage so that an entry
+  /// takes 16 bytes rather than 24 on 64-bit hosts.
   class SLocEntry {
     unsigned Offset;   // low bit is set for expansion info.
     union {
-      FileInfo File;
+      unsigned File[sizeof(const FileInfo *) / sizeof(unsigned)];
       ExpansionInfo Expansion;
     };
   public:
@@ -395,7 +401,9 @@ namespace SrcMgr {
 
     const FileInfo &getFile() const {
       assert(isFile() && "Not a file SLocEntry!");
-      return File;
+      const FileInfo *FI;
+      memcpy(&FI, File, sizeof(FI));
+      return *FI;
     }
 
     const ExpansionInfo &getExpansion() const {
@@ -403,10 +411,12 @@ namespace SrcMgr {
       return Expansion;
     }
 
-    static SLocEntry get(unsigned Offset, const FileInfo &FI) {
+    /// \brief Return a file SLocEntry. \p FI must outlive the entry; the
+    /// SourceManager allocates it alongside its content caches.
+    static SLocEntry get(unsigned Offset, const FileInfo *FI) {
       SLocEntry E;
       E.Offset = Offset << 1;
-      E.File = FI;
+      memcpy(E.File, &FI, sizeof(FI));
       return E;
     }
 
@@ -621,6 +631,16 @@ class SourceManager : public RefCountedBase<SourceManager> {
   /// is very common to look up many tokens from the same file.
   mutable FileID LastFileIDLookup;
 
+  /// \brief A small direct-mapped cache of getFileID results, consulted when
+  /// LastFileIDLookup misses.
+  ///
+  /// Slots are selected by the high bits of the queried offset.  Diagnostics,
+  /// the preprocessing record and libclang location queries tend to bounce
+  /// between a handful of files and macro expansions, which this catches
+  /// without falling back to a linear or binary search.
+  enum { FileIDCacheSize = 64, FileIDCacheShift = 6 };
+  mutable FileID FileIDCache[FileIDCacheSize];
+
   /// \brief Holds information for \#line directives.
   ///
   /// This is referenced by indices from SLocEntryTable.
@@ -640,7 +660,7 @@ class SourceManager : public RefCountedBase<SourceManager> {
   FileID PreambleFileID;
 
   // Statistics for -print-stats.
-  mutable unsigned NumLinearScans, NumBinaryProbes;
+  mutable unsigned NumLinearScans, NumBinaryProbes, NumFileIDCacheHits;
 
   // Cache results for the isBeforeInTranslationUnit method.
   mutable IsBeforeInTranslationUnitCache IsBeforeInTUCache;
@@ -754,7 +774,9 @@ public:
   /// \brief Create a new FileID that represents the specified file
   /// being \#included from the specified IncludePosition.
   ///
-  /// This translates NULL into standard input.
+  /// This translates NULL into standard input. Returns an invalid FileID,
+  /// after emitting a diagnostic, if the translation unit has run out of
+  /// source locations.
   FileID createFileID(const FileEntry *SourceFile, SourceLocation IncludePos,
                       SrcMgr::CharacteristicKind FileCharacter,
                       int LoadedID = 0, unsigned LoadedOffset = 0) {
@@ -768,7 +790,9 @@ public:
   /// \brief Create a new FileID that represents the specified memory buffer.
   ///
   /// This does no caching of the buffer and takes ownership of the
-  /// MemoryBuffer, so only pass a MemoryBuffer to this once.
+  /// MemoryBuffer, so only pass a MemoryBuffer to this once. Like
+  /// createFileID, this returns an invalid FileID if the translation unit has
+  /// run out of source locations.
   FileID createFileIDForMemBuffer(const llvm::MemoryBuffer *Buffer,
                       SrcMgr::CharacteristicKind FileCharacter = SrcMgr::C_User,
                                   int LoadedID = 0, unsigned LoadedOffset = 0,
@@ -781,6 +805,9 @@ public:
   /// fact that a token from SpellingLoc should actually be referenced from
   /// ExpansionLoc, and that it represents the expansion of a macro argument
   /// into the function-like macro body.
+  ///
+  /// Returns an invalid location, after emitting a diagnostic, if the
+  /// translation unit has run out of source locations.
   SourceLocation createMacroArgExpansionLoc(SourceLocation Loc,
                                             SourceLocation ExpansionLoc,
                                             unsigned TokLength);
@@ -788,6 +815,9 @@ public:
   /// \brief Return a new SourceLocation that encodes the fact
   /// that a token from SpellingLoc should actually be referenced from
   /// ExpansionLoc.
+  ///
+  /// Returns an invalid location, after emitting a diagnostic, if the
+  /// translation unit has run out of source locations.
   SourceLocation createExpansionLoc(SourceLocation Loc,
                                     SourceLocation ExpansionLocStart,
                                     SourceLocation ExpansionLocEnd,
@@ -1508,6 +1538,19 @@ private:
     return getLoadedSLocEntry(static_cast<unsigned>(-ID - 2), Invalid);
   }
 
+  /// \brief Determine whether \p Size more bytes of local source locations
+  /// are available, without running into the space of loaded entries or
+  /// wrapping around.
+  bool hasLocalSLocSpace(unsigned Size) const {
+    return NextLocalOffset + Size > NextLocalOffset &&
+           NextLocalOffset + Size <= CurrentLoadedOffset;
+  }
+
+  /// \brief Allocate the out-of-line FileInfo for a new file SLocEntry.
+  const SrcMgr::FileInfo *
+  createFileInfo(SourceLocation IncludePos, const SrcMgr::ContentCache *File,
+                 SrcMgr::CharacteristicKind FileCharacter) const;
+
   /// Implements the common elements of storing an expansion info struct into
   /// the SLocEntry table and producing a source location that refers to it.
   SourceLocation createExpansionLocImpl(const SrcMgr::ExpansionInfo &Expansion,
@@ -259,6 +259,34 @@ private:
   /// \brief True if non-system source files should be treated as volatile
   /// (likely to change while trying to use them).
   bool UserFilesAreVolatile : 1;
+
+  /// \brief Whether a preamble invalidated by a change to one of the files
+  /// it includes should be rebuilt on a background thread, rather than
+  /// during the reparse that notices the change.
+  bool AsynchronousPreambleRebuild : 1;
+
+  /// \brief Whether the AST has been thrown away by \c Suspend(), and must be
+  /// rebuilt by \c Resume() or \c Reparse() before it is used again.
+  bool Suspended : 1;
+
+  /// \brief Whether a reparse was put off until the preamble being rebuilt
+  /// in the background is ready, leaving the AST older than the remapped
+  /// files.
+  bool ReparseDeferred : 1;
+
+  /// \brief A precompiled preamble that is being built on a background
+  /// thread.
+  struct BackgroundPreamble;
+
+  /// \brief The preamble being rebuilt in the background, if any.
+  ///
+  /// Until it is ready, \c Reparse() keeps the current AST and leaves the
+  /// reparse to the first call that finds it done.
+  OwningPtr<BackgroundPreamble> PendingPreamble;
+
+  /// \brief The remapped file buffers the current AST was parsed from, kept
+  /// alive while a reparse is deferred.
+  std::vector<const llvm::MemoryBuffer *> BuffersOfDeferredReparse;
  
   /// \brief The language options used when we load an AST file.
   LangOptions ASTFileLangOpts;
@@ -391,6 +419,9 @@ private:
                                const CompilerInvocation &PreambleInvocationIn,
                                                      bool AllowRebuild = true,
                                                         unsigned MaxLines = 0);
+  bool startBackgroundPreamble(const CompilerInvocation &PreambleInvocationIn,
+                               StringRef PreambleText, bool EndsAtStartOfLine,
+                               unsigned MainFileSize, StringRef Key);
   void RealizeTopLevelDeclsFromPreamble();
 
   /// \brief Transfers ownership of the objects (like SourceManager) from
@@ -441,17 +472,59 @@ public:
   bool isUnsafeToFree() const { return UnsafeToFree; }
   void setUnsafeToFree(bool Value) { UnsafeToFree = Value; }
 
+  /// \brief Whether an out-of-date precompiled preamble is rebuilt on a
+  /// background thread.
+  ///
+  /// When enabled, a reparse that finds that a file included by the preamble
+  /// has changed starts building a new preamble in the background. Until it
+  /// is ready, reparses keep the current AST and only record the remapped
+  /// files; the first reparse after that adopts the new preamble and parses
+  /// them.
+  bool getAsynchronousPreambleRebuild() const {
+    return AsynchronousPreambleRebuild;
+  }
+  void setAsynchronousPreambleRebuild(bool Value) {
+    AsynchronousPreambleRebuild = Value;
+  }
+
+  /// \brief Whether a precompiled preamble is being rebuilt in the
+  /// background.
+  bool isPreambleRebuildPending() const { return PendingPreamble.get() != 0; }
+
+  /// \brief Wait for a precompiled preamble that is being rebuilt in the
+  /// background to be finished, so that the next reparse can use it.
+  void waitForPreambleRebuild();
+
   const DiagnosticsEngine &getDiagnostics() const { return *Diagnostics; }
   DiagnosticsEngine &getDiagnostics()             { return *Diagnostics; }
   
   const SourceManager &getSourceManager() const { return *SourceMgr; }
         SourceManager &getSourceManager()       { return *SourceMgr; }
 
-  const Preprocessor &getPreprocessor() const { return *PP; }
-        Preprocessor &getPreprocessor()       { return *PP; }
+  const Preprocessor &getPreprocessor() const {
+    assert(!Suspended && "ASTUnit is suspended, call Resume() first");
+    return *PP;
+  }
+  Preprocessor &getPreprocessor() {
+    assert(!Suspended && "ASTUnit is suspended, call Resume() first");
+    return *PP;
+  }
 
-  const ASTContext &getASTContext() const { return *Ctx; }
-        ASTContext &getASTContext()       { return *Ctx; }
+  const ASTContext &getASTContext() const {
+    assert(!Suspended && "ASTUnit is suspended, call Resume() first");
+    return *Ctx;
+  }
+  ASTContext &getASTContext() {
+    assert(!Suspended && "ASTUnit is suspended, call Resume() first");
+    return *Ctx;
+  }
+
+  /// \brief The language options the translation unit was parsed with. Unlike
+  /// the ASTContext, these are available while the ASTUnit is suspended.
+  const LangOptions &getLangOpts() const {
+    assert(LangOpts && "ASTUnit does not have language options");
+    return *LangOpts;
+  }
 
   void setASTContext(ASTContext *ctx) { Ctx = ctx; }
   void setPreprocessor(Preprocessor *pp);
@@ -784,11 +857,37 @@ public:
   /// \brief Reparse the source files using the same command-line options that
   /// were originally used to produce this translation unit.
   ///
+  /// If the preamble is still being rebuilt in the background, the current
+  /// AST is kept and the reparse is left to a later call; see
+  /// \c getAsynchronousPreambleRebuild().
+  ///
   /// \returns True if a failure occurred that causes the ASTUnit not to
   /// contain any translation-unit information, false otherwise.  
   bool Reparse(RemappedFile *RemappedFiles = 0,
                unsigned NumRemappedFiles = 0);
 
+  /// \brief Free the memory used by the AST, the semantic analysis object and
+  /// the preprocessor, including the preprocessing record.
+  ///
+  /// The precompiled preamble, the cached code-completion results and the
+  /// diagnostics are kept, so that \c Resume() only needs to reparse the main
+  /// file. Nothing that refers into the AST may be used until then.
+  ///
+  /// \returns True if this ASTUnit cannot be suspended, because it was not
+  /// parsed from source, false otherwise.
+  bool Suspend();
+
+  /// \brief Whether the AST has been freed by \c Suspend().
+  bool isSuspended() const { return Suspended; }
+
+  /// \brief Rebuild the AST freed by \c Suspend(), using the same remapped
+  /// files as before. Does nothing if the ASTUnit is not suspended.
+  ///
+  /// \returns True if a failure occurred that causes the ASTUnit not to
+  /// contain any translation-unit information, in which case it stays
+  /// suspended; false otherwise.
+  bool Resume();
+
   /// \brief Perform code completion at the given file, line, and
   /// column within this translation unit.
   ///
@@ -202,6 +202,14 @@ public:
   /// \brief File name of the file that will provide record layouts
   /// (in the format produced by -fdump-record-layouts).
   std::string OverrideRecordLayoutsFile;
+
+  /// \brief File to write a Chrome trace of template instantiations to
+  /// (-ftemplate-profile=), or empty for none.
+  std::string TemplateProfileFile;
+
+  /// \brief The number of templates and specializations to list in the
+  /// template instantiation summary printed to stderr, or zero for none.
+  unsigned TemplateProfileSummarySize;
   
 public:
   FrontendOptions() {
@@ -217,6 +225,7 @@ public:
     ARCMTMigrateEmitARCErrors = 0;
     SkipFunctionBodies = 0;
     ObjCMTAction = ObjCMT_None;
+    TemplateProfileSummarySize = 0;
   }
 
   /// getInputKindForExtension - Return the appropriate input kind for a file
@@ -331,12 +331,61 @@ class Preprocessor : public RefCountedBase<Preprocessor> {
   /// previous macro value.
   llvm::DenseMap<IdentifierInfo*, std::vector<MacroInfo*> > PragmaPushMacroInfo;
 
+  /// \brief The fully-expanded form of an object-like macro whose expansion
+  /// does not depend on the context it is expanded in, so that later uses of
+  /// the macro can replay it instead of expanding it again.
+  struct CachedMacroExpansion {
+    /// \brief A macro that is expanded as part of the cached expansion.
+    /// Node 0 is the cached macro itself; every other node is expanded from a
+    /// token in the replacement list of its parent.
+    struct Node {
+      MacroInfo *MI;
+      unsigned Parent;
+      /// \brief The index of the expanded macro name in the parent's
+      /// replacement list.
+      unsigned NameIndex;
+      /// \brief The offset of the expanded macro name from the start of the
+      /// parent's definition.
+      unsigned NameOffset;
+      SourceLocation DefStart;
+      unsigned DefLength;
+    };
+    SmallVector<Node, 2> Nodes;
+
+    /// \brief The expanded tokens.  Their locations are not meaningful;
+    /// TokenLocs holds the node each token came from and its offset from the
+    /// start of that node's definition.
+    SmallVector<Token, 4> Tokens;
+    SmallVector<std::pair<unsigned, unsigned>, 4> TokenLocs;
+
+    /// \brief The value of MacroDefinitionGeneration when this entry was
+    /// created.
+    unsigned Generation;
+
+    /// \brief Whether we have tried to compute the expansion yet.  The first
+    /// use in a generation only records that the macro was used.
+    bool Computed;
+
+    /// \brief Whether the expansion is context-independent, making Tokens
+    /// valid.
+    bool Valid;
+  };
+
+  /// \brief Cached expansions of object-like macros; see
+  /// getCachedMacroExpansion.
+  llvm::DenseMap<const MacroInfo*, CachedMacroExpansion*> CachedMacroExpansions;
+
+  /// \brief Incremented whenever a macro is defined, undefined or otherwise
+  /// changes visibility, to invalidate CachedMacroExpansions.
+  unsigned MacroDefinitionGeneration;
+
   // Various statistics we track for performance analysis.
   unsigned NumDirectives, NumIncluded, NumDefined, NumUndefined, NumPragma;
   unsigned NumIf, NumElse, NumEndif;
   unsigned NumEnteredSourceFiles, MaxIncludeStackDepth;
   unsigned NumMacroExpanded, NumFnMacroExpanded, NumBuiltinMacroExpanded;
   unsigned NumFastMacroExpanded, NumTokenPaste, NumFastTokenPaste;
+  unsigned NumCachedMacroExpanded;
   unsigned NumSkipped;
 
   /// Predefines - This string is the predefined macros that preprocessor
@@ -1289,6 +1338,25 @@ private:
   /// the macro should not be expanded return true, otherwise return false.
   bool HandleMacroExpandedIdentifier(Token &Tok, MacroInfo *MI);
 
+  /// \brief Return the context-independent expansion of the object-like
+  /// macro \p MI, or null if it has none or it hasn't been computed yet.
+  const CachedMacroExpansion *getCachedMacroExpansion(MacroInfo *MI);
+
+  /// \brief Append the expansion of \p MI, expanded from the macro name
+  /// token \p NameTok in the definition of node \p Parent, to \p Entry.
+  /// Returns false if the expansion depends on its context or is too large
+  /// to cache.
+  bool computeCachedMacroExpansion(CachedMacroExpansion &Entry, MacroInfo *MI,
+                                   unsigned Parent, unsigned NameIndex,
+                                   unsigned NameOffset, const Token &NameTok);
+
+  /// \brief Replay the cached expansion \p Entry of the macro named by
+  /// \p Identifier and return its first token in \p Identifier.  Returns
+  /// false, without changing anything, if the expansion cannot be replayed
+  /// in the current context.
+  bool EnterCachedMacroExpansion(Token &Identifier,
+                                 const CachedMacroExpansion &Entry);
+
   /// \brief Cache macro expanded tokens for TokenLexers.
   //
   /// Works like a stack; a TokenLexer adds the macro expanded tokens that is
@@ -922,6 +922,27 @@ public:
     return CodeCompleteOpts.IncludeBriefComments;
   }
 
+  /// \brief The identifier text typed so far at the completion point. Only
+  /// results whose names start with it (ignoring case) are wanted.
+  StringRef getTypedPrefix() const { return CodeCompleteOpts.TypedPrefix; }
+
+  /// \brief The maximum number of results wanted, or zero for no limit.
+  unsigned getMaxResults() const { return CodeCompleteOpts.MaxResults; }
+
+  /// \brief Whether a result named \p Name matches the typed prefix.
+  bool matchesTypedPrefix(StringRef Name) const;
+
+  /// \brief Drop the results that don't match the typed prefix and, if the
+  /// number of results is limited, all but the best ones.
+  ///
+  /// Results that match the prefix case-sensitively rank first, then
+  /// results with better (lower) priority.
+  ///
+  /// \returns the number of remaining results, which are moved to the front
+  /// of \p Results.
+  unsigned filterResults(CodeCompletionResult *Results,
+                         unsigned NumResults) const;
+
   /// \brief Determine whether the output of this consumer is binary.
   bool isOutputBinary() const { return OutputIsBinary; }
 
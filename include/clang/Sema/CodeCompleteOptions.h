@@ -10,6 +10,8 @@
 #ifndef LLVM_CLANG_SEMA_CODECOMPLETEOPTIONS_H
 #define LLVM_CLANG_SEMA_CODECOMPLETEOPTIONS_H
 
+#include <string>
+
 /// Options controlling the behavior of code completion.
 class CodeCompleteOptions {
 public:
@@ -25,11 +27,18 @@ public:
   ///< Show brief documentation comments in code completion results.
   unsigned IncludeBriefComments : 1;
 
+  ///< Only show results whose name starts with this text, ignoring case.
+  std::string TypedPrefix;
+
+  ///< The maximum number of results to show, best first; 0 for no limit.
+  unsigned MaxResults;
+
   CodeCompleteOptions() :
       IncludeMacros(0),
       IncludeCodePatterns(0),
       IncludeGlobals(1),
-      IncludeBriefComments(0)
+      IncludeBriefComments(0),
+      MaxResults(0)
   { }
 };
 
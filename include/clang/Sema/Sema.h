@@ -40,6 +40,7 @@
 #include "clang/Sema/TypoCorrection.h"
 #include "clang/Sema/Weak.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SetVector.h"
@@ -149,6 +150,7 @@ namespace clang {
   class TemplateArgumentList;
   class TemplateArgumentLoc;
   class TemplateDecl;
+  class TemplateInstantiationProfiler;
   class TemplateParameterList;
   class TemplatePartialOrderingContext;
   class TemplateTemplateParmDecl;
@@ -386,6 +388,19 @@ public:
     OpaqueParser = P;
   }
 
+  /// \brief The member functions whose bodies were left unparsed by
+  /// -fdelayed-inline-function-parsing and that have since been used.
+  ///
+  /// Their bodies are parsed at the end of the translation unit, through the
+  /// LateTemplateParser callback.
+  std::deque<FunctionDecl *> UsedLateParsedFunctions;
+
+  /// \brief Parse the bodies of the functions in UsedLateParsedFunctions.
+  ///
+  /// \returns true if any body was parsed, which may have used further
+  /// functions, vtables or template specializations.
+  bool ParseUsedLateParsedFunctions();
+
   class DelayedDiagnostics;
 
   class DelayedDiagnosticsState {
@@ -725,6 +740,83 @@ public:
   /// \brief The number of SFINAE diagnostics that have been trapped.
   unsigned NumSFINAEErrors;
 
+  /// \brief The number of candidates in the overload sets that overload
+  /// resolution picked a best function from.
+  unsigned NumOverloadCandidates;
+
+  /// \brief The number of those candidates that were viable.
+  unsigned NumViableOverloadCandidates;
+
+  /// \brief The number of overload candidates rejected by a cheap check on
+  /// their parameter types, without building conversion sequences.
+  unsigned NumOverloadCandidatesPrefiltered;
+
+  /// \brief The key of a cached user-defined conversion sequence: the source
+  /// and target types, and the properties of the source expression that the
+  /// conversion depends on.
+  typedef std::pair<std::pair<void *, void *>, unsigned> UserConversionKey;
+
+  /// \brief User-defined conversion sequences computed so far, which are
+  /// expensive to build since they involve overload resolution among
+  /// constructors and conversion functions. The cache is cleared when a
+  /// class that was incomplete while one of them was computed is completed,
+  /// since that can make new conversions possible.
+  llvm::DenseMap<UserConversionKey, ImplicitConversionSequence>
+    UserConversionCache;
+
+  /// \brief The classes that RequireCompleteType() found incomplete while a
+  /// conversion sequence for the cache was computed.
+  llvm::SmallPtrSet<const CXXRecordDecl *, 4> UserConversionIncompleteClasses;
+
+  /// \brief The number of conversion sequences for the cache that are being
+  /// computed right now.
+  unsigned ComputingCachedUserConversions;
+
+  /// \brief The number of user-defined conversion sequences found in, and
+  /// added to, the cache.
+  unsigned NumUserConversionCacheHits, NumUserConversionCacheMisses;
+
+  /// \brief A successful substitution of deduced template arguments into a
+  /// function template, profiled by the function template, its deduced
+  /// template arguments, and the number of them that were explicitly
+  /// specified.
+  struct MemoizedDeduction : public llvm::FastFoldingSetNode {
+    explicit MemoizedDeduction(const llvm::FoldingSetNodeID &ID)
+      : FastFoldingSetNode(ID) { }
+
+    /// \brief The specialization produced.
+    FunctionDecl *Specialization;
+
+    /// \brief The deduced template arguments.
+    TemplateArgumentList *Deduced;
+  };
+
+  /// \brief Substitutions of deduced template arguments into function
+  /// templates that succeeded so far, so that overload resolution in code
+  /// that calls the same function templates with the same argument types
+  /// again and again need not repeat them.
+  ///
+  /// Failures are not memoized: a later declaration, such as the definition
+  /// of a class, a constexpr function, a static data member or an enumeration
+  /// named in the signature, can make them succeed. Nothing declared later
+  /// makes a success fail, so the memo never needs to be cleared.
+  llvm::FoldingSet<MemoizedDeduction> MemoizedDeductions;
+
+  /// \brief Whether substituting into the signature of a function template
+  /// only depends on the template arguments, computed once per template.
+  llvm::DenseMap<FunctionTemplateDecl *, bool> SignatureLookupFree;
+
+  /// \brief Discard every memoized substitution.
+  void clearMemoizedDeductions();
+
+  /// \brief Determine whether substituting into the signature of
+  /// \p FunctionTemplate looks up any names at instantiation, which can find
+  /// declarations that follow an earlier substitution.
+  bool isSignatureLookupFree(FunctionTemplateDecl *FunctionTemplate);
+
+  /// \brief The number of substitutions found in, and added to, the memo.
+  unsigned NumDeductionMemoHits, NumDeductionMemoMisses;
+
   typedef llvm::DenseMap<ParmVarDecl *, SmallVector<ParmVarDecl *, 1> >
     UnparsedDefaultArgInstantiationsMap;
 
@@ -1086,6 +1178,8 @@ public:
                            TypeDiagnoser &Diagnoser);
   bool RequireCompleteType(SourceLocation Loc, QualType T,
                            unsigned DiagID);
+  bool RequireCompleteTypeImpl(SourceLocation Loc, QualType T,
+                               TypeDiagnoser &Diagnoser);
 
   template<typename T1>
   bool RequireCompleteType(SourceLocation Loc, QualType T,
@@ -5450,6 +5544,13 @@ public:
                                   sema::TemplateDeductionInfo &Info,
            SmallVectorImpl<OriginalCallArg> const *OriginalCallArgs = 0);
 
+  TemplateDeductionResult
+  SubstituteDeducedTemplateArguments(FunctionTemplateDecl *FunctionTemplate,
+                      SmallVectorImpl<DeducedTemplateArgument> &Deduced,
+                                     unsigned NumExplicitlySpecified,
+                                     FunctionDecl *&Specialization,
+                                     sema::TemplateDeductionInfo &Info);
+
   TemplateDeductionResult
   DeduceTemplateArguments(FunctionTemplateDecl *FunctionTemplate,
                           TemplateArgumentListInfo *ExplicitTemplateArgs,
@@ -5668,6 +5769,10 @@ public:
   /// therefore, should not be counted as part of the instantiation depth.
   unsigned NonInstantiationEntries;
 
+  /// \brief If non-null, the profiler that is told about every entry pushed
+  /// onto and popped off \c ActiveTemplateInstantiations.
+  TemplateInstantiationProfiler *TemplateProfiler;
+
   /// \brief The last template from which a template instantiation
   /// error or warning was produced.
   ///
@@ -5878,7 +5983,8 @@ public:
   /// variables.
   LocalInstantiationScope *CurrentInstantiationScope;
 
-  /// \brief The number of typos corrected by CorrectTypo.
+  /// \brief The number of typo corrections CorrectTypo attempted that are not
+  /// recorded in UnqualifiedTyposCorrected.
   unsigned TyposCorrected;
 
   typedef llvm::DenseMap<IdentifierInfo *, TypoCorrection>
@@ -5892,6 +5998,19 @@ public:
   /// string represents a keyword.
   UnqualifiedTyposCorrectedMap UnqualifiedTyposCorrected;
 
+  /// \brief A typo, the context named by its nested-name-specifier, and the
+  /// kind of lookup that failed to find it.
+  typedef std::pair<std::pair<IdentifierInfo *, DeclContext *>, unsigned>
+    QualifiedTypoKey;
+
+  /// \brief Typos for which typo correction in the given context, named by
+  /// a nested-name-specifier, found no correction.
+  llvm::DenseSet<QualifiedTypoKey> QualifiedTyposNotCorrected;
+
+  /// \brief The number of typos answered from the caches above, and the
+  /// number not corrected because the spell-checking limit was reached.
+  unsigned NumTypoCorrectionCacheHits, NumTypoCorrectionsOverLimit;
+
   /// \brief Worker object for performing CFG-based warnings.
   sema::AnalysisBasedWarnings AnalysisWarnings;
 
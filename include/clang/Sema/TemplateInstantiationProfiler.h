@@ -0,0 +1,118 @@
+//===- TemplateInstantiationProfiler.h - Template cost profile -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the TemplateInstantiationProfiler class, which measures
+//  the time and memory Sema spends on each template instantiation.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_SEMA_TEMPLATE_INSTANTIATION_PROFILER_H
+#define LLVM_CLANG_SEMA_TEMPLATE_INSTANTIATION_PROFILER_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/DataTypes.h"
+#include <vector>
+
+namespace clang {
+
+class Decl;
+class Sema;
+
+/// \brief Records the cost of every entry that Sema pushes onto its stack of
+/// active template instantiations.
+///
+/// Each entry is timed from the moment it is pushed until it is popped, and
+/// the time and memory spent in the entries it pushes in turn are subtracted
+/// to give its exclusive cost. Costs are totalled per specialization (the
+/// entity being instantiated, such as \c vector<int>) and per template (such
+/// as \c vector). An entry that is already on the stack, as happens with
+/// recursive templates, only adds its inclusive cost once.
+///
+/// The profile can be written as a Chrome trace-event file, which shows the
+/// instantiation stack over time, or summarized as the costliest templates
+/// and specializations.
+class TemplateInstantiationProfiler {
+public:
+  /// \brief The totals for one template or specialization.
+  struct Totals {
+    Totals() : InclusiveTime(0), ExclusiveTime(0), InclusiveMemory(0),
+               ExclusiveMemory(0), Count(0) {}
+
+    double InclusiveTime;
+    double ExclusiveTime;
+    int64_t InclusiveMemory;
+    int64_t ExclusiveMemory;
+    unsigned Count;
+  };
+
+private:
+  Sema &SemaRef;
+
+  /// \brief A completed entry, in the order the entries were pushed.
+  struct Event {
+    unsigned Kind;
+    const Decl *Entity;
+    const Decl *Template;
+    double Start;
+    double Duration;
+    int64_t Memory;
+    unsigned Depth;
+  };
+  std::vector<Event> Events;
+
+  /// \brief An entry that is still on the instantiation stack.
+  struct Frame {
+    unsigned EventIndex;
+    double Start;
+    int64_t StartMemory;
+    double ChildTime;
+    int64_t ChildMemory;
+  };
+  SmallVector<Frame, 16> Stack;
+
+  /// \brief The time at which profiling started, which trace timestamps are
+  /// relative to.
+  double StartTime;
+
+  typedef std::pair<unsigned, const Decl *> SpecializationKey;
+  llvm::DenseMap<SpecializationKey, Totals> Specializations;
+  llvm::DenseMap<const Decl *, Totals> Templates;
+
+  /// \brief How many times each specialization and template is on the stack.
+  llvm::DenseMap<SpecializationKey, unsigned> ActiveSpecializations;
+  llvm::DenseMap<const Decl *, unsigned> ActiveTemplates;
+
+  TemplateInstantiationProfiler(
+      const TemplateInstantiationProfiler &) LLVM_DELETED_FUNCTION;
+  void operator=(const TemplateInstantiationProfiler &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit TemplateInstantiationProfiler(Sema &SemaRef);
+
+  /// \brief Called after Sema pushes a new active template instantiation.
+  void startInstantiation();
+
+  /// \brief Called before Sema pops the innermost active template
+  /// instantiation.
+  void finishInstantiation();
+
+  /// \brief Write the recorded instantiations as a Chrome trace-event file.
+  void writeTrace(raw_ostream &OS) const;
+
+  /// \brief Print the \p N costliest templates and specializations, by
+  /// inclusive time.
+  void printSummary(raw_ostream &OS, unsigned N) const;
+};
+
+}  // end namespace clang
+
+#endif
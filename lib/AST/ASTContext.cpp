@@ -51,6 +51,9 @@ unsigned ASTContext::NumImplicitMoveAssignmentOperators;
 unsigned ASTContext::NumImplicitMoveAssignmentOperatorsDeclared;
 unsigned ASTContext::NumImplicitDestructors;
 unsigned ASTContext::NumImplicitDestructorsDeclared;
+unsigned ASTContext::NumConstexprCallCacheHits;
+unsigned ASTContext::NumConstexprCallCacheMisses;
+unsigned ASTContext::NumUniquedTemplateArgsReused;
 
 enum FloatingRank {
   HalfRank, FloatRank, DoubleRank, LongDoubleRank
@@ -735,6 +738,18 @@ void ASTContext::PrintStats() const {
                << NumImplicitDestructors
                << " implicit destructors created\n";
 
+  if (getLangOpts().CPlusPlus0x)
+    llvm::errs() << NumConstexprCallCacheHits << "/"
+                 << (NumConstexprCallCacheHits + NumConstexprCallCacheMisses)
+                 << " memoized constexpr function calls reused ("
+                 << ConstexprCallResults.size() << " results stored)\n";
+
+  if (getLangOpts().CPlusPlus)
+    llvm::errs() << NumUniquedTemplateArgsReused << "/"
+                 << (NumUniquedTemplateArgsReused +
+                     UniquedTemplateArgLists.size())
+                 << " template argument lists shared an existing copy\n";
+
   if (ExternalSource.get()) {
     llvm::errs() << "\n";
     ExternalSource->PrintStats();
@@ -7572,3 +7587,100 @@ unsigned ASTContext::getParameterIndex(const ParmVarDecl *D) const {
          "ParmIndices lacks entry set by ParmVarDecl");
   return I->second;
 }
+
+const ASTContext::ConstexprCallResult *
+ASTContext::getConstexprCallResult(StringRef Key) const {
+  llvm::StringMap<ConstexprCallResult>::const_iterator I
+    = ConstexprCallResults.find(Key);
+  if (I == ConstexprCallResults.end())
+    return 0;
+  return &I->getValue();
+}
+
+void ASTContext::setConstexprCallResult(StringRef Key,
+                                        const ConstexprCallResult &Result) {
+  ConstexprCallResults[Key] = Result;
+}
+
+/// \brief Add the identity of a template argument to \p ID. Unlike
+/// TemplateArgument::Profile, this distinguishes arguments that are merely
+/// equivalent, such as different expressions with the same value.
+static void ProfileTemplateArgIdentity(llvm::FoldingSetNodeID &ID,
+                                       const TemplateArgument &Arg) {
+  ID.AddInteger(Arg.getKind());
+  switch (Arg.getKind()) {
+  case TemplateArgument::Null:
+    break;
+
+  case TemplateArgument::Type:
+    ID.AddPointer(Arg.getAsType().getAsOpaquePtr());
+    break;
+
+  case TemplateArgument::NullPtr:
+    ID.AddPointer(Arg.getNullPtrType().getAsOpaquePtr());
+    break;
+
+  case TemplateArgument::Declaration:
+    ID.AddPointer(Arg.getAsDecl());
+    ID.AddBoolean(Arg.isDeclForReferenceParam());
+    break;
+
+  case TemplateArgument::Integral:
+    Arg.getAsIntegral().Profile(ID);
+    ID.AddPointer(Arg.getIntegralType().getAsOpaquePtr());
+    break;
+
+  case TemplateArgument::Template:
+    ID.AddPointer(Arg.getAsTemplate().getAsVoidPointer());
+    break;
+
+  case TemplateArgument::TemplateExpansion: {
+    ID.AddPointer(Arg.getAsTemplateOrTemplatePattern().getAsVoidPointer());
+    llvm::Optional<unsigned> NumExpansions = Arg.getNumTemplateExpansions();
+    ID.AddInteger(NumExpansions ? *NumExpansions + 1 : 0);
+    break;
+  }
+
+  case TemplateArgument::Expression:
+    ID.AddPointer(Arg.getAsExpr());
+    break;
+
+  case TemplateArgument::Pack:
+    ID.AddInteger(Arg.pack_size());
+    for (TemplateArgument::pack_iterator P = Arg.pack_begin(),
+                                      PEnd = Arg.pack_end();
+         P != PEnd; ++P)
+      ProfileTemplateArgIdentity(ID, *P);
+    break;
+  }
+}
+
+void ASTContext::UniquedTemplateArgs::Profile(llvm::FoldingSetNodeID &ID,
+                                              const TemplateArgument *Args,
+                                              unsigned NumArgs) {
+  ID.AddInteger(NumArgs);
+  for (unsigned I = 0; I != NumArgs; ++I)
+    ProfileTemplateArgIdentity(ID, Args[I]);
+}
+
+const TemplateArgument *
+ASTContext::getUniquedTemplateArgs(const TemplateArgument *Args,
+                                   unsigned NumArgs) const {
+  llvm::FoldingSetNodeID ID;
+  UniquedTemplateArgs::Profile(ID, Args, NumArgs);
+
+  void *InsertPos = 0;
+  if (UniquedTemplateArgs *Existing
+        = UniquedTemplateArgLists.FindNodeOrInsertPos(ID, InsertPos)) {
+    ++NumUniquedTemplateArgsReused;
+    return Existing->getArgs();
+  }
+
+  void *Mem = Allocate(sizeof(UniquedTemplateArgs) +
+                       NumArgs * sizeof(TemplateArgument));
+  UniquedTemplateArgs *Uniqued = new (Mem) UniquedTemplateArgs(NumArgs);
+  std::uninitialized_copy(Args, Args + NumArgs,
+                          const_cast<TemplateArgument *>(Uniqued->getArgs()));
+  UniquedTemplateArgLists.InsertNode(Uniqued, InsertPos);
+  return Uniqued->getArgs();
+}
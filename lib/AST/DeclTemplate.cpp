@@ -662,6 +662,15 @@ TemplateArgumentList::CreateCopy(ASTContext &Context,
   return new (Mem) TemplateArgumentList(StoredArgs, NumArgs, true);
 }
 
+TemplateArgumentList *
+TemplateArgumentList::CreateShared(ASTContext &Context,
+                                   const TemplateArgument *Args,
+                                   unsigned NumArgs) {
+  const TemplateArgument *StoredArgs
+    = Context.getUniquedTemplateArgs(Args, NumArgs);
+  return new (Context) TemplateArgumentList(StoredArgs, NumArgs, false);
+}
+
 FunctionTemplateSpecializationInfo *
 FunctionTemplateSpecializationInfo::Create(ASTContext &C, FunctionDecl *FD,
                                            FunctionTemplateDecl *Template,
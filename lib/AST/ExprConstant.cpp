@@ -364,6 +364,18 @@ namespace {
     /// NextCallIndex - The next call index to assign.
     unsigned NextCallIndex;
 
+    /// StepsLeft - The remaining number of evaluation steps before we give up.
+    /// This bounds the work done for a single constant expression, however
+    /// its calls are nested.
+    unsigned StepsLeft;
+
+    /// StepsTaken - The number of evaluation steps taken so far, whether or
+    /// not there is a step limit.
+    uint64_t StepsTaken;
+
+    /// DeepestCallStackDepth - The largest CallStackDepth reached so far.
+    unsigned DeepestCallStackDepth;
+
     /// BottomFrame - The frame in which evaluation started. This must be
     /// initialized after CurrentCall and CallStackDepth.
     CallStackFrame BottomFrame;
@@ -385,12 +397,25 @@ namespace {
     /// are suppressed.
     bool CheckingPotentialConstantExpression;
 
+    /// ReadEvaluatingDeclValue - Has the in-flight value of EvaluatingDecl
+    /// been read? A call which does so has a result that depends on more than
+    /// its arguments, and cannot be memoized.
+    bool ReadEvaluatingDeclValue;
+
+    /// HasDiagnosed - Has the evaluation been diagnosed as not being a core
+    /// constant expression, whether or not the diagnostic was kept? Results of
+    /// calls which were diagnosed cannot be memoized.
+    bool HasDiagnosed;
+
     EvalInfo(const ASTContext &C, Expr::EvalStatus &S)
       : Ctx(const_cast<ASTContext&>(C)), EvalStatus(S), CurrentCall(0),
         CallStackDepth(0), NextCallIndex(1),
+        StepsLeft(getLangOpts().ConstexprStepLimit), StepsTaken(0),
+        DeepestCallStackDepth(0),
         BottomFrame(*this, SourceLocation(), 0, 0, 0),
         EvaluatingDecl(0), EvaluatingDeclValue(0), HasActiveDiagnostic(false),
-        CheckingPotentialConstantExpression(false) {}
+        CheckingPotentialConstantExpression(false),
+        ReadEvaluatingDeclValue(false), HasDiagnosed(false) {}
 
     void setEvaluatingDecl(const VarDecl *VD, APValue &Value) {
       EvaluatingDecl = VD;
@@ -416,6 +441,23 @@ namespace {
       return false;
     }
 
+    /// Account for one evaluation step, diagnosing if the step limit has
+    /// been reached. A limit of zero means there is no limit. Steps are
+    /// statements and calls, so the limit bounds running time without
+    /// rejecting large initializers.
+    bool nextStep(SourceLocation Loc) {
+      ++StepsTaken;
+      if (!getLangOpts().ConstexprStepLimit)
+        return true;
+      if (StepsLeft) {
+        --StepsLeft;
+        return true;
+      }
+      Diag(Loc, diag::note_constexpr_step_limit_exceeded)
+        << getLangOpts().ConstexprStepLimit;
+      return false;
+    }
+
     CallStackFrame *getCallFrame(unsigned CallIndex) {
       assert(CallIndex && "no call index in getCallFrame");
       // We will eventually hit BottomFrame, which has Index 1, so Frame can't
@@ -445,6 +487,7 @@ namespace {
       // If we have a prior diagnostic, it will be noting that the expression
       // isn't a constant expression. This diagnostic is more important.
       // FIXME: We might want to show both diagnostics to the user.
+      HasDiagnosed = true;
       if (EvalStatus.Diag) {
         unsigned CallStackNotes = CallStackDepth - 1;
         unsigned Limit = Ctx.getDiagnostics().getConstexprBacktraceLimit();
@@ -470,6 +513,7 @@ namespace {
                             unsigned ExtraNotes = 0) {
       if (EvalStatus.Diag)
         return Diag(E->getExprLoc(), DiagId, ExtraNotes);
+      HasDiagnosed = true;
       HasActiveDiagnostic = false;
       return OptionalDiagnostic();
     }
@@ -482,6 +526,7 @@ namespace {
                                unsigned ExtraNotes = 0) {
       // Don't override a previous diagnostic.
       if (!EvalStatus.Diag || !EvalStatus.Diag->empty()) {
+        HasDiagnosed = true;
         HasActiveDiagnostic = false;
         return OptionalDiagnostic();
       }
@@ -578,6 +623,8 @@ CallStackFrame::CallStackFrame(EvalInfo &Info, SourceLocation CallLoc,
       Index(Info.NextCallIndex++), This(This), Arguments(Arguments) {
   Info.CurrentCall = this;
   ++Info.CallStackDepth;
+  Info.DeepestCallStackDepth = std::max(Info.DeepestCallStackDepth,
+                                        Info.CallStackDepth);
 }
 
 CallStackFrame::~CallStackFrame() {
@@ -1450,6 +1497,7 @@ static bool EvaluateVarDeclInit(EvalInfo &Info, const Expr *E,
   // If we're currently evaluating the initializer of this declaration, use that
   // in-flight value.
   if (Info.EvaluatingDecl == VD) {
+    Info.ReadEvaluatingDeclValue = true;
     Result = *Info.EvaluatingDeclValue;
     return !Result.isUninit();
   }
@@ -2039,6 +2087,9 @@ enum EvalStmtResult {
 // Evaluate a statement.
 static EvalStmtResult EvaluateStmt(APValue &Result, EvalInfo &Info,
                                    const Stmt *S) {
+  if (!Info.nextStep(S->getLocStart()))
+    return ESR_Failed;
+
   switch (S->getStmtClass()) {
   default:
     return ESR_Failed;
@@ -2144,6 +2195,123 @@ static bool EvaluateArgs(ArrayRef<const Expr*> Args, ArgVector &ArgValues,
   return Success;
 }
 
+static void encodeBytes(raw_ostream &OS, const void *Data, size_t Size) {
+  OS.write(static_cast<const char*>(Data), Size);
+}
+
+static void encodeAPInt(raw_ostream &OS, const llvm::APInt &I) {
+  unsigned BitWidth = I.getBitWidth();
+  encodeBytes(OS, &BitWidth, sizeof(BitWidth));
+  encodeBytes(OS, I.getRawData(), I.getNumWords() * sizeof(uint64_t));
+}
+
+/// EncodeValue - Append an encoding of Value to OS which identifies it
+/// independently of the evaluation that produced it. Returns false if the
+/// value refers to state local to that evaluation, such as a temporary or a
+/// parameter of an enclosing call.
+static bool EncodeValue(raw_ostream &OS, const APValue &Value) {
+  char Kind = Value.getKind();
+  OS << Kind;
+  switch (Value.getKind()) {
+  case APValue::Uninitialized:
+    return true;
+  case APValue::Int:
+    OS << char(Value.getInt().isUnsigned());
+    encodeAPInt(OS, Value.getInt());
+    return true;
+  case APValue::Float:
+    encodeAPInt(OS, Value.getFloat().bitcastToAPInt());
+    return true;
+  case APValue::ComplexInt:
+    encodeAPInt(OS, Value.getComplexIntReal());
+    encodeAPInt(OS, Value.getComplexIntImag());
+    return true;
+  case APValue::ComplexFloat:
+    encodeAPInt(OS, Value.getComplexFloatReal().bitcastToAPInt());
+    encodeAPInt(OS, Value.getComplexFloatImag().bitcastToAPInt());
+    return true;
+  case APValue::LValue: {
+    if (Value.getLValueCallIndex())
+      return false;
+    const void *Base = Value.getLValueBase().getOpaqueValue();
+    int64_t Offset = Value.getLValueOffset().getQuantity();
+    encodeBytes(OS, &Base, sizeof(Base));
+    encodeBytes(OS, &Offset, sizeof(Offset));
+    if (!Value.hasLValuePath()) {
+      OS << char(0);
+      return true;
+    }
+    ArrayRef<APValue::LValuePathEntry> Path = Value.getLValuePath();
+    unsigned PathLength = Path.size();
+    OS << char(1) << char(Value.isLValueOnePastTheEnd());
+    encodeBytes(OS, &PathLength, sizeof(PathLength));
+    encodeBytes(OS, Path.data(), PathLength * sizeof(Path[0]));
+    return true;
+  }
+  case APValue::Vector: {
+    unsigned Length = Value.getVectorLength();
+    encodeBytes(OS, &Length, sizeof(Length));
+    for (unsigned I = 0; I != Length; ++I)
+      if (!EncodeValue(OS, Value.getVectorElt(I)))
+        return false;
+    return true;
+  }
+  case APValue::Array: {
+    unsigned Size = Value.getArraySize();
+    unsigned Initialized = Value.getArrayInitializedElts();
+    encodeBytes(OS, &Size, sizeof(Size));
+    encodeBytes(OS, &Initialized, sizeof(Initialized));
+    for (unsigned I = 0; I != Initialized; ++I)
+      if (!EncodeValue(OS, Value.getArrayInitializedElt(I)))
+        return false;
+    return !Value.hasArrayFiller() || EncodeValue(OS, Value.getArrayFiller());
+  }
+  case APValue::Struct: {
+    unsigned NumBases = Value.getStructNumBases();
+    unsigned NumFields = Value.getStructNumFields();
+    encodeBytes(OS, &NumBases, sizeof(NumBases));
+    encodeBytes(OS, &NumFields, sizeof(NumFields));
+    for (unsigned I = 0; I != NumBases; ++I)
+      if (!EncodeValue(OS, Value.getStructBase(I)))
+        return false;
+    for (unsigned I = 0; I != NumFields; ++I)
+      if (!EncodeValue(OS, Value.getStructField(I)))
+        return false;
+    return true;
+  }
+  case APValue::Union: {
+    const FieldDecl *Field = Value.getUnionField();
+    encodeBytes(OS, &Field, sizeof(Field));
+    return !Field || EncodeValue(OS, Value.getUnionValue());
+  }
+  case APValue::MemberPointer:
+  case APValue::AddrLabelDiff:
+    return false;
+  }
+  llvm_unreachable("unknown APValue kind");
+}
+
+/// GetCallMemoizationKey - Build the key under which the result of calling
+/// Callee with the given arguments is memoized. Returns false if the call
+/// cannot be memoized.
+static bool GetCallMemoizationKey(EvalInfo &Info, const FunctionDecl *Callee,
+                                  const LValue *This,
+                                  ArrayRef<APValue> Args,
+                                  SmallVectorImpl<char> &Key) {
+  // Member calls depend on the object, and potential constant expressions
+  // are evaluated with unknown arguments.
+  if (This || Info.CheckingPotentialConstantExpression)
+    return false;
+
+  llvm::raw_svector_ostream OS(Key);
+  encodeBytes(OS, &Callee, sizeof(Callee));
+  for (unsigned I = 0, N = Args.size(); I != N; ++I)
+    if (!EncodeValue(OS, Args[I]))
+      return false;
+  OS.flush();
+  return true;
+}
+
 /// Evaluate a function call.
 static bool HandleFunctionCall(SourceLocation CallLoc,
                                const FunctionDecl *Callee, const LValue *This,
@@ -2153,11 +2321,73 @@ static bool HandleFunctionCall(SourceLocation CallLoc,
   if (!EvaluateArgs(Args, ArgValues, Info))
     return false;
 
-  if (!Info.CheckCallLimit(CallLoc))
+  // Calls are pure functions of their arguments, so each one only needs to be
+  // evaluated once per translation unit.
+  SmallString<64> Key;
+  bool Memoizable = GetCallMemoizationKey(Info, Callee, This, ArgValues, Key);
+  if (Memoizable) {
+    // A reused result is charged what evaluating the call cost, so that the
+    // depth and step limits accept the same calls whether or not they were
+    // memoized. If it does not fit, evaluate the call to diagnose it.
+    const ASTContext::ConstexprCallResult *Memoized
+      = Info.Ctx.getConstexprCallResult(Key);
+    unsigned StepLimit = Info.getLangOpts().ConstexprStepLimit;
+    if (Memoized &&
+        Info.CallStackDepth + Memoized->Depth - 1 <=
+          Info.getLangOpts().ConstexprCallDepth &&
+        (!StepLimit || Memoized->Steps <= Info.StepsLeft)) {
+      ++ASTContext::NumConstexprCallCacheHits;
+      if (StepLimit)
+        Info.StepsLeft -= Memoized->Steps;
+      Info.StepsTaken += Memoized->Steps;
+      Info.DeepestCallStackDepth =
+        std::max(Info.DeepestCallStackDepth,
+                 Info.CallStackDepth + Memoized->Depth);
+      Result = Memoized->Value;
+      return true;
+    }
+    ++ASTContext::NumConstexprCallCacheMisses;
+  }
+
+  // The call itself is a step, which a memoized result is charged for too.
+  uint64_t StepsTaken = Info.StepsTaken;
+  if (!Info.nextStep(CallLoc) || !Info.CheckCallLimit(CallLoc))
     return false;
 
-  CallStackFrame Frame(Info, CallLoc, Callee, This, ArgValues.data());
-  return EvaluateStmt(Result, Info, Body) == ESR_Returned;
+  // Only remember results of calls which are core constant expressions and
+  // which depend only on their arguments.
+  Memoizable = Memoizable && !Info.EvalStatus.HasSideEffects;
+  bool ReadEvaluatingDeclValue = Info.ReadEvaluatingDeclValue;
+  bool HasDiagnosed = Info.HasDiagnosed;
+  Info.ReadEvaluatingDeclValue = false;
+  Info.HasDiagnosed = false;
+  unsigned DeepestCallStackDepth = Info.DeepestCallStackDepth;
+  Info.DeepestCallStackDepth = Info.CallStackDepth;
+
+  bool Success;
+  {
+    CallStackFrame Frame(Info, CallLoc, Callee, This, ArgValues.data());
+    Success = EvaluateStmt(Result, Info, Body) == ESR_Returned;
+  }
+
+  if (Success && Memoizable && !Info.HasDiagnosed &&
+      !Info.EvalStatus.HasSideEffects && !Info.ReadEvaluatingDeclValue) {
+    // Don't remember results which refer to this evaluation's temporaries.
+    SmallString<64> ResultKey;
+    llvm::raw_svector_ostream OS(ResultKey);
+    if (EncodeValue(OS, Result)) {
+      ASTContext::ConstexprCallResult Memoized;
+      Memoized.Value = Result;
+      Memoized.Steps = Info.StepsTaken - StepsTaken;
+      Memoized.Depth = Info.DeepestCallStackDepth - Info.CallStackDepth;
+      Info.Ctx.setConstexprCallResult(Key, Memoized);
+    }
+  }
+  Info.ReadEvaluatingDeclValue |= ReadEvaluatingDeclValue;
+  Info.HasDiagnosed |= HasDiagnosed;
+  Info.DeepestCallStackDepth = std::max(Info.DeepestCallStackDepth,
+                                        DeepestCallStackDepth);
+  return Success;
 }
 
 /// Evaluate a constructor call.
@@ -2169,7 +2399,7 @@ static bool HandleConstructorCall(SourceLocation CallLoc, const LValue &This,
   if (!EvaluateArgs(Args, ArgValues, Info))
     return false;
 
-  if (!Info.CheckCallLimit(CallLoc))
+  if (!Info.nextStep(CallLoc) || !Info.CheckCallLimit(CallLoc))
     return false;
 
   const CXXRecordDecl *RD = Definition->getParent();
@@ -15,7 +15,12 @@
 #include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/TargetInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
 using namespace clang;
 
 static const Builtin::Info BuiltinInfo[] = {
@@ -33,15 +38,78 @@ const Builtin::Info &Builtin::Context::GetRecord(unsigned ID) const {
   return TSRecords[ID - Builtin::FirstTSBuiltin];
 }
 
+namespace clang {
+namespace Builtin {
+/// \brief Maps the names of a table of builtin records to their IDs.
+///
+/// The tables are immutable and identical for every translation unit, so each
+/// index is built once per process and shared, rather than entering every
+/// builtin into each translation unit's identifier table.
+class NameIndex {
+  llvm::StringMap<unsigned> IDs;
+
+public:
+  NameIndex(const Info *Records, unsigned NumRecords, unsigned FirstID) {
+    for (unsigned I = 0; I != NumRecords; ++I)
+      IDs[Records[I].Name] = FirstID + I;
+  }
+
+  /// \brief Return the ID of the builtin with the given name, or 0.
+  unsigned lookup(StringRef Name) const { return IDs.lookup(Name); }
+};
+}
+}
+
+namespace {
+/// \brief The index of the target-independent builtins.
+struct GenericNameIndex : Builtin::NameIndex {
+  GenericNameIndex()
+    : Builtin::NameIndex(BuiltinInfo + 1,
+                         Builtin::FirstTSBuiltin - (Builtin::NotBuiltin + 1),
+                         Builtin::NotBuiltin + 1) { }
+};
+
+/// \brief The indices of the target-specific builtins, keyed by the target's
+/// table of records.
+struct TargetNameIndices {
+  llvm::sys::Mutex Lock;
+  llvm::DenseMap<const Builtin::Info *, Builtin::NameIndex *> Indices;
+
+  ~TargetNameIndices() {
+    for (llvm::DenseMap<const Builtin::Info *, Builtin::NameIndex *>::iterator
+           I = Indices.begin(), E = Indices.end(); I != E; ++I)
+      delete I->second;
+  }
+
+  const Builtin::NameIndex *get(const Builtin::Info *Records,
+                                unsigned NumRecords) {
+    llvm::MutexGuard Guard(Lock);
+    Builtin::NameIndex *&Index = Indices[Records];
+    if (!Index)
+      Index = new Builtin::NameIndex(Records, NumRecords,
+                                     Builtin::FirstTSBuiltin);
+    return Index;
+  }
+};
+}
+
+static llvm::ManagedStatic<GenericNameIndex> GenericBuiltins;
+static llvm::ManagedStatic<TargetNameIndices> TargetBuiltins;
+
 Builtin::Context::Context() {
   // Get the target specific builtins from the target.
   TSRecords = 0;
   NumTSRecords = 0;
+  TSIndex = 0;
+  NoBuiltins = false;
+  ObjCBuiltins = false;
 }
 
 void Builtin::Context::InitializeTarget(const TargetInfo &Target) {
   assert(NumTSRecords == 0 && "Already initialized target?");
   Target.getTargetBuiltins(TSRecords, NumTSRecords);  
+  if (NumTSRecords)
+    TSIndex = TargetBuiltins->get(TSRecords, NumTSRecords);
 }
 
 /// InitializeBuiltins - Mark the identifiers for all the builtins with their
@@ -49,18 +117,34 @@ void Builtin::Context::InitializeTarget(const TargetInfo &Target) {
 /// such.
 void Builtin::Context::InitializeBuiltins(IdentifierTable &Table,
                                           const LangOptions& LangOpts) {
-  // Step #1: mark all target-independent builtins with their ID's.
-  for (unsigned i = Builtin::NotBuiltin+1; i != Builtin::FirstTSBuiltin; ++i)
-    if (!LangOpts.NoBuiltin || !strchr(BuiltinInfo[i].Attribute, 'f')) {
-      if (LangOpts.ObjC1 || 
-          BuiltinInfo[i].builtin_lang != clang::OBJC_LANG)
-        Table.get(BuiltinInfo[i].Name).setBuiltinID(i);
-    }
+  NoBuiltins = LangOpts.NoBuiltin;
+  ObjCBuiltins = LangOpts.ObjC1;
+
+  // Identifiers that already exist won't be classified by the table, so mark
+  // them now. Identifiers read from an AST file already carry the builtin ID
+  // they had when it was written.
+  for (IdentifierTable::iterator I = Table.begin(), E = Table.end();
+       I != E; ++I)
+    if (!I->getValue()->isFromAST())
+      if (unsigned ID = getBuiltinIDForName(I->getKey()))
+        I->getValue()->setBuiltinID(ID);
+
+  // Classify everything else as it is created.
+  Table.setBuiltinInfo(this);
+}
 
-  // Step #2: Register target-specific builtins.
-  for (unsigned i = 0, e = NumTSRecords; i != e; ++i)
-    if (!LangOpts.NoBuiltin || !strchr(TSRecords[i].Attribute, 'f'))
-      Table.get(TSRecords[i].Name).setBuiltinID(i+Builtin::FirstTSBuiltin);
+unsigned Builtin::Context::getBuiltinIDForName(StringRef Name) const {
+  // Target-specific builtins take precedence over target-independent ones.
+  if (TSIndex)
+    if (unsigned ID = TSIndex->lookup(Name))
+      if (isEnabled(GetRecord(ID)))
+        return ID;
+
+  if (unsigned ID = GenericBuiltins->lookup(Name))
+    if (isEnabled(GetRecord(ID)))
+      return ID;
+
+  return 0;
 }
 
 void
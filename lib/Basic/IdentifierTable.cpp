@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "clang/Basic/IdentifierTable.h"
+#include "clang/Basic/Builtins.h"
 #include "clang/Basic/LangOptions.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/FoldingSet.h"
@@ -74,7 +75,7 @@ ExternalIdentifierLookup::~ExternalIdentifierLookup() {}
 IdentifierTable::IdentifierTable(const LangOptions &LangOpts,
                                  IdentifierInfoLookup* externalLookup)
   : HashTable(8192), // Start with space for 8K identifiers.
-    ExternalLookup(externalLookup) {
+    ExternalLookup(externalLookup), BuiltinInfo(0) {
 
   // Populate the identifier table with info about keywords for the current
   // language.
@@ -85,6 +86,12 @@ IdentifierTable::IdentifierTable(const LangOptions &LangOpts,
   get("import").setModulesImport(true);
 }
 
+void IdentifierTable::setBuiltinIDFromName(IdentifierInfo &II,
+                                           StringRef Name) {
+  if (unsigned ID = BuiltinInfo->getBuiltinIDForName(Name))
+    II.setBuiltinID(ID);
+}
+
 //===----------------------------------------------------------------------===//
 // Language Keyword Implementation
 //===----------------------------------------------------------------------===//
@@ -375,7 +375,7 @@ SourceManager::SourceManager(DiagnosticsEngine &Diag, FileManager &FileMgr,
   : Diag(Diag), FileMgr(FileMgr), OverridenFilesKeepOriginalName(true),
     UserFilesAreVolatile(UserFilesAreVolatile),
     ExternalSLocEntries(0), LineTable(0), NumLinearScans(0),
-    NumBinaryProbes(0), FakeBufferForRecovery(0),
+    NumBinaryProbes(0), NumFileIDCacheHits(0), FakeBufferForRecovery(0),
     FakeContentCacheForRecovery(0) {
   clearIDTables();
   Diag.setSourceManager(this);
@@ -418,6 +418,7 @@ void SourceManager::clearIDTables() {
   LastLineNoFileIDQuery = FileID();
   LastLineNoContentCache = 0;
   LastFileIDLookup = FileID();
+  std::fill(FileIDCache, FileIDCache + FileIDCacheSize, FileID());
 
   if (LineTable)
     LineTable->clear();
@@ -493,9 +494,9 @@ const SrcMgr::SLocEntry &SourceManager::loadSLocEntry(unsigned Index,
     if (!SLocEntryLoaded[Index]) {
       // Try to recover; create a SLocEntry so the rest of clang can handle it.
       LoadedSLocEntryTable[Index] = SLocEntry::get(0,
-                                 FileInfo::get(SourceLocation(),
-                                               getFakeContentCacheForRecovery(),
-                                               SrcMgr::C_User));
+                                 createFileInfo(SourceLocation(),
+                                                getFakeContentCacheForRecovery(),
+                                                SrcMgr::C_User));
     }
   }
 
@@ -540,6 +541,15 @@ SourceManager::getFakeContentCacheForRecovery() const {
 // Methods to create new FileID's and macro expansions.
 //===----------------------------------------------------------------------===//
 
+const SrcMgr::FileInfo *
+SourceManager::createFileInfo(SourceLocation IncludePos,
+                              const ContentCache *File,
+                              SrcMgr::CharacteristicKind FileCharacter) const {
+  FileInfo *FI = ContentCacheAlloc.Allocate<FileInfo>();
+  *FI = FileInfo::get(IncludePos, File, FileCharacter);
+  return FI;
+}
+
 /// createFileID - Create a new FileID for the specified ContentCache and
 /// include position.  This works regardless of whether the ContentCache
 /// corresponds to a file or some other input source.
@@ -553,17 +563,19 @@ FileID SourceManager::createFileID(const ContentCache *File,
     assert(Index < LoadedSLocEntryTable.size() && "FileID out of range");
     assert(!SLocEntryLoaded[Index] && "FileID already loaded");
     LoadedSLocEntryTable[Index] = SLocEntry::get(LoadedOffset,
-        FileInfo::get(IncludePos, File, FileCharacter));
+        createFileInfo(IncludePos, File, FileCharacter));
     SLocEntryLoaded[Index] = true;
     return FileID::get(LoadedID);
   }
-  LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset,
-                                               FileInfo::get(IncludePos, File,
-                                                             FileCharacter)));
   unsigned FileSize = File->getSize();
-  assert(NextLocalOffset + FileSize + 1 > NextLocalOffset &&
-         NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset &&
-         "Ran out of source locations!");
+  if (!hasLocalSLocSpace(FileSize + 1)) {
+    Diag.Report(IncludePos, diag::err_sloc_space_exhausted)
+      << CurrentLoadedOffset;
+    return FileID();
+  }
+  LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset,
+                                               createFileInfo(IncludePos, File,
+                                                              FileCharacter)));
   // We do a +1 here because we want a SourceLocation that means "the end of the
   // file", e.g. for the "no newline at the end of the file" diagnostic.
   NextLocalOffset += FileSize + 1;
@@ -609,10 +621,12 @@ SourceManager::createExpansionLocImpl(const ExpansionInfo &Info,
     SLocEntryLoaded[Index] = true;
     return SourceLocation::getMacroLoc(LoadedOffset);
   }
+  if (!hasLocalSLocSpace(TokLength + 1)) {
+    Diag.Report(Info.getExpansionLocStart(), diag::err_sloc_space_exhausted)
+      << CurrentLoadedOffset;
+    return SourceLocation();
+  }
   LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset, Info));
-  assert(NextLocalOffset + TokLength + 1 > NextLocalOffset &&
-         NextLocalOffset + TokLength + 1 <= CurrentLoadedOffset &&
-         "Ran out of source locations!");
   // See createFileID for that +1.
   NextLocalOffset += TokLength + 1;
   return SourceLocation::getMacroLoc(NextLocalOffset - (TokLength + 1));
@@ -696,11 +710,27 @@ FileID SourceManager::getFileIDSlow(unsigned SLocOffset) const {
   if (!SLocOffset)
     return FileID::get(0);
 
+  // Check the second-level cache.  Entries are never removed or moved once
+  // created, so a cached FileID is still right if its entry covers the offset.
+  FileID &Cached =
+    FileIDCache[(SLocOffset >> FileIDCacheShift) % FileIDCacheSize];
+  if (!Cached.isInvalid() && isOffsetInFileID(Cached, SLocOffset)) {
+    ++NumFileIDCacheHits;
+    // Let the first-level check in getFileID catch the next lookup into the
+    // same entry.
+    LastFileIDLookup = Cached;
+    return Cached;
+  }
+
   // Now it is time to search for the correct file. See where the SLocOffset
   // sits in the global view and consult local or loaded buffers for it.
+  FileID Res;
   if (SLocOffset < NextLocalOffset)
-    return getFileIDLocal(SLocOffset);
-  return getFileIDLoaded(SLocOffset);
+    Res = getFileIDLocal(SLocOffset);
+  else
+    Res = getFileIDLoaded(SLocOffset);
+  Cached = Res;
+  return Res;
 }
 
 /// \brief Return the FileID for a SourceLocation with a low offset.
@@ -1946,7 +1976,8 @@ void SourceManager::PrintStats() const {
                << NumLineNumsComputed << " files with line #'s computed, "
                << NumMacroArgsComputed << " files with macro args computed.\n";
   llvm::errs() << "FileID scans: " << NumLinearScans << " linear, "
-               << NumBinaryProbes << " binary.\n";
+               << NumBinaryProbes << " binary, "
+               << NumFileIDCacheHits << " cache hits.\n";
 }
 
 ExternalSLocEntrySource::~ExternalSLocEntrySource() { }
@@ -211,6 +211,8 @@ static FullSourceLoc ConvertBackendLocation(const llvm::SMDiagnostic &D,
   llvm::MemoryBuffer::getMemBufferCopy(LBuf->getBuffer(),
                                        LBuf->getBufferIdentifier());
   FileID FID = CSM.createFileIDForMemBuffer(CBuf);
+  if (FID.isInvalid())
+    return FullSourceLoc();
 
   // Translate the offset into the file.
   unsigned Offset = D.getLoc().getPointer()  - LBuf->getBufferStart();
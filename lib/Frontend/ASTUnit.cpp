@@ -32,8 +32,11 @@
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/ASTWriter.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/Config/config.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/CrashRecoveryContext.h"
 #include "llvm/Support/FileSystem.h"
@@ -47,6 +50,9 @@
 #include <cstdio>
 #include <cstdlib>
 #include <sys/stat.h>
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
 using namespace clang;
 
 using llvm::TimeRecord;
@@ -163,6 +169,231 @@ static const std::string &getPreambleFile(const ASTUnit *AU) {
   return getOnDiskData(AU).PreambleFile;  
 }
 
+//===----------------------------------------------------------------------===//
+// Shared precompiled preambles
+//===----------------------------------------------------------------------===//
+
+namespace {
+  /// \brief A precompiled preamble that any ASTUnit may adopt if its main
+  /// file, preamble text and relevant compiler options match the ones the
+  /// preamble was built with.
+  ///
+  /// This records everything the building ASTUnit keeps about its preamble,
+  /// so that another ASTUnit can pick it up instead of building its own copy.
+  /// The PCH file is removed once the last ASTUnit using it lets go of it.
+  struct SharedPreamble {
+    std::string Key;
+    std::string PreambleFile;
+    unsigned RefCount;
+
+    bool EndsAtStartOfLine;
+    unsigned ReservedSize;
+    llvm::StringMap<std::pair<off_t, time_t> > FilesInPreamble;
+    unsigned NumWarnings;
+    std::vector<serialization::DeclID> TopLevelDecls;
+    SmallVector<StoredDiagnostic, 4> Diagnostics;
+    unsigned TopLevelHashValue;
+
+    SharedPreamble() : RefCount(1), EndsAtStartOfLine(false), ReservedSize(0),
+                       NumWarnings(0), TopLevelHashValue(0) { }
+  };
+
+  /// \brief The shared preambles, indexed both by key and by PCH file.
+  ///
+  /// Allocated on the heap and never freed, since ASTUnits may release their
+  /// preambles from the atexit handler that cleans up the on-disk data.
+  struct SharedPreambleMap {
+    llvm::StringMap<SharedPreamble *> ByKey;
+    llvm::StringMap<SharedPreamble *> ByFile;
+  };
+}
+
+static SharedPreambleMap &getSharedPreambles() {
+  static SharedPreambleMap *M = new SharedPreambleMap;
+  return *M;
+}
+
+/// \brief Look up a shared preamble by key, taking a reference to it.
+static SharedPreamble *acquireSharedPreamble(StringRef Key) {
+  llvm::MutexGuard Guard(getOnDiskMutex());
+  SharedPreambleMap &M = getSharedPreambles();
+  llvm::StringMap<SharedPreamble *>::iterator I = M.ByKey.find(Key);
+  if (I == M.ByKey.end())
+    return 0;
+  ++I->second->RefCount;
+  return I->second;
+}
+
+/// \brief Make a newly-built preamble available to other ASTUnits. The
+/// building ASTUnit holds the initial reference.
+static void registerSharedPreamble(SharedPreamble *SP) {
+  llvm::MutexGuard Guard(getOnDiskMutex());
+  SharedPreambleMap &M = getSharedPreambles();
+  // If an equivalent preamble was registered in the meantime, keep ours
+  // private to its ASTUnit.
+  if (M.ByKey.count(SP->Key) || M.ByFile.count(SP->PreambleFile)) {
+    delete SP;
+    return;
+  }
+  M.ByKey[SP->Key] = SP;
+  M.ByFile[SP->PreambleFile] = SP;
+}
+
+/// \brief Drop an ASTUnit's reference to the preamble PCH file \p File,
+/// removing the file unless another ASTUnit still uses it.
+static void releasePreambleFile(StringRef File) {
+  llvm::MutexGuard Guard(getOnDiskMutex());
+  SharedPreambleMap &M = getSharedPreambles();
+  llvm::StringMap<SharedPreamble *>::iterator I = M.ByFile.find(File);
+  if (I != M.ByFile.end()) {
+    SharedPreamble *SP = I->second;
+    if (--SP->RefCount)
+      return;
+    M.ByKey.erase(SP->Key);
+    M.ByFile.erase(I);
+    delete SP;
+  }
+  llvm::sys::Path(File).eraseFromDisk();
+}
+
+/// \brief Compute the key under which a preamble is shared.
+///
+/// Two preambles are interchangeable if they were built for the same main
+/// file (whose name is recorded in the PCH) from the same text, with options
+/// that affect how that text is parsed and which diagnostics it produces.
+/// The files the preamble includes are validated separately, against
+/// \c SharedPreamble::FilesInPreamble.
+static std::string getSharedPreambleKey(const CompilerInvocation &Invocation,
+                                        StringRef MainFilename,
+                                        StringRef PreambleText,
+                                        bool CaptureDiagnostics) {
+  std::string Key;
+  llvm::raw_string_ostream OS(Key);
+  OS << Invocation.getModuleHash() << '\0' << CaptureDiagnostics << '\0';
+
+  const HeaderSearchOptions &HSOpts = Invocation.getHeaderSearchOpts();
+  OS << HSOpts.ResourceDir << '\0' << HSOpts.ModuleCachePath << '\0';
+  for (unsigned I = 0, N = HSOpts.UserEntries.size(); I != N; ++I) {
+    const HeaderSearchOptions::Entry &E = HSOpts.UserEntries[I];
+    OS << E.Path << '\0' << unsigned(E.Group) << E.IsFramework
+       << E.IgnoreSysRoot << '\0';
+  }
+
+  const PreprocessorOptions &PPOpts = Invocation.getPreprocessorOpts();
+  for (unsigned I = 0, N = PPOpts.Includes.size(); I != N; ++I)
+    OS << "-include " << PPOpts.Includes[I] << '\0';
+  for (unsigned I = 0, N = PPOpts.MacroIncludes.size(); I != N; ++I)
+    OS << "-imacros " << PPOpts.MacroIncludes[I] << '\0';
+  OS << PPOpts.ImplicitPCHInclude << '\0' << PPOpts.ImplicitPTHInclude << '\0';
+
+  const DiagnosticOptions &DiagOpts = Invocation.getDiagnosticOpts();
+#define DIAGOPT(Name, Bits, Default) OS << DiagOpts.Name << ' ';
+#define ENUM_DIAGOPT(Name, Type, Bits, Default) \
+  OS << unsigned(DiagOpts.get##Name()) << ' ';
+#include "clang/Basic/DiagnosticOptions.def"
+  for (unsigned I = 0, N = DiagOpts.Warnings.size(); I != N; ++I)
+    OS << "-W" << DiagOpts.Warnings[I] << '\0';
+
+  OS << MainFilename << '\0' << PreambleText;
+  return OS.str();
+}
+
+/// \brief Copy a FilesInPreamble map (StringMap can't be copy-assigned).
+static void
+copyFilesInPreamble(const llvm::StringMap<std::pair<off_t, time_t> > &From,
+                    llvm::StringMap<std::pair<off_t, time_t> > &To) {
+  To.clear();
+  for (llvm::StringMap<std::pair<off_t, time_t> >::const_iterator
+         F = From.begin(), FEnd = From.end(); F != FEnd; ++F)
+    To[F->first()] = F->second;
+}
+
+/// \brief Determine whether any of the files that a precompiled preamble was
+/// built from have changed since, taking the file remappings in \p PPOpts
+/// into account.
+static bool
+haveFilesInPreambleChanged(FileManager &FileMgr,
+                           const PreprocessorOptions &PPOpts,
+                   const llvm::StringMap<std::pair<off_t, time_t> > &Files) {
+  // First, make a record of those files that have been overridden via
+  // remapping or unsaved_files.
+  llvm::StringMap<std::pair<off_t, time_t> > OverriddenFiles;
+  for (PreprocessorOptions::const_remapped_file_iterator
+            R = PPOpts.remapped_file_begin(),
+         REnd = PPOpts.remapped_file_end();
+       R != REnd;
+       ++R) {
+    struct stat StatBuf;
+    if (FileMgr.getNoncachedStatValue(R->second, StatBuf)) {
+      // If we can't stat the file we're remapping to, assume that something
+      // horrible happened.
+      return true;
+    }
+
+    OverriddenFiles[R->first] = std::make_pair(StatBuf.st_size,
+                                               StatBuf.st_mtime);
+  }
+  for (PreprocessorOptions::const_remapped_file_buffer_iterator
+            R = PPOpts.remapped_file_buffer_begin(),
+         REnd = PPOpts.remapped_file_buffer_end();
+       R != REnd;
+       ++R) {
+    // FIXME: Should we actually compare the contents of file->buffer
+    // remappings?
+    OverriddenFiles[R->first] = std::make_pair(R->second->getBufferSize(),
+                                               0);
+  }
+
+  // Check whether anything has changed.
+  for (llvm::StringMap<std::pair<off_t, time_t> >::const_iterator
+         F = Files.begin(), FEnd = Files.end();
+       F != FEnd;
+       ++F) {
+    llvm::StringMap<std::pair<off_t, time_t> >::iterator Overridden
+      = OverriddenFiles.find(F->first());
+    if (Overridden != OverriddenFiles.end()) {
+      // This file was remapped; check whether the newly-mapped file
+      // matches up with the previous mapping.
+      if (Overridden->second != F->second)
+        return true;
+      continue;
+    }
+
+    // The file was not remapped; check whether it has changed on disk.
+    struct stat StatBuf;
+    if (FileMgr.getNoncachedStatValue(F->first(), StatBuf)) {
+      // If we can't stat the file, assume that something horrible happened.
+      return true;
+    }
+    if (StatBuf.st_size != F->second.first ||
+        StatBuf.st_mtime != F->second.second)
+      return true;
+  }
+
+  return false;
+}
+
+/// \brief Record the size and modification time of every file, other than
+/// the main file, that \p SourceMgr loaded while building a preamble.
+static void
+collectFilesInPreamble(SourceManager &SourceMgr,
+                       llvm::StringMap<std::pair<off_t, time_t> > &Files) {
+  Files.clear();
+  const llvm::MemoryBuffer *MainFileBuffer
+    = SourceMgr.getBuffer(SourceMgr.getMainFileID());
+  for (SourceManager::fileinfo_iterator F = SourceMgr.fileinfo_begin(),
+                                     FEnd = SourceMgr.fileinfo_end();
+       F != FEnd;
+       ++F) {
+    const FileEntry *File = F->second->OrigEntry;
+    if (!File || F->second->getRawBuffer() == MainFileBuffer)
+      continue;
+    
+    Files[File->getName()]
+      = std::make_pair(F->second->getSize(), File->getModificationTime());
+  }
+}
+
 void OnDiskData::CleanTemporaryFiles() {
   for (unsigned I = 0, N = TemporaryFiles.size(); I != N; ++I)
     TemporaryFiles[I].eraseFromDisk();
@@ -171,7 +402,7 @@ void OnDiskData::CleanTemporaryFiles() {
 
 void OnDiskData::CleanPreambleFile() {
   if (!PreambleFile.empty()) {
-    llvm::sys::Path(PreambleFile).eraseFromDisk();
+    releasePreambleFile(PreambleFile);
     PreambleFile.clear();
   }
 }
@@ -189,6 +420,120 @@ struct ASTUnit::ASTWriterData {
   ASTWriterData() : Stream(Buffer), Writer(Stream) { }
 };
 
+struct ASTUnit::BackgroundPreamble {
+  /// \brief The invocation used to build the preamble. It refers only to
+  /// buffers in \c OwnedBuffers, so the ASTUnit is free to replace its own
+  /// remapped files while the build runs.
+  IntrusiveRefCntPtr<CompilerInvocation> Invocation;
+  std::vector<llvm::MemoryBuffer *> OwnedBuffers;
+
+  std::string Key;
+  bool CaptureDiagnostics;
+  bool EndsAtStartOfLine;
+  unsigned ReservedSize;
+
+  /// \brief The new preamble, if it was built successfully. Only valid once
+  /// the build is done.
+  SharedPreamble *Result;
+
+  llvm::sys::Mutex Lock;
+  bool Done;
+  bool Started;
+
+  /// \brief Set when the result is no longer wanted. The build stops at the
+  /// next top-level declaration and throws away what it has written.
+  volatile llvm::sys::cas_flag Cancelled;
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+  pthread_t Thread;
+#endif
+
+  BackgroundPreamble() : CaptureDiagnostics(false), EndsAtStartOfLine(false),
+                         ReservedSize(0), Result(0), Done(false),
+                         Started(false), Cancelled(0) { }
+
+  /// \brief Cancels the build if it is still running, then waits for it.
+  ~BackgroundPreamble();
+
+  /// \brief Start building the preamble on a new thread.
+  bool start();
+
+  /// \brief Whether the build has finished, successfully or not.
+  bool isDone() {
+    llvm::MutexGuard Guard(Lock);
+    return Done;
+  }
+
+  /// \brief Wait for the build to finish.
+  void wait();
+
+  /// \brief Take ownership of the built preamble, if any. The build must be
+  /// done.
+  SharedPreamble *takeResult() {
+    wait();
+    SharedPreamble *SP = Result;
+    Result = 0;
+    return SP;
+  }
+
+private:
+  void build();
+  static void buildSafely(void *Job);
+  static void *run(void *Job);
+};
+
+ASTUnit::BackgroundPreamble::~BackgroundPreamble() {
+  llvm::sys::CompareAndSwap(&Cancelled, 1, 0);
+  wait();
+  for (unsigned I = 0, N = OwnedBuffers.size(); I != N; ++I)
+    delete OwnedBuffers[I];
+  if (Result) {
+    llvm::sys::Path(Result->PreambleFile).eraseFromDisk();
+    delete Result;
+  }
+}
+
+bool ASTUnit::BackgroundPreamble::start() {
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+  if (::pthread_create(&Thread, 0, run, this))
+    return false;
+  Started = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ASTUnit::BackgroundPreamble::wait() {
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+  if (Started) {
+    ::pthread_join(Thread, 0);
+    Started = false;
+  }
+#endif
+}
+
+void ASTUnit::BackgroundPreamble::buildSafely(void *Job) {
+  static_cast<BackgroundPreamble *>(Job)->build();
+}
+
+void *ASTUnit::BackgroundPreamble::run(void *Job) {
+  BackgroundPreamble *Self = static_cast<BackgroundPreamble *>(Job);
+
+  // Parsing needs a larger stack than a thread gets by default, so build on
+  // a thread with the same stack size that libclang gives its own work.
+  const unsigned ThreadStackSize = 8 << 20;
+  llvm::CrashRecoveryContext CRC;
+  if (!CRC.RunSafelyOnThread(buildSafely, Self, ThreadStackSize)) {
+    // The build crashed part-way; throw away whatever it wrote.
+    llvm::sys::Path(Self->Invocation->getFrontendOpts().OutputFile)
+      .eraseFromDisk();
+  }
+
+  llvm::MutexGuard Guard(Self->Lock);
+  Self->Done = true;
+  return 0;
+}
+
 void ASTUnit::clearFileLevelDecls() {
   for (FileDeclsTy::iterator
          I = FileDecls.begin(), E = FileDecls.end(); I != E; ++I)
@@ -225,6 +570,8 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
     NumWarningsInPreamble(0),
     ShouldCacheCodeCompletionResults(false),
     IncludeBriefCommentsInCodeCompletion(false), UserFilesAreVolatile(false),
+    AsynchronousPreambleRebuild(false), Suspended(false),
+    ReparseDeferred(false),
     CompletionCacheTopLevelHashValue(0),
     PreambleTopLevelHashValue(0),
     CurrentTopLevelHashValue(0),
@@ -236,6 +583,9 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
 }
 
 ASTUnit::~ASTUnit() {
+  // Wait for any preamble being built in the background, and discard it.
+  PendingPreamble.reset();
+
   clearFileLevelDecls();
 
   // Clean up the temporary files and the preamble file.
@@ -254,6 +604,7 @@ ASTUnit::~ASTUnit() {
          ++FB)
       delete FB->second;
   }
+  llvm::DeleteContainerPointers(BuffersOfDeferredReparse);
   
   delete SavedMainFileBuffer;
   delete PreambleBuffer;
@@ -948,19 +1299,28 @@ public:
 };
 
 class PrecompilePreambleConsumer : public PCHGenerator {
-  ASTUnit &Unit;
+  DiagnosticsEngine &Diags;
   unsigned &Hash;                                   
+  std::vector<serialization::DeclID> &TopLevelDeclIDs;
   std::vector<Decl *> TopLevelDecls;
+  const volatile llvm::sys::cas_flag *Cancelled;
                                      
 public:
-  PrecompilePreambleConsumer(ASTUnit &Unit, const Preprocessor &PP, 
+  PrecompilePreambleConsumer(DiagnosticsEngine &Diags, unsigned &Hash,
+                        std::vector<serialization::DeclID> &TopLevelDeclIDs,
+                             const volatile llvm::sys::cas_flag *Cancelled,
+                             const Preprocessor &PP, 
                              StringRef isysroot, raw_ostream *Out)
-    : PCHGenerator(PP, "", 0, isysroot, Out), Unit(Unit),
-      Hash(Unit.getCurrentTopLevelHashValue()) {
+    : PCHGenerator(PP, "", 0, isysroot, Out), Diags(Diags), Hash(Hash),
+      TopLevelDeclIDs(TopLevelDeclIDs), Cancelled(Cancelled) {
     Hash = 0;
   }
 
   virtual bool HandleTopLevelDecl(DeclGroupRef D) {
+    // Stop parsing if nobody wants the preamble any more.
+    if (Cancelled && *Cancelled)
+      return false;
+
     for (DeclGroupRef::iterator it = D.begin(), ie = D.end(); it != ie; ++it) {
       Decl *D = *it;
       // FIXME: Currently ObjC method declarations are incorrectly being
@@ -977,23 +1337,32 @@ public:
 
   virtual void HandleTranslationUnit(ASTContext &Ctx) {
     PCHGenerator::HandleTranslationUnit(Ctx);
-    if (!Unit.getDiagnostics().hasErrorOccurred()) {
+    if (!Diags.hasErrorOccurred()) {
       // Translate the top-level declarations we captured during
       // parsing into declaration IDs in the precompiled
       // preamble. This will allow us to deserialize those top-level
       // declarations when requested.
       for (unsigned I = 0, N = TopLevelDecls.size(); I != N; ++I)
-        Unit.addTopLevelDeclFromPreamble(
-                                      getWriter().getDeclID(TopLevelDecls[I]));
+        TopLevelDeclIDs.push_back(getWriter().getDeclID(TopLevelDecls[I]));
     }
   }
 };
 
+/// \brief Precompiles a preamble, reporting the hash of its top-level names
+/// and the IDs of its top-level declarations through the given references
+/// rather than to an ASTUnit, so that it can run off the ASTUnit's thread.
+///
+/// If \p Cancelled is non-null, parsing stops early once it becomes non-zero.
 class PrecompilePreambleAction : public ASTFrontendAction {
-  ASTUnit &Unit;
+  unsigned &Hash;
+  std::vector<serialization::DeclID> &TopLevelDeclIDs;
+  const volatile llvm::sys::cas_flag *Cancelled;
 
 public:
-  explicit PrecompilePreambleAction(ASTUnit &Unit) : Unit(Unit) {}
+  PrecompilePreambleAction(unsigned &Hash,
+                        std::vector<serialization::DeclID> &TopLevelDeclIDs,
+                           const volatile llvm::sys::cas_flag *Cancelled = 0)
+    : Hash(Hash), TopLevelDeclIDs(TopLevelDeclIDs), Cancelled(Cancelled) {}
 
   virtual ASTConsumer *CreateASTConsumer(CompilerInstance &CI,
                                          StringRef InFile) {
@@ -1009,9 +1378,10 @@ public:
       Sysroot.clear();
 
     CI.getPreprocessor().addPPCallbacks(
-     new MacroDefinitionTrackerPPCallbacks(Unit.getCurrentTopLevelHashValue()));
-    return new PrecompilePreambleConsumer(Unit, CI.getPreprocessor(), Sysroot, 
-                                          OS);
+                                   new MacroDefinitionTrackerPPCallbacks(Hash));
+    return new PrecompilePreambleConsumer(CI.getDiagnostics(), Hash,
+                                          TopLevelDeclIDs, Cancelled,
+                                          CI.getPreprocessor(), Sysroot, OS);
   }
 
   virtual bool hasCodeCompletionSupport() const { return false; }
@@ -1112,6 +1482,7 @@ bool ASTUnit::Parse(llvm::MemoryBuffer *OverrideMainBuffer) {
   Ctx = 0;
   PP = 0;
   Reader = 0;
+  Suspended = false;
   
   // Clear out old caches and data.
   TopLevelDecls.clear();
@@ -1319,6 +1690,139 @@ static llvm::MemoryBuffer *CreatePaddedMainFileBuffer(llvm::MemoryBuffer *Old,
   return Result;
 }
 
+void ASTUnit::BackgroundPreamble::build() {
+  FrontendOptions &FrontendOpts = Invocation->getFrontendOpts();
+
+  // Record the diagnostics rather than reporting them; the ASTUnit that
+  // adopts the preamble replays them along with the preamble.
+  SmallVector<StoredDiagnostic, 4> StoredDiags;
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagIDs(new DiagnosticIDs);
+  IntrusiveRefCntPtr<DiagnosticsEngine>
+    Diags(new DiagnosticsEngine(DiagIDs, &Invocation->getDiagnosticOpts(),
+                                new StoredDiagnosticConsumer(StoredDiags)));
+  ProcessWarningOptions(*Diags, Invocation->getDiagnosticOpts());
+
+  OwningPtr<CompilerInstance> Clang(new CompilerInstance());
+
+  // Recover resources if we crash before exiting this method.
+  llvm::CrashRecoveryContextCleanupRegistrar<CompilerInstance>
+    CICleanup(Clang.get());
+
+  Clang->setInvocation(&*Invocation);
+  Clang->setDiagnostics(&*Diags);
+  Clang->setTarget(TargetInfo::CreateTargetInfo(*Diags,
+                                                &Clang->getTargetOpts()));
+  if (!Clang->hasTarget()) {
+    llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
+    return;
+  }
+  Clang->getTarget().setForcedLangOptions(Clang->getLangOpts());
+
+  Clang->setFileManager(new FileManager(Clang->getFileSystemOpts()));
+  Clang->setSourceManager(new SourceManager(*Diags, Clang->getFileManager()));
+
+  unsigned TopLevelHashValue = 0;
+  std::vector<serialization::DeclID> TopLevelDecls;
+  OwningPtr<PrecompilePreambleAction> Act;
+  Act.reset(new PrecompilePreambleAction(TopLevelHashValue, TopLevelDecls,
+                                         &Cancelled));
+  if (!Act->BeginSourceFile(*Clang.get(), FrontendOpts.Inputs[0])) {
+    llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
+    return;
+  }
+
+  Act->Execute();
+  Act->EndSourceFile();
+
+  if (Diags->hasErrorOccurred() || Cancelled) {
+    llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
+    return;
+  }
+
+  SharedPreamble *SP = new SharedPreamble;
+  SP->Key = Key;
+  SP->PreambleFile = FrontendOpts.OutputFile;
+  SP->EndsAtStartOfLine = EndsAtStartOfLine;
+  SP->ReservedSize = ReservedSize;
+  collectFilesInPreamble(Clang->getSourceManager(), SP->FilesInPreamble);
+  SP->NumWarnings = Diags->getNumWarnings();
+  SP->TopLevelDecls.swap(TopLevelDecls);
+  if (CaptureDiagnostics)
+    SP->Diagnostics.append(StoredDiags.begin(), StoredDiags.end());
+  SP->TopLevelHashValue = TopLevelHashValue;
+  Result = SP;
+}
+
+/// \brief Start precompiling \p PreambleText on a background thread, for a
+/// later reparse to adopt.
+///
+/// \returns false if the build could not be started, in which case the
+/// caller has to rebuild the preamble itself.
+bool ASTUnit::startBackgroundPreamble(
+                                const CompilerInvocation &PreambleInvocationIn,
+                                      StringRef PreambleText,
+                                      bool EndsAtStartOfLine,
+                                      unsigned MainFileSize,
+                                      StringRef Key) {
+  std::string PreamblePCHPath = GetPreamblePCHPath();
+  if (PreamblePCHPath.empty())
+    return false;
+
+  OwningPtr<BackgroundPreamble> Job(new BackgroundPreamble);
+  Job->Invocation = new CompilerInvocation(PreambleInvocationIn);
+  Job->Key = Key;
+  Job->CaptureDiagnostics = CaptureDiagnostics;
+  Job->EndsAtStartOfLine = EndsAtStartOfLine;
+  Job->ReservedSize = MainFileSize < 4096 ? 8191 : MainFileSize * 2;
+
+  FrontendOptions &FrontendOpts = Job->Invocation->getFrontendOpts();
+  PreprocessorOptions &PreprocessorOpts
+    = Job->Invocation->getPreprocessorOpts();
+
+  // The next reparse frees the remapped buffers, so the build needs its own
+  // copies of them.
+  for (PreprocessorOptions::remapped_file_buffer_iterator
+         R = PreprocessorOpts.remapped_file_buffer_begin(),
+         REnd = PreprocessorOpts.remapped_file_buffer_end();
+       R != REnd;
+       ++R) {
+    llvm::MemoryBuffer *Copy
+      = llvm::MemoryBuffer::getMemBufferCopy(R->second->getBuffer(),
+                                             R->second->getBufferIdentifier());
+    Job->OwnedBuffers.push_back(Copy);
+    R->second = Copy;
+  }
+
+  // Remap the main source file to a buffer holding just the preamble, padded
+  // as getMainBufferWithPrecompiledPreamble() does.
+  llvm::MemoryBuffer *PreambleBuffer
+    = llvm::MemoryBuffer::getNewUninitMemBuffer(Job->ReservedSize,
+                                              FrontendOpts.Inputs[0].getFile());
+  memcpy(const_cast<char*>(PreambleBuffer->getBufferStart()),
+         PreambleText.data(), PreambleText.size());
+  memset(const_cast<char*>(PreambleBuffer->getBufferStart())
+           + PreambleText.size(),
+         ' ', Job->ReservedSize - PreambleText.size() - 1);
+  const_cast<char*>(PreambleBuffer->getBufferEnd())[-1] = '\n';
+  Job->OwnedBuffers.push_back(PreambleBuffer);
+
+  llvm::sys::PathWithStatus MainFilePath(FrontendOpts.Inputs[0].getFile());
+  PreprocessorOpts.addRemappedFile(MainFilePath.str(), PreambleBuffer);
+
+  FrontendOpts.ProgramAction = frontend::GeneratePCH;
+  FrontendOpts.OutputFile = PreamblePCHPath;
+  PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
+  PreprocessorOpts.PrecompiledPreambleBytes.second = false;
+
+  if (!Job->start()) {
+    llvm::sys::Path(PreamblePCHPath).eraseFromDisk();
+    return false;
+  }
+
+  PendingPreamble.reset(Job.take());
+  return true;
+}
+
 /// \brief Attempt to build or re-use a precompiled preamble when (re-)parsing
 /// the source file.
 ///
@@ -1364,12 +1868,16 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     // preamble, if we have one. It's obviously no good any more.
     Preamble.clear();
     erasePreambleFile(this);
+    PendingPreamble.reset();
 
     // The next time we actually see a preamble, precompile it.
     PreambleRebuildCounter = 1;
     return 0;
   }
   
+  // A preamble built in the background that we're about to adopt.
+  SharedPreamble *Rebuilt = 0;
+
   if (!Preamble.empty()) {
     // We've previously computed a preamble. Check whether we have the same
     // preamble now that we did before, and that there's enough space in
@@ -1384,64 +1892,18 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
       // preamble.
 
       // Check that none of the files used by the preamble have changed.
-      bool AnyFileChanged = false;
-          
-      // First, make a record of those files that have been overridden via
-      // remapping or unsaved_files.
-      llvm::StringMap<std::pair<off_t, time_t> > OverriddenFiles;
-      for (PreprocessorOptions::remapped_file_iterator
-                R = PreprocessorOpts.remapped_file_begin(),
-             REnd = PreprocessorOpts.remapped_file_end();
-           !AnyFileChanged && R != REnd;
-           ++R) {
-        struct stat StatBuf;
-        if (FileMgr->getNoncachedStatValue(R->second, StatBuf)) {
-          // If we can't stat the file we're remapping to, assume that something
-          // horrible happened.
-          AnyFileChanged = true;
-          break;
-        }
-        
-        OverriddenFiles[R->first] = std::make_pair(StatBuf.st_size, 
-                                                   StatBuf.st_mtime);
-      }
-      for (PreprocessorOptions::remapped_file_buffer_iterator
-                R = PreprocessorOpts.remapped_file_buffer_begin(),
-             REnd = PreprocessorOpts.remapped_file_buffer_end();
-           !AnyFileChanged && R != REnd;
-           ++R) {
-        // FIXME: Should we actually compare the contents of file->buffer
-        // remappings?
-        OverriddenFiles[R->first] = std::make_pair(R->second->getBufferSize(), 
-                                                   0);
-      }
-       
-      // Check whether anything has changed.
-      for (llvm::StringMap<std::pair<off_t, time_t> >::iterator 
-             F = FilesInPreamble.begin(), FEnd = FilesInPreamble.end();
-           !AnyFileChanged && F != FEnd; 
-           ++F) {
-        llvm::StringMap<std::pair<off_t, time_t> >::iterator Overridden
-          = OverriddenFiles.find(F->first());
-        if (Overridden != OverriddenFiles.end()) {
-          // This file was remapped; check whether the newly-mapped file 
-          // matches up with the previous mapping.
-          if (Overridden->second != F->second)
-            AnyFileChanged = true;
-          continue;
-        }
-        
-        // The file was not remapped; check whether it has changed on disk.
-        struct stat StatBuf;
-        if (FileMgr->getNoncachedStatValue(F->first(), StatBuf)) {
-          // If we can't stat the file, assume that something horrible happened.
-          AnyFileChanged = true;
-        } else if (StatBuf.st_size != F->second.first || 
-                   StatBuf.st_mtime != F->second.second)
-          AnyFileChanged = true;
-      }
-          
-      if (!AnyFileChanged) {
+      bool AnyFileChanged = haveFilesInPreambleChanged(*FileMgr,
+                                                       PreprocessorOpts,
+                                                       FilesInPreamble);
+
+      // While a replacement is being built in the background, reparses are
+      // deferred and the AST still comes from this preamble, so code
+      // completion keeps using it even though its headers have changed. A
+      // reparse doesn't go back to it even if the headers changed back, since
+      // a resume in the meantime parsed without it and dropped its top-level
+      // declarations.
+      if ((!AnyFileChanged && !PendingPreamble) ||
+          (PendingPreamble && !AllowRebuild)) {
         // Okay! We can re-use the precompiled preamble.
 
         // Set the state of the diagnostic object to mimic its state
@@ -1457,6 +1919,46 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
                                           PreambleReservedSize,
                                           FrontendOpts.Inputs[0].getFile());
       }
+
+      // One of the files the preamble includes has changed. If we rebuild
+      // preambles in the background, reparses are deferred until the
+      // replacement is ready.
+      if (AllowRebuild && AsynchronousPreambleRebuild) {
+        StringRef PreambleText(NewPreamble.first->getBufferStart(),
+                               NewPreamble.second.first);
+        std::string Key
+          = getSharedPreambleKey(*PreambleInvocation,
+                                 FrontendOpts.Inputs[0].getFile(),
+                                 PreambleText, CaptureDiagnostics);
+        if (PendingPreamble && PendingPreamble->Key != Key)
+          PendingPreamble.reset();
+
+        // Whether the build we're waiting for failed outright; if so, fall
+        // back to rebuilding synchronously rather than deferring reparses
+        // behind a build that keeps failing.
+        bool BackgroundBuildFailed = false;
+        if (PendingPreamble && PendingPreamble->isDone()) {
+          OwningPtr<BackgroundPreamble> Job(PendingPreamble.take());
+          Rebuilt = Job->takeResult();
+          BackgroundBuildFailed = !Rebuilt;
+          if (Rebuilt && haveFilesInPreambleChanged(*FileMgr, PreprocessorOpts,
+                                                 Rebuilt->FilesInPreamble)) {
+            // Something changed again while it was being built.
+            llvm::sys::Path(Rebuilt->PreambleFile).eraseFromDisk();
+            delete Rebuilt;
+            Rebuilt = 0;
+          }
+        }
+
+        if (!Rebuilt && !BackgroundBuildFailed) {
+          if (!PendingPreamble)
+            startBackgroundPreamble(*PreambleInvocation, PreambleText,
+                                    NewPreamble.second.second,
+                                    NewPreamble.first->getBufferSize(), Key);
+          if (PendingPreamble)
+            return 0;
+        }
+      }
     }
 
     // If we aren't allowed to rebuild the precompiled preamble, just
@@ -1464,7 +1966,10 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     if (!AllowRebuild)
       return 0;
 
-    // We can't reuse the previously-computed preamble. Build a new one.
+    // We can't reuse the previously-computed preamble. Build a new one,
+    // unless the one being built in the background already is it.
+    if (!Rebuilt)
+      PendingPreamble.reset();
     Preamble.clear();
     PreambleDiagnostics.clear();
     erasePreambleFile(this);
@@ -1483,6 +1988,66 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     return 0;
   }
 
+  // Another ASTUnit may already have precompiled this very preamble; if so,
+  // share its PCH rather than building our own copy.
+  StringRef MainFilename = FrontendOpts.Inputs[0].getFile();
+  std::string SharedKey
+    = getSharedPreambleKey(*PreambleInvocation, MainFilename,
+                           StringRef(NewPreamble.first->getBufferStart(),
+                                     NewPreamble.second.first),
+                           CaptureDiagnostics);
+  SharedPreamble *SP = Rebuilt ? Rebuilt : acquireSharedPreamble(SharedKey);
+  if (SP) {
+    if (SP->EndsAtStartOfLine == NewPreamble.second.second &&
+        NewPreamble.first->getBufferSize() < SP->ReservedSize-2 &&
+        !haveFilesInPreambleChanged(*FileMgr, PreprocessorOpts,
+                                    SP->FilesInPreamble)) {
+      Preamble.assign(FileMgr->getFile(MainFilename),
+                      NewPreamble.first->getBufferStart(),
+                      NewPreamble.first->getBufferStart()
+                                                  + NewPreamble.second.first);
+      PreambleEndsAtStartOfLine = SP->EndsAtStartOfLine;
+      PreambleReservedSize = SP->ReservedSize;
+      copyFilesInPreamble(SP->FilesInPreamble, FilesInPreamble);
+      NumWarningsInPreamble = SP->NumWarnings;
+      OriginalSourceFile = MainFilename.str();
+
+      checkAndRemoveNonDriverDiags(StoredDiagnostics);
+      PreambleDiagnostics = SP->Diagnostics;
+      TopLevelDecls.clear();
+      TopLevelDeclsInPreamble = SP->TopLevelDecls;
+      setPreambleFile(this, SP->PreambleFile);
+      PreambleRebuildCounter = 1;
+
+      if (SP->TopLevelHashValue != PreambleTopLevelHashValue) {
+        CompletionCacheTopLevelHashValue = 0;
+        PreambleTopLevelHashValue = SP->TopLevelHashValue;
+      }
+
+      getDiagnostics().Reset();
+      ProcessWarningOptions(getDiagnostics(),
+                            PreambleInvocation->getDiagnosticOpts());
+      getDiagnostics().setNumWarnings(NumWarningsInPreamble);
+
+      // A preamble built in the background is ours alone so far; offer it to
+      // other ASTUnits, as if we'd built it here.
+      if (Rebuilt)
+        registerSharedPreamble(Rebuilt);
+
+      return CreatePaddedMainFileBuffer(NewPreamble.first,
+                                        PreambleReservedSize,
+                                        MainFilename);
+    }
+
+    // Not usable by us; let it go again.
+    if (Rebuilt) {
+      llvm::sys::Path(Rebuilt->PreambleFile).eraseFromDisk();
+      delete Rebuilt;
+    } else {
+      releasePreambleFile(SP->PreambleFile);
+    }
+  }
+
   // Create a temporary file for the precompiled preamble. In rare 
   // circumstances, this can fail.
   std::string PreamblePCHPath = GetPreamblePCHPath();
@@ -1508,7 +2073,6 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
 
   // Save the preamble text for later; we'll need to compare against it for
   // subsequent reparses.
-  StringRef MainFilename = PreambleInvocation->getFrontendOpts().Inputs[0].getFile();
   Preamble.assign(FileMgr->getFile(MainFilename),
                   NewPreamble.first->getBufferStart(), 
                   NewPreamble.first->getBufferStart() 
@@ -1589,7 +2153,8 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
                                             Clang->getFileManager()));
   
   OwningPtr<PrecompilePreambleAction> Act;
-  Act.reset(new PrecompilePreambleAction(*this));
+  Act.reset(new PrecompilePreambleAction(CurrentTopLevelHashValue,
+                                         TopLevelDeclsInPreamble));
   if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0])) {
     llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
     Preamble.clear();
@@ -1628,21 +2193,7 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
   
   // Keep track of all of the files that the source manager knows about,
   // so we can verify whether they have changed or not.
-  FilesInPreamble.clear();
-  SourceManager &SourceMgr = Clang->getSourceManager();
-  const llvm::MemoryBuffer *MainFileBuffer
-    = SourceMgr.getBuffer(SourceMgr.getMainFileID());
-  for (SourceManager::fileinfo_iterator F = SourceMgr.fileinfo_begin(),
-                                     FEnd = SourceMgr.fileinfo_end();
-       F != FEnd;
-       ++F) {
-    const FileEntry *File = F->second->OrigEntry;
-    if (!File || F->second->getRawBuffer() == MainFileBuffer)
-      continue;
-    
-    FilesInPreamble[File->getName()]
-      = std::make_pair(F->second->getSize(), File->getModificationTime());
-  }
+  collectFilesInPreamble(Clang->getSourceManager(), FilesInPreamble);
   
   PreambleRebuildCounter = 1;
   PreprocessorOpts.eraseRemappedFile(
@@ -1655,6 +2206,19 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     CompletionCacheTopLevelHashValue = 0;
     PreambleTopLevelHashValue = CurrentTopLevelHashValue;
   }
+
+  // Offer the new preamble to other ASTUnits.
+  SharedPreamble *SP = new SharedPreamble;
+  SP->Key = SharedKey;
+  SP->PreambleFile = FrontendOpts.OutputFile;
+  SP->EndsAtStartOfLine = PreambleEndsAtStartOfLine;
+  SP->ReservedSize = PreambleReservedSize;
+  copyFilesInPreamble(FilesInPreamble, SP->FilesInPreamble);
+  SP->NumWarnings = NumWarningsInPreamble;
+  SP->TopLevelDecls = TopLevelDeclsInPreamble;
+  SP->Diagnostics = PreambleDiagnostics;
+  SP->TopLevelHashValue = PreambleTopLevelHashValue;
+  registerSharedPreamble(SP);
   
   return CreatePaddedMainFileBuffer(NewPreamble.first, 
                                     PreambleReservedSize,
@@ -2016,19 +2580,19 @@ bool ASTUnit::Reparse(RemappedFile *RemappedFiles, unsigned NumRemappedFiles) {
   if (!Invocation)
     return true;
 
-  clearFileLevelDecls();
-  
   SimpleTimer ParsingTimer(WantTiming);
   ParsingTimer.setOutput("Reparsing " + getMainFileName());
 
-  // Remap files.
+  // Remap files. The old buffers can't be freed yet: if this reparse is
+  // deferred, the current AST still refers to them.
   PreprocessorOptions &PPOpts = Invocation->getPreprocessorOpts();
+  std::vector<const llvm::MemoryBuffer *> OldBuffers;
   for (PreprocessorOptions::remapped_file_buffer_iterator 
          R = PPOpts.remapped_file_buffer_begin(),
          REnd = PPOpts.remapped_file_buffer_end();
        R != REnd; 
        ++R) {
-    delete R->second;
+    OldBuffers.push_back(R->second);
   }
   Invocation->getPreprocessorOpts().clearRemappedFiles();
   for (unsigned I = 0; I != NumRemappedFiles; ++I) {
@@ -2049,7 +2613,26 @@ bool ASTUnit::Reparse(RemappedFile *RemappedFiles, unsigned NumRemappedFiles) {
   llvm::MemoryBuffer *OverrideMainBuffer = 0;
   if (!getPreambleFile(this).empty() || PreambleRebuildCounter > 0)
     OverrideMainBuffer = getMainBufferWithPrecompiledPreamble(*Invocation);
-    
+
+  // If the preamble is still being rebuilt in the background, keep the
+  // current AST rather than paying for a parse without a preamble; the new
+  // buffers stay remapped for the reparse that adopts the rebuilt preamble.
+  if (!OverrideMainBuffer && PendingPreamble && !Suspended) {
+    if (ReparseDeferred) {
+      // The buffers being replaced were never parsed.
+      llvm::DeleteContainerPointers(OldBuffers);
+    } else {
+      BuffersOfDeferredReparse.swap(OldBuffers);
+      ReparseDeferred = true;
+    }
+    return false;
+  }
+
+  llvm::DeleteContainerPointers(OldBuffers);
+  llvm::DeleteContainerPointers(BuffersOfDeferredReparse);
+  ReparseDeferred = false;
+  clearFileLevelDecls();
+
   // Clear out the diagnostics state.
   getDiagnostics().Reset();
   ProcessWarningOptions(getDiagnostics(), Invocation->getDiagnosticOpts());
@@ -2072,6 +2655,62 @@ bool ASTUnit::Reparse(RemappedFile *RemappedFiles, unsigned NumRemappedFiles) {
   return Result;
 }
 
+void ASTUnit::waitForPreambleRebuild() {
+  if (PendingPreamble)
+    PendingPreamble->wait();
+}
+
+bool ASTUnit::Suspend() {
+  if (MainFileIsAST || !Invocation)
+    return true;
+
+  if (Suspended)
+    return false;
+
+  // Everything that points into the AST goes first. The source and file
+  // managers stay, since the stored diagnostics refer to them.
+  TopLevelDecls.clear();
+  clearFileLevelDecls();
+  CCTUInfo.reset();
+  TheSema.reset();
+  Consumer.reset();
+  Ctx = 0;
+  PP = 0;
+  Reader = 0;
+  Suspended = true;
+  return false;
+}
+
+bool ASTUnit::Resume() {
+  if (!Suspended)
+    return false;
+
+  SimpleTimer ParsingTimer(WantTiming);
+  ParsingTimer.setOutput("Resuming " + getMainFileName());
+
+  // If the preamble is still being rebuilt in the background, this parses
+  // without one rather than waiting for it.
+  llvm::MemoryBuffer *OverrideMainBuffer = 0;
+  if (!getPreambleFile(this).empty() || PreambleRebuildCounter > 0)
+    OverrideMainBuffer = getMainBufferWithPrecompiledPreamble(*Invocation);
+
+  getDiagnostics().Reset();
+  ProcessWarningOptions(getDiagnostics(), Invocation->getDiagnosticOpts());
+  if (OverrideMainBuffer)
+    getDiagnostics().setNumWarnings(NumWarningsInPreamble);
+
+  // This parses the buffers of any deferred reparse.
+  bool Result = Parse(OverrideMainBuffer);
+  llvm::DeleteContainerPointers(BuffersOfDeferredReparse);
+  ReparseDeferred = false;
+
+  // If the main file can't be parsed any more, e.g. because it was deleted,
+  // throw away whatever was built and stay suspended.
+  if (Result)
+    Suspend();
+  return Result;
+}
+
 //----------------------------------------------------------------------------//
 // Code completion
 //----------------------------------------------------------------------------//
@@ -2108,7 +2747,7 @@ namespace {
         | (1LL << CodeCompletionContext::CCC_ParenthesizedExpression)
         | (1LL << CodeCompletionContext::CCC_Recovery);
 
-      if (AST.getASTContext().getLangOpts().CPlusPlus)
+      if (AST.getLangOpts().CPlusPlus)
         NormalContexts |= (1LL << CodeCompletionContext::CCC_EnumTag)
                        |  (1LL << CodeCompletionContext::CCC_UnionTag)
                        |  (1LL << CodeCompletionContext::CCC_ClassOrStructTag);
@@ -2241,6 +2880,10 @@ void AugmentedCodeCompleteConsumer::ProcessCodeCompleteResults(Sema &S,
     // interested in, we'll add this result.
     if ((C->ShowInContexts & InContexts) == 0)
       continue;
+
+    // Skip cached results that don't match what has been typed so far.
+    if (!Next.matchesTypedPrefix(C->Completion->getTypedText()))
+      continue;
     
     // If we haven't added any results previously, do so now.
     if (!AddedResult) {
@@ -2302,12 +2945,15 @@ void AugmentedCodeCompleteConsumer::ProcessCodeCompleteResults(Sema &S,
   // If we did not add any cached completion results, just forward the
   // results we were given to the next consumer.
   if (!AddedResult) {
+    NumResults = Next.filterResults(Results, NumResults);
     Next.ProcessCodeCompleteResults(S, Context, Results, NumResults);
     return;
   }
   
-  Next.ProcessCodeCompleteResults(S, Context, AllResults.data(),
-                                  AllResults.size());
+  // Only limit the number of results once the cached results have been
+  // merged in, so that the best of both survive.
+  NumResults = Next.filterResults(AllResults.data(), AllResults.size());
+  Next.ProcessCodeCompleteResults(S, Context, AllResults.data(), NumResults);
 }
 
 
@@ -2342,6 +2988,10 @@ void ASTUnit::CodeComplete(StringRef File, unsigned Line, unsigned Column,
   CodeCompleteOpts.IncludeCodePatterns = IncludeCodePatterns;
   CodeCompleteOpts.IncludeGlobals = CachedCompletionResults.empty();
   CodeCompleteOpts.IncludeBriefComments = IncludeBriefComments;
+  // Let Sema drop results that don't match what has been typed so far; the
+  // result limit is applied after merging in the cached results.
+  CodeCompleteOpts.TypedPrefix = Consumer.getTypedPrefix();
+  CodeCompleteOpts.MaxResults = 0;
 
   assert(IncludeBriefComments == this->IncludeBriefCommentsInCodeCompletion);
 
@@ -606,9 +606,8 @@ bool CompilerInstance::InitializeSourceManager(const FrontendInputFile &Input,
 
   if (Input.isBuffer()) {
     SourceMgr.createMainFileIDForMemBuffer(Input.getBuffer(), Kind);
-    assert(!SourceMgr.getMainFileID().isInvalid() &&
-           "Couldn't establish MainFileID!");
-    return true;
+    // The source manager has already complained if the buffer was too large.
+    return !SourceMgr.getMainFileID().isInvalid();
   }
 
   StringRef InputFile = Input.getFile();
@@ -651,9 +650,8 @@ bool CompilerInstance::InitializeSourceManager(const FrontendInputFile &Input,
     SourceMgr.overrideFileContents(File, SB.take());
   }
 
-  assert(!SourceMgr.getMainFileID().isInvalid() &&
-         "Couldn't establish MainFileID!");
-  return true;
+  // The source manager has already complained if the file was too large.
+  return !SourceMgr.getMainFileID().isInvalid();
 }
 
 // High-Level Operations
@@ -566,6 +566,9 @@ bool clang::ParseDiagnosticArgs(DiagnosticOptions &Opts, ArgList &Args,
     = Args.getLastArgIntValue(OPT_fconstexpr_backtrace_limit,
                          DiagnosticOptions::DefaultConstexprBacktraceLimit,
                          Diags);
+  Opts.SpellCheckingLimit
+    = Args.getLastArgIntValue(OPT_fspell_checking_limit,
+                         DiagnosticOptions::DefaultSpellCheckingLimit, Diags);
   Opts.TabStop = Args.getLastArgIntValue(OPT_ftabstop,
                                     DiagnosticOptions::DefaultTabStop, Diags);
   if (Opts.TabStop == 0 || Opts.TabStop > DiagnosticOptions::MaxTabStop) {
@@ -711,9 +714,16 @@ static InputKind ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
     = !Args.hasArg(OPT_no_code_completion_globals);
   Opts.CodeCompleteOpts.IncludeBriefComments
     = Args.hasArg(OPT_code_completion_brief_comments);
+  Opts.CodeCompleteOpts.TypedPrefix
+    = Args.getLastArgValue(OPT_code_completion_prefix);
+  Opts.CodeCompleteOpts.MaxResults
+    = Args.getLastArgIntValue(OPT_code_completion_max_results, 0, Diags);
 
   Opts.OverrideRecordLayoutsFile
     = Args.getLastArgValue(OPT_foverride_record_layout_EQ);
+  Opts.TemplateProfileFile = Args.getLastArgValue(OPT_ftemplate_profile_EQ);
+  Opts.TemplateProfileSummarySize
+    = Args.getLastArgIntValue(OPT_ftemplate_profile_summary_EQ, 0, Diags);
   if (const Arg *A = Args.getLastArg(OPT_arcmt_check,
                                      OPT_arcmt_modify,
                                      OPT_arcmt_migrate)) {
@@ -1207,7 +1217,11 @@ static void ParseLangArgs(LangOptions &Opts, ArgList &Args, InputKind IK,
                                                     Diags);
   Opts.ConstexprCallDepth = Args.getLastArgIntValue(OPT_fconstexpr_depth, 512,
                                                     Diags);
+  Opts.ConstexprStepLimit = Args.getLastArgIntValue(OPT_fconstexpr_steps,
+                                                    1048576, Diags);
   Opts.DelayedTemplateParsing = Args.hasArg(OPT_fdelayed_template_parsing);
+  Opts.DelayedInlineFunctionParsing
+    = Args.hasArg(OPT_fdelayed_inline_function_parsing);
   Opts.NumLargeByValueCopy = Args.getLastArgIntValue(OPT_Wlarge_by_value_copy_EQ,
                                                     0, Diags);
   Opts.MSBitfields = Args.hasArg(OPT_mms_bitfields);
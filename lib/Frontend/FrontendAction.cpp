@@ -21,6 +21,8 @@
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Parse/ParseAST.h"
+#include "clang/Sema/Sema.h"
+#include "clang/Sema/TemplateInstantiationProfiler.h"
 #include "clang/Serialization/ASTDeserializationListener.h"
 #include "clang/Serialization/ASTReader.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -326,13 +328,10 @@ bool FrontendAction::BeginSourceFile(CompilerInstance &CI,
       goto failure;
   }
 
-  // Initialize built-in info as long as we aren't using an external AST
-  // source.
-  if (!CI.hasASTContext() || !CI.getASTContext().getExternalSource()) {
-    Preprocessor &PP = CI.getPreprocessor();
-    PP.getBuiltinInfo().InitializeBuiltins(PP.getIdentifierTable(),
-                                           PP.getLangOpts());
-  }
+  // Initialize built-in info. Even with an external AST source, identifiers
+  // that it does not provide are classified as they are created.
+  CI.getPreprocessor().getBuiltinInfo().InitializeBuiltins(
+      CI.getPreprocessor().getIdentifierTable(), CI.getLangOpts());
 
   // If there is a layout overrides file, attach an external AST source that
   // provides the layouts from that file.
@@ -460,8 +459,29 @@ void ASTFrontendAction::ExecuteAction() {
   if (!CI.hasSema())
     CI.createSema(getTranslationUnitKind(), CompletionConsumer);
 
-  ParseAST(CI.getSema(), CI.getFrontendOpts().ShowStats,
-           CI.getFrontendOpts().SkipFunctionBodies);
+  const FrontendOptions &FEOpts = CI.getFrontendOpts();
+  OwningPtr<TemplateInstantiationProfiler> Profiler;
+  if (!FEOpts.TemplateProfileFile.empty() || FEOpts.TemplateProfileSummarySize)
+    Profiler.reset(new TemplateInstantiationProfiler(CI.getSema()));
+  CI.getSema().TemplateProfiler = Profiler.get();
+
+  ParseAST(CI.getSema(), FEOpts.ShowStats, FEOpts.SkipFunctionBodies);
+
+  if (!Profiler)
+    return;
+  CI.getSema().TemplateProfiler = 0;
+
+  if (!FEOpts.TemplateProfileFile.empty()) {
+    std::string ErrorInfo;
+    llvm::raw_fd_ostream OS(FEOpts.TemplateProfileFile.c_str(), ErrorInfo);
+    if (!ErrorInfo.empty())
+      CI.getDiagnostics().Report(diag::err_fe_unable_to_open_output)
+        << FEOpts.TemplateProfileFile << ErrorInfo;
+    else
+      Profiler->writeTrace(OS);
+  }
+  if (FEOpts.TemplateProfileSummarySize)
+    Profiler->printSummary(llvm::errs(), FEOpts.TemplateProfileSummarySize);
 }
 
 void PluginASTAction::anchor() { }
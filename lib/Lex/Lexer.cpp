@@ -34,6 +34,14 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#elif __ALTIVEC__
+#include <altivec.h>
+#undef bool
+#endif
+
 using namespace clang;
 
 static void InitCharacterInfo();
@@ -1153,6 +1161,112 @@ bool Lexer::isIdentifierBodyChar(char c, const LangOptions &LangOpts) {
   return isIdentifierBody(c) || (c == '$' && LangOpts.DollarIdents);
 }
 
+//===----------------------------------------------------------------------===//
+// Vectorized scanning helpers.
+//===----------------------------------------------------------------------===//
+//
+// Each of these helpers skips a run of "uninteresting" characters 16 bytes at a
+// time and returns a pointer to the first character that the scalar lexing
+// loop has to look at.  They never read at or past End (the nul terminator of
+// the buffer), and they stop early on any character that needs special
+// handling, so the scalar loop that follows them is always correct on its own.
+// Without SSE2 they simply return Ptr.
+
+#ifdef __SSE2__
+/// InRange - Return a byte mask of the characters in V within [Lo, Hi].
+/// Bytes >= 0x80 are negative as signed chars and never match.
+static inline __m128i InRange(__m128i V, char Lo, char Hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(V, _mm_set1_epi8(Lo - 1)),
+                       _mm_cmplt_epi8(V, _mm_set1_epi8(Hi + 1)));
+}
+
+/// FirstMismatch - Given a mask of "boring" characters in the 16 bytes at Ptr,
+/// return the number of leading boring characters (16 if all are).
+static inline unsigned FirstMismatch(__m128i Boring) {
+  unsigned Mask = ~_mm_movemask_epi8(Boring) & 0xFFFF;
+  return Mask ? llvm::CountTrailingZeros_32(Mask) : 16;
+}
+#endif
+
+/// FastSkipIdentifierBody - Skip over characters in [a-zA-Z0-9_].
+static const char *FastSkipIdentifierBody(const char *Ptr, const char *End) {
+#ifdef __SSE2__
+  while (Ptr + 16 <= End) {
+    __m128i V = _mm_loadu_si128((const __m128i*)Ptr);
+    // Folding to lower case maps only A-Z onto a-z; '@', '[' etc. land
+    // outside of the range.
+    __m128i Lower = _mm_or_si128(V, _mm_set1_epi8(0x20));
+    __m128i Boring = _mm_or_si128(InRange(Lower, 'a', 'z'),
+                                  _mm_or_si128(InRange(V, '0', '9'),
+                                     _mm_cmpeq_epi8(V, _mm_set1_epi8('_'))));
+    unsigned N = FirstMismatch(Boring);
+    Ptr += N;
+    if (N != 16)
+      break;
+  }
+#endif
+  return Ptr;
+}
+
+/// FastSkipHorizontalWhitespace - Skip over ' ', '\t', '\f' and '\v'.
+static const char *FastSkipHorizontalWhitespace(const char *Ptr,
+                                                const char *End) {
+#ifdef __SSE2__
+  while (Ptr + 16 <= End) {
+    __m128i V = _mm_loadu_si128((const __m128i*)Ptr);
+    __m128i Boring = _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8(' ')),
+                                  _mm_or_si128(
+                                    _mm_cmpeq_epi8(V, _mm_set1_epi8('\t')),
+                                    InRange(V, '\v', '\f')));
+    unsigned N = FirstMismatch(Boring);
+    Ptr += N;
+    if (N != 16)
+      break;
+  }
+#endif
+  return Ptr;
+}
+
+/// FastSkipLineCommentBody - Skip to the next '\n', '\r' or '\0'.
+static const char *FastSkipLineCommentBody(const char *Ptr, const char *End) {
+#ifdef __SSE2__
+  while (Ptr + 16 <= End) {
+    __m128i V = _mm_loadu_si128((const __m128i*)Ptr);
+    __m128i Special = _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\n')),
+                                   _mm_or_si128(
+                                     _mm_cmpeq_epi8(V, _mm_set1_epi8('\r')),
+                                     _mm_cmpeq_epi8(V, _mm_setzero_si128())));
+    int Mask = _mm_movemask_epi8(Special);
+    if (Mask != 0)
+      return Ptr + llvm::CountTrailingZeros_32(Mask);
+    Ptr += 16;
+  }
+#endif
+  return Ptr;
+}
+
+/// FastSkipStringLiteralBody - Skip over characters in a string literal that
+/// cannot end it or need decoding: everything but '"', '\\', '?' (which may
+/// start a trigraph), '\n', '\r' and '\0'.
+static const char *FastSkipStringLiteralBody(const char *Ptr,
+                                             const char *End) {
+#ifdef __SSE2__
+  while (Ptr + 16 <= End) {
+    __m128i V = _mm_loadu_si128((const __m128i*)Ptr);
+    __m128i Special =
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('"')),
+                                _mm_cmpeq_epi8(V, _mm_set1_epi8('\\'))),
+                   _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('?')),
+                                InRange(V, '\0', '\r')));
+    int Mask = _mm_movemask_epi8(Special);
+    if (Mask != 0)
+      return Ptr + llvm::CountTrailingZeros_32(Mask);
+    Ptr += 16;
+  }
+#endif
+  return Ptr;
+}
+
 
 //===----------------------------------------------------------------------===//
 // Diagnostics forwarding code.
@@ -1502,6 +1616,7 @@ void Lexer::SkipBytes(unsigned Bytes, bool StartOfLine) {
 void Lexer::LexIdentifier(Token &Result, const char *CurPtr) {
   // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z$]
   unsigned Size;
+  CurPtr = FastSkipIdentifierBody(CurPtr, BufferEnd);
   unsigned char C = *CurPtr++;
   while (isIdentifierBody(C))
     C = *CurPtr++;
@@ -1673,6 +1788,7 @@ void Lexer::LexStringLiteral(Token &Result, const char *CurPtr,
        Kind == tok::utf32_string_literal))
     Diag(BufferPtr, diag::warn_cxx98_compat_unicode_literal);
 
+  CurPtr = FastSkipStringLiteralBody(CurPtr, BufferEnd);
   char C = getAndAdvanceChar(CurPtr, Result);
   while (C != '"') {
     // Skip escaped characters.  Escaped newlines will already be processed by
@@ -1697,6 +1813,7 @@ void Lexer::LexStringLiteral(Token &Result, const char *CurPtr,
 
       NulCharacter = CurPtr-1;
     }
+    CurPtr = FastSkipStringLiteralBody(CurPtr, BufferEnd);
     C = getAndAdvanceChar(CurPtr, Result);
   }
 
@@ -1895,6 +2012,10 @@ bool Lexer::SkipWhitespace(Token &Result, const char *CurPtr) {
   unsigned char Char = *CurPtr;  // Skip consequtive spaces efficiently.
   while (1) {
     // Skip horizontal whitespace very aggressively.
+    if (isHorizontalWhitespace(Char)) {
+      CurPtr = FastSkipHorizontalWhitespace(CurPtr, BufferEnd);
+      Char = *CurPtr;
+    }
     while (isHorizontalWhitespace(Char))
       Char = *++CurPtr;
 
@@ -1953,6 +2074,7 @@ bool Lexer::SkipLineComment(Token &Result, const char *CurPtr) {
   // them.  As such, optimize for this case with the inner loop.
   char C;
   do {
+    CurPtr = FastSkipLineCommentBody(CurPtr, BufferEnd);
     C = *CurPtr;
     // Skip over characters in the fast loop.
     while (C != 0 &&                // Potentially EOF.
@@ -2150,13 +2272,6 @@ static bool isEndOfBlockCommentWithEscapedNewLine(const char *CurPtr,
   return true;
 }
 
-#ifdef __SSE2__
-#include <emmintrin.h>
-#elif __ALTIVEC__
-#include <altivec.h>
-#undef bool
-#endif
-
 /// We have just read from input the / and * characters that started a comment.
 /// Read until we find the * and / characters that terminate the comment.
 /// Note that we don't bother decoding trigraphs or escaped newlines in block
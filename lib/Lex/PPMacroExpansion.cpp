@@ -47,6 +47,7 @@ void Preprocessor::setMacroInfo(IdentifierInfo *II, MacroInfo *MI) {
   assert(MI->getUndefLoc().isInvalid() &&
          "Undefined macros cannot be registered");
 
+  ++MacroDefinitionGeneration;
   MacroInfo *&StoredMI = Macros[II];
   MI->setPreviousDefinition(StoredMI);
   StoredMI = MI;
@@ -61,6 +62,7 @@ void Preprocessor::addLoadedMacroInfo(IdentifierInfo *II, MacroInfo *MI,
   assert(MI->isFromAST() && "Macro is not from an AST?");
   assert(!MI->getPreviousDefinition() && "Macro already in chain?");
   
+  ++MacroDefinitionGeneration;
   MacroInfo *&StoredMI = Macros[II];
 
   // Easy case: this is the first macro definition for this macro.
@@ -128,6 +130,7 @@ void Preprocessor::makeLoadedMacroInfoVisible(IdentifierInfo *II,
                                               MacroInfo *MI) {
   assert(MI->isFromAST() && "Macro must be from the AST");
 
+  ++MacroDefinitionGeneration;
   MacroInfo *&StoredMI = Macros[II];
   if (StoredMI == MI) {
     // Easy case: this is the first macro anyway.
@@ -156,6 +159,7 @@ void Preprocessor::makeLoadedMacroInfoVisible(IdentifierInfo *II,
 void Preprocessor::clearMacroInfo(IdentifierInfo *II) {
   assert(II->hasMacroDefinition() && "Macro is not defined!");
   assert(Macros[II]->getUndefLoc().isValid() && "Macro is still defined!");
+  ++MacroDefinitionGeneration;
   II->setHasMacroDefinition(false);
   if (II->isFromAST())
     II->setChangedSinceDeserialization();
@@ -465,6 +469,15 @@ bool Preprocessor::HandleMacroExpandedIdentifier(Token &Identifier,
     return false;
   }
 
+  // If this object-like macro always expands to the same tokens, replay its
+  // cached expansion instead of expanding it again.
+  if (MI->isObjectLike())
+    if (const CachedMacroExpansion *Cached = getCachedMacroExpansion(MI))
+      if (EnterCachedMacroExpansion(Identifier, *Cached)) {
+        ++NumCachedMacroExpanded;
+        return false;
+      }
+
   // Start expanding the macro.
   EnterMacro(Identifier, ExpansionEnd, MI, Args);
 
@@ -474,6 +487,203 @@ bool Preprocessor::HandleMacroExpandedIdentifier(Token &Identifier,
   return false;
 }
 
+/// \brief The maximum number of tokens and nested macro expansions in a cached
+/// macro expansion.
+enum { MaxCachedExpansionTokens = 64, MaxCachedExpansionNodes = 16 };
+
+const Preprocessor::CachedMacroExpansion *
+Preprocessor::getCachedMacroExpansion(MacroInfo *MI) {
+  assert(MI->isObjectLike() && MI->getNumTokens() != 0 &&
+         "Only non-empty object-like macros have cached expansions");
+  CachedMacroExpansion *&Slot = CachedMacroExpansions[MI];
+  if (!Slot) {
+    Slot = new CachedMacroExpansion();
+    Slot->Generation = MacroDefinitionGeneration;
+    Slot->Computed = Slot->Valid = false;
+    return 0;
+  }
+  CachedMacroExpansion *Entry = Slot;
+
+  // If any macro was (un)defined since we computed this expansion, it may be
+  // stale.  Many macros are only used once, so wait for the second use before
+  // doing any work.
+  if (Entry->Generation != MacroDefinitionGeneration) {
+    Entry->Generation = MacroDefinitionGeneration;
+    Entry->Computed = Entry->Valid = false;
+    return 0;
+  }
+
+  if (!Entry->Computed) {
+    Entry->Nodes.clear();
+    Entry->Tokens.clear();
+    Entry->TokenLocs.clear();
+    Entry->Computed = true;
+    Entry->Valid = computeCachedMacroExpansion(*Entry, MI, 0, 0, 0, Token());
+
+    // Bringing identifiers up to date from an external source can define
+    // macros; if that happened, don't trust what we computed.
+    if (Entry->Generation != MacroDefinitionGeneration) {
+      Entry->Generation = MacroDefinitionGeneration;
+      Entry->Computed = Entry->Valid = false;
+    }
+  }
+
+  return Entry->Valid ? Entry : 0;
+}
+
+bool Preprocessor::computeCachedMacroExpansion(CachedMacroExpansion &Entry,
+                                               MacroInfo *MI, unsigned Parent,
+                                               unsigned NameIndex,
+                                               unsigned NameOffset,
+                                               const Token &NameTok) {
+  if (Entry.Nodes.size() == MaxCachedExpansionNodes)
+    return false;
+
+  unsigned NodeIdx = Entry.Nodes.size();
+  CachedMacroExpansion::Node N;
+  N.MI = MI;
+  N.Parent = Parent;
+  N.NameIndex = NameIndex;
+  N.NameOffset = NameOffset;
+  N.DefStart = SourceMgr.getExpansionLoc(MI->getReplacementToken(0)
+                                           .getLocation());
+  N.DefLength = MI->getDefinitionLength(SourceMgr);
+  Entry.Nodes.push_back(N);
+
+  for (unsigned I = 0, E = MI->getNumTokens(); I != E; ++I) {
+    Token Tok = MI->getReplacementToken(I);
+
+    // Token pasting and comments (with -CC) need the TokenLexer.
+    if (Tok.is(tok::hashhash) || Tok.is(tok::comment))
+      return false;
+
+    unsigned Offset;
+    if (!Tok.getLocation().isFileID() ||
+        !SourceMgr.isInSLocAddrSpace(Tok.getLocation(), N.DefStart,
+                                     N.DefLength, &Offset))
+      return false;
+
+    // The first token of a nested expansion gets the spacing of the macro
+    // name it replaces.  The caller fixes up the very first token.
+    if (I == 0 && NodeIdx != 0) {
+      Tok.setFlagValue(Token::StartOfLine, NameTok.isAtStartOfLine());
+      Tok.setFlagValue(Token::LeadingSpace, NameTok.hasLeadingSpace());
+    }
+
+    if (IdentifierInfo *II = Tok.getIdentifierInfo()) {
+      if (II->isOutOfDate())
+        getExternalSource()->updateOutOfDateIdentifier(*II);
+      Tok.setKind(II->getTokenID());
+
+      if (MacroInfo *NestedMI = getMacroInfo(II)) {
+        // Only plain, non-empty object-like macros expand the same way
+        // everywhere.  Function-like macros depend on the tokens that follow.
+        if (!NestedMI->isObjectLike() || NestedMI->isBuiltinMacro() ||
+            NestedMI->getNumTokens() == 0 || NestedMI->isAmbiguous())
+          return false;
+
+        // A macro being expanded isn't expanded again; leave that to the
+        // TokenLexer.
+        for (unsigned P = NodeIdx; ; P = Entry.Nodes[P].Parent) {
+          if (Entry.Nodes[P].MI == NestedMI)
+            return false;
+          if (P == 0)
+            break;
+        }
+
+        if (!computeCachedMacroExpansion(Entry, NestedMI, NodeIdx, I, Offset,
+                                         Tok))
+          return false;
+        continue;
+      }
+
+      // Poisoned identifiers, extension keywords and the like need
+      // HandleIdentifier.
+      if (II->isHandleIdentifierCase())
+        return false;
+    }
+
+    if (Entry.Tokens.size() == MaxCachedExpansionTokens)
+      return false;
+    Entry.Tokens.push_back(Tok);
+    Entry.TokenLocs.push_back(std::make_pair(NodeIdx, Offset));
+  }
+
+  return true;
+}
+
+bool
+Preprocessor::EnterCachedMacroExpansion(Token &Identifier,
+                                        const CachedMacroExpansion &Entry) {
+  // The nested macros must all be expandable here, and the identifiers we
+  // produce must not need any special handling.
+  for (unsigned I = 1, E = Entry.Nodes.size(); I != E; ++I)
+    if (!Entry.Nodes[I].MI->isEnabled())
+      return false;
+  for (unsigned I = 0, E = Entry.Tokens.size(); I != E; ++I)
+    if (IdentifierInfo *II = Entry.Tokens[I].getIdentifierInfo())
+      if (II->isHandleIdentifierCase())
+        return false;
+
+  // Create the same source location entries that expanding each macro would
+  // have: one covering the definition of each macro, expanded at the location
+  // of its name.  The caller already took care of the outermost macro's
+  // callback and statistics.
+  SmallVector<SourceLocation, 4> DefLocs;
+  for (unsigned I = 0, E = Entry.Nodes.size(); I != E; ++I) {
+    const CachedMacroExpansion::Node &N = Entry.Nodes[I];
+    SourceLocation ExpandLoc = I == 0 ? Identifier.getLocation()
+      : DefLocs[N.Parent].getLocWithOffset(N.NameOffset);
+    DefLocs.push_back(SourceMgr.createExpansionLoc(N.DefStart, ExpandLoc,
+                                                   ExpandLoc, N.DefLength));
+    markMacroAsUsed(N.MI);
+    if (I == 0)
+      continue;
+
+    ++NumMacroExpanded;
+    if (Callbacks) {
+      Token NameTok =
+        Entry.Nodes[N.Parent].MI->getReplacementToken(N.NameIndex);
+      NameTok.setLocation(ExpandLoc);
+      SourceRange Range(ExpandLoc, ExpandLoc);
+      if (InMacroArgs)
+        DelayedMacroExpandsCallbacks.push_back(
+                                        MacroExpandsInfo(NameTok, N.MI, Range));
+      else
+        Callbacks->MacroExpands(NameTok, N.MI, Range);
+    }
+  }
+
+  bool IsAtStartOfLine = Identifier.isAtStartOfLine();
+  bool HasLeadingSpace = Identifier.hasLeadingSpace();
+
+  // A single token replaces the identifier directly.
+  unsigned NumToks = Entry.Tokens.size();
+  if (NumToks == 1) {
+    Identifier = Entry.Tokens[0];
+    Identifier.setLocation(DefLocs[Entry.TokenLocs[0].first]
+                             .getLocWithOffset(Entry.TokenLocs[0].second));
+    Identifier.setFlagValue(Token::StartOfLine, IsAtStartOfLine);
+    Identifier.setFlagValue(Token::LeadingSpace, HasLeadingSpace);
+    return true;
+  }
+
+  Token *Toks = new Token[NumToks];
+  for (unsigned I = 0; I != NumToks; ++I) {
+    Toks[I] = Entry.Tokens[I];
+    Toks[I].setLocation(DefLocs[Entry.TokenLocs[I].first]
+                          .getLocWithOffset(Entry.TokenLocs[I].second));
+  }
+  Toks[0].setFlagValue(Token::StartOfLine, IsAtStartOfLine);
+  Toks[0].setFlagValue(Token::LeadingSpace, HasLeadingSpace);
+
+  // None of the tokens can be expanded further.
+  EnterTokenStream(Toks, NumToks, /*DisableMacroExpansion=*/true,
+                   /*OwnsTokens=*/true);
+  Lex(Identifier);
+  return true;
+}
+
 /// ReadFunctionLikeMacroArgs - After reading "MACRO" and knowing that the next
 /// token is the '(' of the macro, this method is invoked to read all of the
 /// actual arguments specified for the macro invocation.  This returns null on
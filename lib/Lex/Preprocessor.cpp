@@ -82,6 +82,7 @@ Preprocessor::Preprocessor(llvm::IntrusiveRefCntPtr<PreprocessorOptions> PPOpts,
   NumEnteredSourceFiles = 0;
   NumMacroExpanded = NumFnMacroExpanded = NumBuiltinMacroExpanded = 0;
   NumFastMacroExpanded = NumTokenPaste = NumFastTokenPaste = 0;
+  NumCachedMacroExpanded = 0;
   MaxIncludeStackDepth = 0;
   NumSkipped = 0;
   
@@ -96,6 +97,7 @@ Preprocessor::Preprocessor(llvm::IntrusiveRefCntPtr<PreprocessorOptions> PPOpts,
   InMacroArgs = false;
   InMacroArgPreExpansion = false;
   NumCachedTokenLexers = 0;
+  MacroDefinitionGeneration = 0;
   PragmasEnabled = true;
 
   CachedLexPos = 0;
@@ -154,6 +156,12 @@ Preprocessor::~Preprocessor() {
   for (unsigned i = 0, e = NumCachedTokenLexers; i != e; ++i)
     delete TokenLexerCache[i];
 
+  // Free any cached macro expansions.
+  for (llvm::DenseMap<const MacroInfo*, CachedMacroExpansion*>::iterator
+         I = CachedMacroExpansions.begin(), E = CachedMacroExpansions.end();
+       I != E; ++I)
+    delete I->second;
+
   // Free any cached MacroArgs.
   for (MacroArgs *ArgList = MacroArgCache; ArgList; )
     ArgList = ArgList->deallocate();
@@ -239,7 +247,8 @@ void Preprocessor::PrintStats() {
 
   llvm::errs() << NumMacroExpanded << "/" << NumFnMacroExpanded << "/"
              << NumBuiltinMacroExpanded << " obj/fn/builtin macros expanded, "
-             << NumFastMacroExpanded << " on the fast path.\n";
+             << NumFastMacroExpanded << " on the fast path, "
+             << NumCachedMacroExpanded << " replayed from the cache.\n";
   llvm::errs() << (NumFastTokenPaste+NumTokenPaste)
              << " token paste (##) operations performed, "
              << NumFastTokenPaste << " on the fast path.\n";
@@ -425,7 +434,7 @@ void Preprocessor::CreateString(StringRef Str, Token &Tok,
   const char *DestPtr;
   SourceLocation Loc = ScratchBuf->getToken(Str.data(), Str.size(), DestPtr);
 
-  if (ExpansionLocStart.isValid())
+  if (ExpansionLocStart.isValid() && Loc.isValid())
     Loc = SourceMgr.createExpansionLoc(Loc, ExpansionLocStart,
                                        ExpansionLocEnd, Str.size());
   Tok.setLocation(Loc);
@@ -481,7 +490,9 @@ void Preprocessor::EnterMainSourceFile() {
     llvm::MemoryBuffer::getMemBufferCopy(Predefines, "<built-in>");
   assert(SB && "Cannot create predefined source buffer");
   FileID FID = SourceMgr.createFileIDForMemBuffer(SB);
-  assert(!FID.isInvalid() && "Could not create FileID for predefines?");
+  // The source manager has already complained if it ran out of locations.
+  if (FID.isInvalid())
+    return;
 
   // Start parsing the predefines.
   EnterSourceFile(FID, 0, SourceLocation());
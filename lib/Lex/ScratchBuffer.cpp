@@ -29,7 +29,8 @@ ScratchBuffer::ScratchBuffer(SourceManager &SM) : SourceMgr(SM), CurBuffer(0) {
 /// getToken - Splat the specified text into a temporary MemoryBuffer and
 /// return a SourceLocation that refers to the token.  This is just like the
 /// method below, but returns a location that indicates the physloc of the
-/// token.
+/// token.  The location is invalid if the source manager ran out of source
+/// locations for the buffer; the text is still stored at DestPtr.
 SourceLocation ScratchBuffer::getToken(const char *Buf, unsigned Len,
                                        const char *&DestPtr) {
   if (BytesUsed+Len+2 > ScratchBufSize)
@@ -53,6 +54,8 @@ SourceLocation ScratchBuffer::getToken(const char *Buf, unsigned Len,
   // diagnostic points to one.
   CurBuffer[BytesUsed-1] = '\0';
 
+  if (BufferStartLoc.isInvalid())
+    return SourceLocation();
   return BufferStartLoc.getLocWithOffset(BytesUsed-Len-1);
 }
 
@@ -66,7 +69,10 @@ void ScratchBuffer::AllocScratchBuffer(unsigned RequestLen) {
   llvm::MemoryBuffer *Buf =
     llvm::MemoryBuffer::getNewMemBuffer(RequestLen, "<scratch space>");
   FileID FID = SourceMgr.createFileIDForMemBuffer(Buf);
-  BufferStartLoc = SourceMgr.getLocForStartOfFile(FID);
+  // If the source manager ran out of locations, it has already complained;
+  // the buffer is still owned by it, so keep using it without locations.
+  BufferStartLoc = FID.isInvalid() ? SourceLocation()
+                                   : SourceMgr.getLocForStartOfFile(FID);
   CurBuffer = const_cast<char*>(Buf->getBufferStart());
   BytesUsed = 1;
   CurBuffer[0] = '0';  // Start out with a \0 for cleanliness.
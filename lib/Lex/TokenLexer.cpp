@@ -647,14 +647,19 @@ bool TokenLexer::PasteTokens(Token &Tok) {
     StartLoc = getExpansionLocForMacroDefLoc(StartLoc);
   if (EndLoc.isFileID())
     EndLoc = getExpansionLocForMacroDefLoc(EndLoc);
-  FileID MacroFID = SM.getFileID(MacroExpansionStart);
-  while (SM.getFileID(StartLoc) != MacroFID)
-    StartLoc = SM.getImmediateExpansionRange(StartLoc).first;
-  while (SM.getFileID(EndLoc) != MacroFID)
-    EndLoc = SM.getImmediateExpansionRange(EndLoc).second;
-    
-  Tok.setLocation(SM.createExpansionLoc(Tok.getLocation(), StartLoc, EndLoc,
-                                        Tok.getLength()));
+  // Without a macro expansion entry, which happens once the source manager
+  // runs out of locations, there is no expansion to walk up to.
+  if (MacroExpansionStart.isValid()) {
+    FileID MacroFID = SM.getFileID(MacroExpansionStart);
+    while (SM.getFileID(StartLoc) != MacroFID)
+      StartLoc = SM.getImmediateExpansionRange(StartLoc).first;
+    while (SM.getFileID(EndLoc) != MacroFID)
+      EndLoc = SM.getImmediateExpansionRange(EndLoc).second;
+  }
+
+  if (Tok.getLocation().isValid())
+    Tok.setLocation(SM.createExpansionLoc(Tok.getLocation(), StartLoc, EndLoc,
+                                          Tok.getLength()));
 
   // Now that we got the result token, it will be subject to expansion.  Since
   // token pasting re-lexes the result token in raw mode, identifier information
@@ -704,11 +709,15 @@ void TokenLexer::HandleMicrosoftCommentPaste(Token &Tok) {
 /// definition, returns the appropriate source location pointing at the
 /// macro expansion source location entry, otherwise it returns an invalid
 /// SourceLocation.
+///
+/// If the source manager ran out of locations for the macro expansion entry,
+/// \arg loc itself is returned, so that the token keeps its spelling.
 SourceLocation
 TokenLexer::getExpansionLocForMacroDefLoc(SourceLocation loc) const {
-  assert(ExpandLocStart.isValid() && MacroExpansionStart.isValid() &&
-         "Not appropriate for token streams");
+  assert(ExpandLocStart.isValid() && "Not appropriate for token streams");
   assert(loc.isValid() && loc.isFileID());
+  if (MacroExpansionStart.isInvalid())
+    return loc;
   
   SourceManager &SM = PP.getSourceManager();
   assert(SM.isInSLocAddrSpace(loc, MacroDefStart, MacroDefLength) &&
@@ -771,6 +780,13 @@ static void updateConsecutiveMacroArgTokens(SourceManager &SM,
   SourceLocation Expansion =
       SM.createMacroArgExpansionLoc(FirstLoc, InstLoc,FullLength);
 
+  // If the source manager ran out of locations, the tokens keep their
+  // spelling locations.
+  if (Expansion.isInvalid()) {
+    begin_tokens = NextTok;
+    return;
+  }
+
   // Change the location of the tokens from the spelling location to the new
   // expanded location.
   for (; begin_tokens < NextTok; ++begin_tokens) {
@@ -799,9 +815,11 @@ void TokenLexer::updateLocForMacroArgTokens(SourceLocation ArgIdSpellLoc,
     // If there's only one token just create a SLocEntry for it.
     if (end_tokens - begin_tokens == 1) {
       Token &Tok = *begin_tokens;
-      Tok.setLocation(SM.createMacroArgExpansionLoc(Tok.getLocation(),
-                                                    InstLoc,
-                                                    Tok.getLength()));
+      SourceLocation Expansion =
+          SM.createMacroArgExpansionLoc(Tok.getLocation(), InstLoc,
+                                        Tok.getLength());
+      if (Expansion.isValid())
+        Tok.setLocation(Expansion);
       return;
     }
 
@@ -19,6 +19,39 @@
 #include "clang/Sema/Scope.h"
 using namespace clang;
 
+/// \brief Determine whether the body of the inline function \p D can be left
+/// unparsed until the function is used, under
+/// -fdelayed-inline-function-parsing.
+static bool canDelayInlineFunctionBody(Sema &S, SourceManager &SM, Decl *D) {
+  // Function templates are handled by -fdelayed-template-parsing.
+  FunctionDecl *FD = dyn_cast_or_null<FunctionDecl>(D);
+  if (!FD || FD->isInvalidDecl() || FD->isDependentContext() ||
+      FD->getTemplatedKind() != FunctionDecl::TK_NonTemplate)
+    return false;
+
+  // The bodies are parsed from ActOnEndOfTranslationUnit, which does not run
+  // for PCH files and modules.
+  if (S.TUKind != TU_Complete)
+    return false;
+
+  // A constexpr function may be needed by constant evaluation before the end
+  // of the translation unit, and a function marked 'used' is emitted whether
+  // or not it is used.
+  if (FD->isConstexpr() || FD->hasAttr<UsedAttr>())
+    return false;
+
+  // Friends are not found in the class they are defined in, and local classes
+  // can refer to the declarations of the enclosing function; keep it simple
+  // and parse both as usual.
+  if (FD->getFriendObjectKind() != Decl::FOK_None ||
+      FD->getParentFunctionOrMethod())
+    return false;
+
+  // Functions defined in the main file are usually used, so only delay the
+  // ones that come from headers.
+  return !SM.isFromMainFile(SM.getExpansionLoc(FD->getLocation()));
+}
+
 /// ParseCXXInlineMethodDef - We parsed and verified that the specified
 /// Declarator is a well formed C++ inline method definition. Now lex its body
 /// and store its tokens for parsing after the C++ class is complete.
@@ -135,6 +168,23 @@ Decl *Parser::ParseCXXInlineMethodDef(AccessSpecifier AS,
     return FnD;
   }
 
+  // In delayed inline function parsing mode, store the tokens of the body of
+  // an inline function from a header. They are only parsed at the end of the
+  // translation unit, and only if the function is used.
+  if (getLangOpts().DelayedInlineFunctionParsing &&
+      DefinitionKind == FDK_Definition &&
+      canDelayInlineFunctionBody(Actions, PP.getSourceManager(), FnD)) {
+    LateParsedTemplatedFunction *LPT = new LateParsedTemplatedFunction(FnD);
+
+    FunctionDecl *FD = cast<FunctionDecl>(FnD);
+    Actions.CheckForFunctionRedefinition(FD);
+
+    LateParsedTemplateMap[FD] = LPT;
+    Actions.MarkAsLateParsedTemplate(FD);
+    LexTemplateFunctionForLateParsing(LPT->Toks);
+    return FnD;
+  }
+
   // Consume the tokens and store them for later parsing.
 
   LexedMethod* LM = new LexedMethod(this, FnD);
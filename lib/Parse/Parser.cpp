@@ -543,8 +543,10 @@ bool Parser::ParseTopLevelDecl(DeclGroupPtrTy &Result) {
 
   Result = DeclGroupPtrTy();
   if (Tok.is(tok::eof)) {
-    // Late template parsing can begin.
-    if (getLangOpts().DelayedTemplateParsing)
+    // Late template parsing, and the parsing of delayed inline function
+    // bodies, can begin.
+    if (getLangOpts().DelayedTemplateParsing ||
+        getLangOpts().DelayedInlineFunctionParsing)
       Actions.SetLateTemplateParser(LateTemplateParserCallback, this);
     if (!PP.isIncrementalProcessingEnabled())
       Actions.ActOnEndOfTranslationUnit();
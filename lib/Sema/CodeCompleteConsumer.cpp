@@ -623,6 +623,62 @@ static StringRef getOrderedName(const CodeCompletionResult &R,
   return Saved;
 }
     
+static bool startsWithIgnoringCase(StringRef Name, StringRef Prefix) {
+  return Name.size() >= Prefix.size() &&
+         Name.substr(0, Prefix.size()).equals_lower(Prefix);
+}
+
+namespace {
+  /// \brief Whether a code-completion result matches the typed prefix.
+  struct MatchesTypedPrefix {
+    StringRef Prefix;
+
+    explicit MatchesTypedPrefix(StringRef Prefix) : Prefix(Prefix) { }
+
+    bool operator()(const CodeCompletionResult &R) const {
+      std::string Saved;
+      return startsWithIgnoringCase(getOrderedName(R, Saved), Prefix);
+    }
+  };
+
+  /// \brief Orders code-completion results from the best match for the
+  /// typed prefix to the worst.
+  struct BetterTypedPrefixMatch {
+    StringRef Prefix;
+
+    explicit BetterTypedPrefixMatch(StringRef Prefix) : Prefix(Prefix) { }
+
+    bool operator()(const CodeCompletionResult &X,
+                    const CodeCompletionResult &Y) const {
+      std::string XSaved, YSaved;
+      bool XExact = getOrderedName(X, XSaved).startswith(Prefix);
+      bool YExact = getOrderedName(Y, YSaved).startswith(Prefix);
+      if (XExact != YExact)
+        return XExact;
+      return X.Priority < Y.Priority;
+    }
+  };
+}
+
+bool CodeCompleteConsumer::matchesTypedPrefix(StringRef Name) const {
+  return startsWithIgnoringCase(Name, getTypedPrefix());
+}
+
+unsigned CodeCompleteConsumer::filterResults(CodeCompletionResult *Results,
+                                             unsigned NumResults) const {
+  StringRef Prefix = getTypedPrefix();
+  CodeCompletionResult *End = Results + NumResults;
+  if (!Prefix.empty())
+    End = std::stable_partition(Results, End, MatchesTypedPrefix(Prefix));
+
+  unsigned MaxResults = getMaxResults();
+  if (MaxResults && unsigned(End - Results) > MaxResults) {
+    std::stable_sort(Results, End, BetterTypedPrefixMatch(Prefix));
+    End = Results + MaxResults;
+  }
+  return End - Results;
+}
+
 bool clang::operator<(const CodeCompletionResult &X, 
                       const CodeCompletionResult &Y) {
   std::string XSaved, YSaved;
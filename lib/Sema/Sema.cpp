@@ -32,6 +32,7 @@
 #include "clang/Sema/ExternalSemaSource.h"
 #include "clang/Sema/MultiplexExternalSemaSource.h"
 #include "clang/Sema/ObjCMethodList.h"
+#include "clang/Sema/Overload.h"
 #include "clang/Sema/PrettyDeclStackTrace.h"
 #include "clang/Sema/Scope.h"
 #include "clang/Sema/ScopeInfo.h"
@@ -85,10 +86,17 @@ Sema::Sema(Preprocessor &pp, ASTContext &ctxt, ASTConsumer &consumer,
     NSDictionaryDecl(0), DictionaryWithObjectsMethod(0),
     GlobalNewDeleteDeclared(false), 
     TUKind(TUKind),
-    NumSFINAEErrors(0), InFunctionDeclarator(0),
+    NumSFINAEErrors(0), NumOverloadCandidates(0),
+    NumViableOverloadCandidates(0), NumOverloadCandidatesPrefiltered(0),
+    ComputingCachedUserConversions(0),
+    NumUserConversionCacheHits(0), NumUserConversionCacheMisses(0),
+    NumDeductionMemoHits(0), NumDeductionMemoMisses(0),
+    InFunctionDeclarator(0),
     AccessCheckingSFINAE(false), InNonInstantiationSFINAEContext(false),
-    NonInstantiationEntries(0), ArgumentPackSubstitutionIndex(-1),
+    NonInstantiationEntries(0), TemplateProfiler(0),
+    ArgumentPackSubstitutionIndex(-1),
     CurrentInstantiationScope(0), TyposCorrected(0),
+    NumTypoCorrectionCacheHits(0), NumTypoCorrectionsOverLimit(0),
     AnalysisWarnings(*this)
 {
   TUScope = 0;
@@ -181,6 +189,8 @@ Sema::~Sema() {
     delete FunctionScopes[I];
   if (FunctionScopes.size() == 1)
     delete FunctionScopes[0];
+
+  clearMemoizedDeductions();
   
   // Tell the SemaConsumer to forget about us; we're going out of scope.
   if (SemaConsumer *SC = dyn_cast<SemaConsumer>(&Consumer))
@@ -250,6 +260,21 @@ void Sema::addExternalSource(ExternalSemaSource *E) {
 void Sema::PrintStats() const {
   llvm::errs() << "\n*** Semantic Analysis Stats:\n";
   llvm::errs() << NumSFINAEErrors << " SFINAE diagnostics trapped.\n";
+  llvm::errs() << NumViableOverloadCandidates << "/" << NumOverloadCandidates
+               << " overload candidates viable, "
+               << NumOverloadCandidatesPrefiltered
+               << " rejected without building conversions.\n";
+  llvm::errs() << NumUserConversionCacheHits << "/"
+               << (NumUserConversionCacheHits + NumUserConversionCacheMisses)
+               << " user-defined conversion sequences reused.\n";
+  llvm::errs() << NumDeductionMemoHits << "/"
+               << (NumDeductionMemoHits + NumDeductionMemoMisses)
+               << " substitutions of deduced template arguments reused.\n";
+  llvm::errs() << TyposCorrected + UnqualifiedTyposCorrected.size()
+               << " typo corrections attempted, "
+               << NumTypoCorrectionCacheHits << " answered from the cache, "
+               << NumTypoCorrectionsOverLimit
+               << " skipped over the spell-checking limit.\n";
 
   BumpAlloc.PrintStats();
   AnalysisWarnings.PrintStats();
@@ -457,7 +482,10 @@ static bool MethodsAndNestedClassesComplete(const CXXRecordDecl *RD,
                                   E = RD->decls_end();
        I != E && Complete; ++I) {
     if (const CXXMethodDecl *M = dyn_cast<CXXMethodDecl>(*I))
-      Complete = M->isDefined() || (M->isPure() && !isa<CXXDestructorDecl>(M));
+      // A body left unparsed by -fdelayed-inline-function-parsing could
+      // use any of the fields.
+      Complete = (M->isDefined() && !M->isLateTemplateParsed()) ||
+                 (M->isPure() && !isa<CXXDestructorDecl>(M));
     else if (const FunctionTemplateDecl *F = dyn_cast<FunctionTemplateDecl>(*I))
       Complete = F->getTemplatedDecl()->isDefined();
     else if (const CXXRecordDecl *R = dyn_cast<CXXRecordDecl>(*I)) {
@@ -512,6 +540,22 @@ static bool IsRecordFullyDefined(const CXXRecordDecl *RD,
   return Complete;
 }
 
+bool Sema::ParseUsedLateParsedFunctions() {
+  if (UsedLateParsedFunctions.empty() || !LateTemplateParser)
+    return false;
+
+  while (!UsedLateParsedFunctions.empty()) {
+    FunctionDecl *FD = UsedLateParsedFunctions.front();
+    UsedLateParsedFunctions.pop_front();
+    if (!FD->isLateTemplateParsed())
+      continue;
+
+    LateTemplateParser(OpaqueParser, FD);
+    MarkAsLateParsedTemplate(FD, false);
+  }
+  return true;
+}
+
 /// ActOnEndOfTranslationUnit - This is called at the very end of the
 /// translation unit when EOF is reached and all but the top-level scope is
 /// popped.
@@ -560,6 +604,14 @@ void Sema::ActOnEndOfTranslationUnit() {
     // future, we either need to be able to filter the results of name lookup
     // or we need to perform template instantiations earlier.
     PerformPendingInstantiations();
+
+    // Parse the used inline function bodies that were left unparsed by
+    // -fdelayed-inline-function-parsing. They can use further functions,
+    // vtables and template specializations, and so can what those need.
+    while (ParseUsedLateParsedFunctions()) {
+      DefineUsedVTables();
+      PerformPendingInstantiations();
+    }
   }
   
   // Remove file scoped decls that turned out to be used.
@@ -506,6 +506,12 @@ bool ResultBuilder::isInterestingDecl(NamedDecl *ND,
     if (Id->isStr("__va_list_tag") || Id->isStr("__builtin_va_list"))
       return false;
     
+    // Skip names that don't match what has been typed so far before doing
+    // any more work on them.
+    if (SemaRef.CodeCompleter &&
+        !SemaRef.CodeCompleter->matchesTypedPrefix(Id->getName()))
+      return false;
+
     // Filter out names reserved for the implementation (C99 7.1.3, 
     // C++ [lib.global.names]) if they come from a system header.
     //
@@ -2941,8 +2947,10 @@ static void HandleCodeCompleteResults(Sema *S,
                                       CodeCompletionContext Context,
                                       CodeCompletionResult *Results,
                                       unsigned NumResults) {
-  if (CodeCompleter)
+  if (CodeCompleter) {
+    NumResults = CodeCompleter->filterResults(Results, NumResults);
     CodeCompleter->ProcessCodeCompleteResults(*S, Context, Results, NumResults);
+  }
 }
 
 static enum CodeCompletionContext::Kind mapCodeCompletionContext(Sema &S, 
@@ -10289,6 +10289,15 @@ void Sema::ActOnFields(Scope* S,
     if (!Completed)
       Record->completeDefinition();
 
+    // A class may have conversions now that it did not have while it was
+    // incomplete.
+    CXXRecordDecl *CXXRecord = dyn_cast<CXXRecordDecl>(Record);
+    if (CXXRecord && UserConversionIncompleteClasses.count(
+                         CXXRecord->getCanonicalDecl())) {
+      UserConversionCache.clear();
+      UserConversionIncompleteClasses.clear();
+    }
+
   } else {
     ObjCIvarDecl **ClsFields =
       reinterpret_cast<ObjCIvarDecl**>(RecFields.data());
@@ -10495,6 +10495,12 @@ void Sema::MarkFunctionReferenced(SourceLocation Loc, FunctionDecl *Func) {
     }
   }
 
+  // The body of an inline function that -fdelayed-inline-function-parsing
+  // left unparsed is needed now; parse it at the end of the translation unit.
+  if (Func->isLateTemplateParsed() && LangOpts.DelayedInlineFunctionParsing &&
+      Func->getTemplatedKind() == FunctionDecl::TK_NonTemplate)
+    UsedLateParsedFunctions.push_back(Func);
+
   // Keep track of used but undefined functions.
   if (!Func->isPure() && !Func->hasBody() &&
       Func->getLinkage() != ExternalLinkage) {
@@ -3663,6 +3663,18 @@ static bool isCandidateViable(CorrectionCandidateCallback &CCC,
   return Candidate.getEditDistance(false) != TypoCorrection::InvalidDistance;
 }
 
+/// \brief Determine whether CorrectTypo has already made as many attempts as
+/// -fspell-checking-limit allows.
+///
+/// This is a stop gap for files that are just seriously broken. Trying to
+/// correct all typos can turn into a HUGE performance penalty, causing some
+/// files to take minutes to get rejected by the parser.
+static bool isOverSpellCheckingLimit(Sema &S) {
+  unsigned Limit = S.Diags.getDiagnosticOptions().SpellCheckingLimit;
+  return Limit &&
+         S.TyposCorrected + S.UnqualifiedTyposCorrected.size() >= Limit;
+}
+
 /// \brief Try to "correct" a typo in the source code by finding
 /// visible declarations whose names are similar to the name that was
 /// present in the source code.
@@ -3737,6 +3749,8 @@ TypoCorrection Sema::CorrectTypo(const DeclarationNameInfo &TypoName,
 
   // Perform name lookup to find visible, similarly-named entities.
   bool IsUnqualifiedLookup = false;
+  bool IsQualifiedLookup = false;
+  QualifiedTypoKey QualifiedKey;
   DeclContext *QualifiedDC = MemberContext;
   if (MemberContext) {
     LookupVisibleDecls(MemberContext, LookupKind, Consumer);
@@ -3753,11 +3767,21 @@ TypoCorrection Sema::CorrectTypo(const DeclarationNameInfo &TypoName,
     if (!QualifiedDC)
       return TypoCorrection();
 
-    // Provide a stop gap for files that are just seriously broken.  Trying
-    // to correct all typos can turn into a HUGE performance penalty, causing
-    // some files to take minutes to get rejected by the parser.
-    if (TyposCorrected + UnqualifiedTyposCorrected.size() >= 20)
+    IsQualifiedLookup = true;
+    QualifiedKey = QualifiedTypoKey(std::make_pair(Typo, QualifiedDC),
+                                    LookupKind);
+    // As for unqualified lookup, only honor no-correction cache hits when
+    // the callback does not validate correction candidates.
+    if (QualifiedTyposNotCorrected.count(QualifiedKey)) {
+      ++NumTypoCorrectionCacheHits;
+      if (!ValidatingCallback)
+        return TypoCorrection();
+    }
+
+    if (isOverSpellCheckingLimit(*this)) {
+      ++NumTypoCorrectionsOverLimit;
       return TypoCorrection();
+    }
     ++TyposCorrected;
 
     LookupVisibleDecls(QualifiedDC, LookupKind, Consumer);
@@ -3766,6 +3790,7 @@ TypoCorrection Sema::CorrectTypo(const DeclarationNameInfo &TypoName,
     UnqualifiedTyposCorrectedMap::iterator Cached
       = UnqualifiedTyposCorrected.find(Typo);
     if (Cached != UnqualifiedTyposCorrected.end()) {
+      ++NumTypoCorrectionCacheHits;
       // Add the cached value, unless it's a keyword or fails validation. In the
       // keyword case, we'll end up adding the keyword below.
       if (Cached->second) {
@@ -3777,14 +3802,18 @@ TypoCorrection Sema::CorrectTypo(const DeclarationNameInfo &TypoName,
         // correction candidates is not being used.
         if (!ValidatingCallback)
           return TypoCorrection();
+
+        // Otherwise we search again, which counts against the limit like
+        // any other attempt.
+        if (isOverSpellCheckingLimit(*this)) {
+          ++NumTypoCorrectionsOverLimit;
+          return TypoCorrection();
+        }
+        ++TyposCorrected;
       }
-    }
-    if (Cached == UnqualifiedTyposCorrected.end()) {
-      // Provide a stop gap for files that are just seriously broken.  Trying
-      // to correct all typos can turn into a HUGE performance penalty, causing
-      // some files to take minutes to get rejected by the parser.
-      if (TyposCorrected + UnqualifiedTyposCorrected.size() >= 20)
-        return TypoCorrection();
+    } else if (isOverSpellCheckingLimit(*this)) {
+      ++NumTypoCorrectionsOverLimit;
+      return TypoCorrection();
     }
   }
 
@@ -3819,15 +3848,36 @@ TypoCorrection Sema::CorrectTypo(const DeclarationNameInfo &TypoName,
         Consumer.FoundName(Name);
       } while (true);
     }
+
+    // Builtins are only entered into the identifier table once they are
+    // named, so walk through their names separately. Only consider the ones
+    // close enough to the typo, so we don't create identifiers for the rest;
+    // comparing the lengths first avoids most of the edit distances.
+    SmallVector<const char *, 32> BuiltinNames;
+    Context.BuiltinInfo.GetBuiltinNames(BuiltinNames,
+                                        getLangOpts().NoBuiltin);
+    StringRef TypoStr = Typo->getName();
+    unsigned UpperBound = (TypoStr.size() + 2) / 3;
+    for (unsigned I = 0, N = BuiltinNames.size(); I != N; ++I) {
+      StringRef Name(BuiltinNames[I]);
+      unsigned LengthDiff = Name.size() > TypoStr.size()
+                              ? Name.size() - TypoStr.size()
+                              : TypoStr.size() - Name.size();
+      if (LengthDiff <= UpperBound &&
+          TypoStr.edit_distance(Name, true, UpperBound) <= UpperBound)
+        Consumer.FoundName(Name);
+    }
   }
 
   AddKeywordsToConsumer(*this, Consumer, S, CCC, SS && SS->isNotEmpty());
 
   // If we haven't found anything, we're done.
   if (Consumer.empty()) {
-    // If this was an unqualified lookup, note that no correction was found.
+    // Note that no correction was found.
     if (IsUnqualifiedLookup)
       (void)UnqualifiedTyposCorrected[Typo];
+    else if (IsQualifiedLookup)
+      QualifiedTyposNotCorrected.insert(QualifiedKey);
 
     return TypoCorrection();
   }
@@ -3836,9 +3886,11 @@ TypoCorrection Sema::CorrectTypo(const DeclarationNameInfo &TypoName,
   // is not more that about a third of the length of the typo's identifier.
   unsigned ED = Consumer.getBestEditDistance(true);
   if (ED > 0 && Typo->getName().size() / ED < 3) {
-    // If this was an unqualified lookup, note that no correction was found.
+    // Note that no correction was found.
     if (IsUnqualifiedLookup)
       (void)UnqualifiedTyposCorrected[Typo];
+    else if (IsQualifiedLookup)
+      QualifiedTyposNotCorrected.insert(QualifiedKey);
 
     return TypoCorrection();
   }
@@ -1036,6 +1036,86 @@ bool Sema::isFunctionConsideredUnavailable(FunctionDecl *FD) {
   return FD->isUnavailable() && !cast<Decl>(CurContext)->isUnavailable();
 }
 
+static ImplicitConversionSequence
+TryUserDefinedConversion(Sema &S, Expr *From, QualType ToType,
+                         bool SuppressUserConversions,
+                         bool AllowExplicit,
+                         bool InOverloadResolution,
+                         bool CStyle,
+                         bool AllowObjCWritebackConversion);
+
+/// \brief Compute the key under which the user-defined conversion of
+/// \p From to \p ToType is cached, or return false if the conversion depends
+/// on more of \p From than its type and value category.
+static bool getUserConversionKey(Sema &S, Expr *From, QualType ToType,
+                                 bool AllowExplicit,
+                                 Sema::UserConversionKey &Key) {
+  const LangOptions &LangOpts = S.getLangOpts();
+  if (LangOpts.ObjC1 || LangOpts.CUDA)
+    return false;
+
+  // Initializer lists, overload sets, string literals, bit-fields and vector
+  // elements all convert differently from other expressions of their type.
+  QualType FromType = From->getType();
+  if (isa<InitListExpr>(From) || FromType->isPlaceholderType() ||
+      FromType->isDependentType() || ToType->isDependentType() ||
+      isa<StringLiteral>(From->IgnoreParens()) ||
+      From->getObjectKind() != OK_Ordinary)
+    return false;
+
+  // So do null pointer constants.
+  bool IsNullPointerConstant = false;
+  if (FromType->isIntegralOrEnumerationType())
+    IsNullPointerConstant
+      = From->isNullPointerConstant(S.Context,
+                                    Expr::NPC_ValueDependentIsNotNull);
+
+  Key.first.first = FromType.getAsOpaquePtr();
+  Key.first.second = ToType.getAsOpaquePtr();
+  Key.second = From->getValueKind() | AllowExplicit << 2 |
+               IsNullPointerConstant << 3;
+  return true;
+}
+
+/// \brief Like TryUserDefinedConversion, but reuse the result of an earlier
+/// conversion from an expression of the same type and value category.
+static ImplicitConversionSequence
+TryCachedUserDefinedConversion(Sema &S, Expr *From, QualType ToType,
+                               bool SuppressUserConversions,
+                               bool AllowExplicit,
+                               bool InOverloadResolution,
+                               bool CStyle,
+                               bool AllowObjCWritebackConversion) {
+  Sema::UserConversionKey Key;
+  if (SuppressUserConversions ||
+      !getUserConversionKey(S, From, ToType, AllowExplicit, Key))
+    return TryUserDefinedConversion(S, From, ToType, SuppressUserConversions,
+                                    AllowExplicit, InOverloadResolution,
+                                    CStyle, AllowObjCWritebackConversion);
+
+  llvm::DenseMap<Sema::UserConversionKey, ImplicitConversionSequence>::iterator
+    Known = S.UserConversionCache.find(Key);
+  if (Known != S.UserConversionCache.end()) {
+    ++S.NumUserConversionCacheHits;
+    ImplicitConversionSequence ICS = Known->second;
+    if (ICS.isBad())
+      ICS.Bad.FromExpr = From;
+    return ICS;
+  }
+
+  ++S.NumUserConversionCacheMisses;
+  ++S.ComputingCachedUserConversions;
+  ImplicitConversionSequence ICS
+    = TryUserDefinedConversion(S, From, ToType, SuppressUserConversions,
+                               AllowExplicit, InOverloadResolution, CStyle,
+                               AllowObjCWritebackConversion);
+  --S.ComputingCachedUserConversions;
+
+  // Nested conversions may have grown the cache, which invalidates Known.
+  S.UserConversionCache[Key] = ICS;
+  return ICS;
+}
+
 /// \brief Tries a user-defined conversion from From to ToType.
 ///
 /// Produces an implicit conversion sequence for when a standard conversion
@@ -1191,9 +1271,10 @@ TryImplicitConversion(Sema &S, Expr *From, QualType ToType,
     return ICS;
   }
 
-  return TryUserDefinedConversion(S, From, ToType, SuppressUserConversions,
-                                  AllowExplicit, InOverloadResolution, CStyle,
-                                  AllowObjCWritebackConversion);
+  return TryCachedUserDefinedConversion(S, From, ToType,
+                                        SuppressUserConversions,
+                                        AllowExplicit, InOverloadResolution,
+                                        CStyle, AllowObjCWritebackConversion);
 }
 
 ImplicitConversionSequence
@@ -5222,6 +5303,51 @@ Sema::ConvertToIntegralOrEnumerationType(SourceLocation Loc, Expr *From,
   return DefaultLvalueConversion(From);
 }
 
+/// \brief Determine, without building an implicit conversion sequence,
+/// whether the argument \p From obviously cannot be implicitly converted to
+/// a parameter of type \p ToType.
+///
+/// This only recognizes conversions between class and non-class types where
+/// the class has no way to take part in the conversion: a class without
+/// user-declared constructors cannot be built from a non-class argument,
+/// and a class without conversion functions cannot be turned into a
+/// non-class parameter. A false result says nothing.
+static bool isConversionObviouslyImpossible(Sema &S, Expr *From,
+                                            QualType ToType) {
+  if (!S.getLangOpts().CPlusPlus || isa<InitListExpr>(From))
+    return false;
+
+  QualType FromType = From->getType();
+  ToType = ToType.getNonReferenceType();
+  if (FromType->isDependentType() || FromType->isPlaceholderType() ||
+      ToType->isDependentType())
+    return false;
+
+  CXXRecordDecl *FromRecord = FromType->getAsCXXRecordDecl();
+  CXXRecordDecl *ToRecord = ToType->getAsCXXRecordDecl();
+  if (!FromRecord == !ToRecord)
+    return false;
+
+  // Only look at classes which are already defined, leaving any template
+  // instantiation to the full check.
+  if (ToRecord) {
+    // Inheriting constructors need a base class, so a class without bases
+    // and user-declared constructors has only its implicit ones.
+    ToRecord = ToRecord->getDefinition();
+    return ToRecord && !ToRecord->isBeingDefined() &&
+           !ToRecord->hasUserDeclaredConstructor() &&
+           ToRecord->getNumBases() == 0;
+  }
+
+  FromRecord = FromRecord->getDefinition();
+  if (!FromRecord || FromRecord->isBeingDefined())
+    return false;
+  std::pair<CXXRecordDecl::conversion_iterator,
+            CXXRecordDecl::conversion_iterator>
+    Conversions = FromRecord->getVisibleConversionFunctions();
+  return Conversions.first == Conversions.second;
+}
+
 /// AddOverloadCandidate - Adds the given function to the set of
 /// candidate functions, using the given function call arguments.  If
 /// @p SuppressUserConversions, then don't allow user-defined
@@ -5323,6 +5449,22 @@ Sema::AddOverloadCandidate(FunctionDecl *Function,
         return;
       }
 
+  // Large overload sets, such as those for operator<<, are mostly made up of
+  // candidates that one of the arguments rules out immediately. Reject those
+  // before building any conversion sequences; CompleteNonViableCandidate
+  // computes the conversions if the candidate is ever diagnosed.
+  for (unsigned ArgIdx = 0, NumArgs = std::min<unsigned>(Args.size(),
+                                                         NumArgsInProto);
+       ArgIdx != NumArgs; ++ArgIdx) {
+    if (isConversionObviouslyImpossible(*this, Args[ArgIdx],
+                                        Proto->getArgType(ArgIdx))) {
+      ++NumOverloadCandidatesPrefiltered;
+      Candidate.Viable = false;
+      Candidate.FailureKind = ovl_fail_bad_conversion;
+      return;
+    }
+  }
+
   // Determine the implicit conversion sequences for each of the
   // arguments.
   for (unsigned ArgIdx = 0; ArgIdx < Args.size(); ++ArgIdx) {
@@ -7847,11 +7989,14 @@ OverloadCandidateSet::BestViableFunction(Sema &S, SourceLocation Loc,
                                          bool UserDefinedConversion) {
   // Find the best viable function.
   Best = end();
+  S.NumOverloadCandidates += size();
   for (iterator Cand = begin(); Cand != end(); ++Cand) {
-    if (Cand->Viable)
+    if (Cand->Viable) {
+      ++S.NumViableOverloadCandidates;
       if (Best == end() || isBetterOverloadCandidate(S, *Cand, *Best, Loc,
                                                      UserDefinedConversion))
         Best = Cand;
+    }
   }
 
   // If we didn't find any viable functions, abort.
@@ -8737,6 +8882,29 @@ void CompleteNonViableCandidate(Sema &S, OverloadCandidate *Cand,
   // Use a implicit copy initialization to check conversion fixes.
   Cand->Fix.setConversionChecker(TryCopyInitialization);
 
+  // AddOverloadCandidate rejects some candidates without computing any
+  // conversions. Compute them up to the first bad one, which the cheap check
+  // guarantees exists.
+  if (Cand->Function && !Cand->IgnoreObjectArgument &&
+      Cand->NumConversions && !Cand->Conversions[0].isInitialized()) {
+    const FunctionProtoType *Proto
+      = Cand->Function->getType()->getAs<FunctionProtoType>();
+    for (unsigned ArgIdx = 0; ArgIdx != Cand->NumConversions; ++ArgIdx) {
+      if (ArgIdx >= Proto->getNumArgs()) {
+        Cand->Conversions[ArgIdx].setEllipsis();
+        continue;
+      }
+      Cand->Conversions[ArgIdx]
+        = TryCopyInitialization(S, Args[ArgIdx], Proto->getArgType(ArgIdx),
+                                /*SuppressUserConversions=*/false,
+                                /*InOverloadResolution=*/true,
+                                /*AllowObjCWritebackConversion=*/
+                                  S.getLangOpts().ObjCAutoRefCount);
+      if (Cand->Conversions[ArgIdx].isBad())
+        break;
+    }
+  }
+
   // Skip forward to the first bad conversion.
   unsigned ConvIdx = (Cand->IgnoreObjectArgument ? 1 : 0);
   unsigned ConvCount = Cand->NumConversions;
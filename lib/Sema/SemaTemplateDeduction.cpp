@@ -17,6 +17,7 @@
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/StmtVisitor.h"
 #include "clang/Sema/DeclSpec.h"
 #include "clang/Sema/Sema.h"
@@ -2545,19 +2546,15 @@ CheckOriginalCallArgDeduction(Sema &S, Sema::OriginalCallArg OriginalArg,
   return true;
 }
 
-/// \brief Finish template argument deduction for a function template,
-/// checking the deduced template arguments for completeness and forming
-/// the function template specialization.
-///
-/// \param OriginalCallArgs If non-NULL, the original call arguments against
-/// which the deduced argument types should be compared.
+/// \brief Check the deduced template arguments of a function template for
+/// completeness and substitute them into the function template to form the
+/// function template specialization.
 Sema::TemplateDeductionResult
-Sema::FinishTemplateArgumentDeduction(FunctionTemplateDecl *FunctionTemplate,
+Sema::SubstituteDeducedTemplateArguments(FunctionTemplateDecl *FunctionTemplate,
                        SmallVectorImpl<DeducedTemplateArgument> &Deduced,
-                                      unsigned NumExplicitlySpecified,
-                                      FunctionDecl *&Specialization,
-                                      TemplateDeductionInfo &Info,
-        SmallVectorImpl<OriginalCallArg> const *OriginalCallArgs) {
+                                         unsigned NumExplicitlySpecified,
+                                         FunctionDecl *&Specialization,
+                                         TemplateDeductionInfo &Info) {
   TemplateParameterList *TemplateParams
     = FunctionTemplate->getTemplateParameters();
 
@@ -2721,6 +2718,201 @@ Sema::FinishTemplateArgumentDeduction(FunctionTemplateDecl *FunctionTemplate,
     return TDK_SubstitutionFailure;
   }
 
+  // If we suppressed any diagnostics while performing template argument
+  // deduction, and if we haven't already instantiated this declaration,
+  // keep track of these diagnostics. They'll be emitted if this specialization
+  // is actually used.
+  if (Info.diag_begin() != Info.diag_end()) {
+    llvm::DenseMap<Decl *, SmallVector<PartialDiagnosticAt, 1> >::iterator
+      Pos = SuppressedDiagnostics.find(Specialization->getCanonicalDecl());
+    if (Pos == SuppressedDiagnostics.end())
+        SuppressedDiagnostics[Specialization->getCanonicalDecl()]
+          .append(Info.diag_begin(), Info.diag_end());
+  }
+
+  return TDK_Success;
+}
+
+namespace {
+  /// \brief AST visitor that finds names which are looked up when a template
+  /// is instantiated, such as the callee of a call that uses argument-dependent
+  /// lookup or an operator applied to an operand of dependent type.
+  class FindInstantiationLookup
+    : public RecursiveASTVisitor<FindInstantiationLookup> {
+  public:
+    bool VisitUnresolvedLookupExpr(UnresolvedLookupExpr *E) {
+      return false;
+    }
+
+    bool VisitUnaryOperator(UnaryOperator *E) {
+      return !E->isTypeDependent();
+    }
+
+    bool VisitBinaryOperator(BinaryOperator *E) {
+      return !E->isTypeDependent();
+    }
+  };
+}
+
+/// \brief Walk the signature of the given function template for names that
+/// are looked up at instantiation.
+///
+/// Such a name can find a declaration that follows an earlier substitution,
+/// as in
+/// \code
+/// template<typename T> auto g(T t) -> decltype(h(t));
+/// \endcode
+/// where a later namespace-scope \c h can make a failed substitution succeed
+/// or make a successful one ambiguous.
+static bool computeSignatureLookupFree(FunctionTemplateDecl *FunctionTemplate) {
+  FindInstantiationLookup Finder;
+
+  TemplateParameterList *Params = FunctionTemplate->getTemplateParameters();
+  for (TemplateParameterList::iterator P = Params->begin(),
+                                    PEnd = Params->end();
+       P != PEnd; ++P)
+    if (!Finder.TraverseDecl(*P))
+      return false;
+
+  FunctionDecl *Pattern = FunctionTemplate->getTemplatedDecl();
+  if (TypeSourceInfo *TSInfo = Pattern->getTypeSourceInfo()) {
+    if (!Finder.TraverseTypeLoc(TSInfo->getTypeLoc()))
+      return false;
+  } else if (!Finder.TraverseType(Pattern->getType())) {
+    return false;
+  }
+
+  // The visitor does not walk into exception specifications.
+  const FunctionProtoType *Proto
+    = Pattern->getType()->getAs<FunctionProtoType>();
+  if (Proto && Proto->getExceptionSpecType() == EST_ComputedNoexcept &&
+      !Finder.TraverseStmt(Proto->getNoexceptExpr()))
+    return false;
+
+  return true;
+}
+
+bool Sema::isSignatureLookupFree(FunctionTemplateDecl *FunctionTemplate) {
+  llvm::DenseMap<FunctionTemplateDecl *, bool>::iterator Known
+    = SignatureLookupFree.find(FunctionTemplate);
+  if (Known != SignatureLookupFree.end())
+    return Known->second;
+
+  bool LookupFree = computeSignatureLookupFree(FunctionTemplate);
+  SignatureLookupFree[FunctionTemplate] = LookupFree;
+  return LookupFree;
+}
+
+/// \brief Determine whether a successful substitution of the given deduced
+/// template arguments into a function template can be memoized and, if so,
+/// profile the key to memoize it under.
+static bool getDeductionMemoKey(Sema &S, FunctionTemplateDecl *FunctionTemplate,
+                        const SmallVectorImpl<DeducedTemplateArgument> &Deduced,
+                                unsigned NumExplicitlySpecified,
+                                llvm::FoldingSetNodeID &ID) {
+  // The arguments of a partially-substituted pack come from the current
+  // instantiation scope rather than from the deduced arguments.
+  if (S.CurrentInstantiationScope &&
+      S.CurrentInstantiationScope->getPartiallySubstitutedPack())
+    return false;
+
+  for (unsigned I = 0, N = Deduced.size(); I != N; ++I) {
+    const DeducedTemplateArgument &Arg = Deduced[I];
+    // Arguments deduced from an array bound are converted differently, and
+    // expressions would have to be profiled structurally.
+    if (Arg.wasDeducedFromArrayBound() || Arg.isInstantiationDependent())
+      return false;
+    if (Arg.getKind() == TemplateArgument::Expression)
+      return false;
+    if (Arg.getKind() == TemplateArgument::Pack) {
+      for (TemplateArgument::pack_iterator P = Arg.pack_begin(),
+                                        PEnd = Arg.pack_end();
+           P != PEnd; ++P)
+        if (P->getKind() == TemplateArgument::Expression)
+          return false;
+    }
+  }
+
+  if (!S.isSignatureLookupFree(FunctionTemplate))
+    return false;
+
+  ID.AddPointer(FunctionTemplate->getCanonicalDecl());
+  ID.AddInteger(NumExplicitlySpecified);
+  ID.AddInteger(Deduced.size());
+  for (unsigned I = 0, N = Deduced.size(); I != N; ++I)
+    Deduced[I].Profile(ID, S.Context);
+  return true;
+}
+
+void Sema::clearMemoizedDeductions() {
+  for (llvm::FoldingSet<MemoizedDeduction>::iterator
+         M = MemoizedDeductions.begin(), MEnd = MemoizedDeductions.end();
+       M != MEnd; /* increment below */) {
+    MemoizedDeduction *Memo = &*M++;
+    delete Memo;
+  }
+  MemoizedDeductions.clear();
+}
+
+/// \brief Finish template argument deduction for a function template,
+/// checking the deduced template arguments for completeness and forming
+/// the function template specialization.
+///
+/// A successful substitution of the deduced template arguments only depends
+/// on the template and the arguments, so it is memoized unless the signature
+/// names something that is looked up at instantiation.
+///
+/// \param OriginalCallArgs If non-NULL, the original call arguments against
+/// which the deduced argument types should be compared.
+Sema::TemplateDeductionResult
+Sema::FinishTemplateArgumentDeduction(FunctionTemplateDecl *FunctionTemplate,
+                       SmallVectorImpl<DeducedTemplateArgument> &Deduced,
+                                      unsigned NumExplicitlySpecified,
+                                      FunctionDecl *&Specialization,
+                                      TemplateDeductionInfo &Info,
+        SmallVectorImpl<OriginalCallArg> const *OriginalCallArgs) {
+  TemplateDeductionResult Result;
+  llvm::FoldingSetNodeID ID;
+  void *InsertPos = 0;
+  if (!getDeductionMemoKey(*this, FunctionTemplate, Deduced,
+                           NumExplicitlySpecified, ID)) {
+    Result = SubstituteDeducedTemplateArguments(FunctionTemplate, Deduced,
+                                                NumExplicitlySpecified,
+                                                Specialization, Info);
+  } else {
+    if (const MemoizedDeduction *Memo
+          = MemoizedDeductions.FindNodeOrInsertPos(ID, InsertPos)) {
+      ++NumDeductionMemoHits;
+      Result = TDK_Success;
+      Specialization = Memo->Specialization;
+      Info.reset(Memo->Deduced);
+    } else {
+      ++NumDeductionMemoMisses;
+      DiagnosticErrorTrap ErrorTrap(Diags);
+      Result = SubstituteDeducedTemplateArguments(FunctionTemplate, Deduced,
+                                                  NumExplicitlySpecified,
+                                                  Specialization, Info);
+
+      // A failure may turn into a success once something the signature
+      // names is declared or defined, so only successes are remembered. An
+      // error that was not trapped depends on where the deduction happens.
+      if (Result == TDK_Success && !ErrorTrap.hasErrorOccurred()) {
+        MemoizedDeduction *Memo = new MemoizedDeduction(ID);
+        Memo->Specialization = Specialization;
+        Memo->Deduced = Info.take();
+        Info.reset(Memo->Deduced);
+
+        // The substitution may have memoized other substitutions, which
+        // invalidates InsertPos.
+        if (MemoizedDeductions.GetOrInsertNode(Memo) != Memo)
+          delete Memo;
+      }
+    }
+  }
+
+  if (Result)
+    return Result;
+
   if (OriginalCallArgs) {
     // C++ [temp.deduct.call]p4:
     //   In general, the deduction process attempts to find template argument
@@ -2738,18 +2930,6 @@ Sema::FinishTemplateArgumentDeduction(FunctionTemplateDecl *FunctionTemplate,
         return Sema::TDK_SubstitutionFailure;
     }
   }
-  
-  // If we suppressed any diagnostics while performing template argument
-  // deduction, and if we haven't already instantiated this declaration,
-  // keep track of these diagnostics. They'll be emitted if this specialization
-  // is actually used.
-  if (Info.diag_begin() != Info.diag_end()) {
-    llvm::DenseMap<Decl *, SmallVector<PartialDiagnosticAt, 1> >::iterator
-      Pos = SuppressedDiagnostics.find(Specialization->getCanonicalDecl());
-    if (Pos == SuppressedDiagnostics.end())
-        SuppressedDiagnostics[Specialization->getCanonicalDecl()]
-          .append(Info.diag_begin(), Info.diag_end());
-  }
 
   return TDK_Success;
 }
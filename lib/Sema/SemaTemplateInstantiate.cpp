@@ -22,6 +22,7 @@
 #include "clang/Sema/Lookup.h"
 #include "clang/Sema/Template.h"
 #include "clang/Sema/TemplateDeduction.h"
+#include "clang/Sema/TemplateInstantiationProfiler.h"
 
 using namespace clang;
 using namespace sema;
@@ -188,6 +189,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -211,6 +214,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -236,6 +241,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -262,6 +269,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
     
     if (!Inst.isInstantiationRecord())
       ++SemaRef.NonInstantiationEntries;
@@ -290,6 +299,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -314,6 +325,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -338,6 +351,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -362,6 +377,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->startInstantiation();
   }
 }
 
@@ -386,6 +403,8 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
   Inst.InstantiationRange = InstantiationRange;
   SemaRef.InNonInstantiationSFINAEContext = false;
   SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+  if (SemaRef.TemplateProfiler)
+    SemaRef.TemplateProfiler->startInstantiation();
   
   assert(!Inst.isInstantiationRecord());
   ++SemaRef.NonInstantiationEntries;
@@ -399,6 +418,8 @@ void Sema::InstantiatingTemplate::Clear() {
     }
     SemaRef.InNonInstantiationSFINAEContext
       = SavedInNonInstantiationSFINAEContext;
+    if (SemaRef.TemplateProfiler)
+      SemaRef.TemplateProfiler->finishInstantiation();
     SemaRef.ActiveTemplateInstantiations.pop_back();
     Invalid = true;
   }
@@ -1189,7 +1189,7 @@ Decl *TemplateDeclInstantiator::VisitFunctionDecl(FunctionDecl *D,
     std::pair<const TemplateArgument *, unsigned> Innermost
       = TemplateArgs.getInnermost();
     Function->setFunctionTemplateSpecialization(FunctionTemplate,
-                            TemplateArgumentList::CreateCopy(SemaRef.Context,
+                          TemplateArgumentList::CreateShared(SemaRef.Context,
                                                              Innermost.first,
                                                              Innermost.second),
                                                 /*InsertPos=*/0);
@@ -1517,7 +1517,7 @@ TemplateDeclInstantiator::VisitCXXMethodDecl(CXXMethodDecl *D,
     std::pair<const TemplateArgument *, unsigned> Innermost
       = TemplateArgs.getInnermost();
     Method->setFunctionTemplateSpecialization(FunctionTemplate,
-                         TemplateArgumentList::CreateCopy(SemaRef.Context,
+                       TemplateArgumentList::CreateShared(SemaRef.Context,
                                                           Innermost.first,
                                                           Innermost.second),
                                               /*InsertPos=*/0);
@@ -4367,6 +4367,20 @@ bool Sema::RequireCompleteExprType(Expr *E, unsigned DiagID) {
 /// @c false otherwise.
 bool Sema::RequireCompleteType(SourceLocation Loc, QualType T,
                                TypeDiagnoser &Diagnoser) {
+  if (!RequireCompleteTypeImpl(Loc, T, Diagnoser))
+    return false;
+
+  // A cached conversion sequence that saw the class incomplete must be
+  // recomputed once the class is complete.
+  if (ComputingCachedUserConversions)
+    if (const CXXRecordDecl *Record
+          = Context.getBaseElementType(T)->getAsCXXRecordDecl())
+      UserConversionIncompleteClasses.insert(Record->getCanonicalDecl());
+  return true;
+}
+
+bool Sema::RequireCompleteTypeImpl(SourceLocation Loc, QualType T,
+                                   TypeDiagnoser &Diagnoser) {
   // FIXME: Add this assertion to make sure we always get instantiation points.
   //  assert(!Loc.isInvalid() && "Invalid location in RequireCompleteType");
   // FIXME: Add this assertion to help us flush out problems with
@@ -0,0 +1,278 @@
+//===--- TemplateInstantiationProfiler.cpp - Template cost profile --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the TemplateInstantiationProfiler class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Sema/TemplateInstantiationProfiler.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Sema/Sema.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+
+typedef Sema::ActiveTemplateInstantiation ActiveInstantiation;
+
+/// \brief Determine the declaration an entry on the instantiation stack is
+/// about, for reporting: the entity being instantiated or, for substitutions
+/// into a parameter, the template or function that owns the parameter.
+static const Decl *getSubject(const ActiveInstantiation &Inst) {
+  switch (Inst.Kind) {
+  case ActiveInstantiation::PriorTemplateArgumentSubstitution:
+  case ActiveInstantiation::DefaultTemplateArgumentChecking:
+    return Inst.Template;
+
+  case ActiveInstantiation::DefaultFunctionArgumentInstantiation:
+    return cast<Decl>(Inst.Entity->getDeclContext());
+
+  case ActiveInstantiation::TemplateInstantiation:
+  case ActiveInstantiation::DefaultTemplateArgumentInstantiation:
+  case ActiveInstantiation::ExplicitTemplateArgumentSubstitution:
+  case ActiveInstantiation::DeducedTemplateArgumentSubstitution:
+  case ActiveInstantiation::ExceptionSpecInstantiation:
+    return Inst.Entity;
+  }
+
+  llvm_unreachable("Invalid InstantiationKind!");
+}
+
+/// \brief Determine the template that \p D was instantiated from, or \p D
+/// itself if it is not an instantiation.
+static const Decl *getTemplateOf(const Decl *D) {
+  if (const ClassTemplateSpecializationDecl *Spec
+        = dyn_cast<ClassTemplateSpecializationDecl>(D))
+    D = Spec->getSpecializedTemplate();
+  else if (const CXXRecordDecl *Record = dyn_cast<CXXRecordDecl>(D)) {
+    if (const CXXRecordDecl *Pattern = Record->getInstantiatedFromMemberClass())
+      D = Pattern;
+  } else if (const FunctionDecl *Function = dyn_cast<FunctionDecl>(D)) {
+    if (const FunctionTemplateDecl *Template = Function->getPrimaryTemplate())
+      D = Template;
+    else if (const FunctionDecl *Pattern
+               = Function->getInstantiatedFromMemberFunction())
+      D = Pattern;
+  } else if (const VarDecl *Var = dyn_cast<VarDecl>(D)) {
+    if (const VarDecl *Pattern = Var->getInstantiatedFromStaticDataMember())
+      D = Pattern;
+  } else if (const EnumDecl *Enum = dyn_cast<EnumDecl>(D)) {
+    if (const EnumDecl *Pattern = Enum->getInstantiatedFromMemberEnum())
+      D = Pattern;
+  }
+  return D->getCanonicalDecl();
+}
+
+static const char *getKindName(unsigned Kind) {
+  switch (static_cast<ActiveInstantiation::InstantiationKind>(Kind)) {
+  case ActiveInstantiation::TemplateInstantiation:
+    return "instantiation";
+  case ActiveInstantiation::DefaultTemplateArgumentInstantiation:
+    return "default template argument";
+  case ActiveInstantiation::DefaultFunctionArgumentInstantiation:
+    return "default function argument";
+  case ActiveInstantiation::ExplicitTemplateArgumentSubstitution:
+    return "explicit argument substitution";
+  case ActiveInstantiation::DeducedTemplateArgumentSubstitution:
+    return "deduced argument substitution";
+  case ActiveInstantiation::PriorTemplateArgumentSubstitution:
+    return "prior argument substitution";
+  case ActiveInstantiation::DefaultTemplateArgumentChecking:
+    return "default template argument checking";
+  case ActiveInstantiation::ExceptionSpecInstantiation:
+    return "exception specification";
+  }
+
+  llvm_unreachable("Invalid InstantiationKind!");
+}
+
+static std::string getName(const Decl *D, const PrintingPolicy &Policy) {
+  std::string Name;
+  if (const NamedDecl *ND = dyn_cast<NamedDecl>(D))
+    ND->getNameForDiagnostic(Name, Policy, /*Qualified=*/true);
+  if (Name.empty())
+    Name = "<anonymous>";
+  return Name;
+}
+
+/// \brief Name a specialization; entries that are not instantiations of the
+/// entity itself say what they are doing to it.
+static std::string getSpecializationName(unsigned Kind, const Decl *D,
+                                         const PrintingPolicy &Policy) {
+  std::string Name = getName(D, Policy);
+  if (Kind != ActiveInstantiation::TemplateInstantiation) {
+    Name += " [";
+    Name += getKindName(Kind);
+    Name += "]";
+  }
+  return Name;
+}
+
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned I = 0, N = Str.size(); I != N; ++I) {
+    unsigned char C = Str[I];
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << llvm::format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+TemplateInstantiationProfiler::TemplateInstantiationProfiler(Sema &SemaRef)
+  : SemaRef(SemaRef),
+    StartTime(llvm::TimeRecord::getCurrentTime().getWallTime()) {}
+
+void TemplateInstantiationProfiler::startInstantiation() {
+  const ActiveInstantiation &Inst = SemaRef.ActiveTemplateInstantiations.back();
+
+  Event E;
+  E.Kind = Inst.Kind;
+  E.Entity = getSubject(Inst);
+  E.Template = getTemplateOf(E.Entity);
+  E.Start = 0;
+  E.Duration = 0;
+  E.Memory = 0;
+  E.Depth = Stack.size();
+  Events.push_back(E);
+
+  ++ActiveSpecializations[SpecializationKey(E.Kind, E.Entity)];
+  ++ActiveTemplates[E.Template];
+
+  // Read the clock last, so that the bookkeeping above is not counted.
+  llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+  Frame F = { static_cast<unsigned>(Events.size() - 1), Now.getWallTime(),
+              Now.getMemUsed(), 0, 0 };
+  Stack.push_back(F);
+}
+
+/// \brief Add the cost of one entry to \p T. The inclusive cost is only
+/// counted for the outermost of several nested entries with the same key,
+/// since it already contains the inner ones.
+static void addCost(TemplateInstantiationProfiler::Totals &T, bool Outermost,
+                    double Time, int64_t Memory,
+                    double ExclusiveTime, int64_t ExclusiveMemory) {
+  ++T.Count;
+  T.ExclusiveTime += ExclusiveTime;
+  T.ExclusiveMemory += ExclusiveMemory;
+  if (Outermost) {
+    T.InclusiveTime += Time;
+    T.InclusiveMemory += Memory;
+  }
+}
+
+void TemplateInstantiationProfiler::finishInstantiation() {
+  llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+  assert(!Stack.empty() && "Unbalanced template instantiation profile");
+  Frame F = Stack.pop_back_val();
+
+  Event &E = Events[F.EventIndex];
+  E.Start = F.Start - StartTime;
+  E.Duration = Now.getWallTime() - F.Start;
+  E.Memory = Now.getMemUsed() - F.StartMemory;
+  if (!Stack.empty()) {
+    Stack.back().ChildTime += E.Duration;
+    Stack.back().ChildMemory += E.Memory;
+  }
+
+  double ExclusiveTime = E.Duration - F.ChildTime;
+  int64_t ExclusiveMemory = E.Memory - F.ChildMemory;
+
+  SpecializationKey Key(E.Kind, E.Entity);
+  addCost(Specializations[Key], --ActiveSpecializations[Key] == 0,
+          E.Duration, E.Memory, ExclusiveTime, ExclusiveMemory);
+  addCost(Templates[E.Template], --ActiveTemplates[E.Template] == 0,
+          E.Duration, E.Memory, ExclusiveTime, ExclusiveMemory);
+}
+
+void TemplateInstantiationProfiler::writeTrace(raw_ostream &OS) const {
+  PrintingPolicy Policy = SemaRef.getPrintingPolicy();
+  llvm::DenseMap<const Decl *, std::string> TemplateNames;
+
+  OS << "{\"traceEvents\":[";
+  for (unsigned I = 0, N = Events.size(); I != N; ++I) {
+    const Event &E = Events[I];
+    std::string &TemplateName = TemplateNames[E.Template];
+    if (TemplateName.empty())
+      TemplateName = getName(E.Template, Policy);
+
+    OS << (I ? ",\n" : "\n") << "{\"name\":";
+    writeJSONString(OS, getSpecializationName(E.Kind, E.Entity, Policy));
+    OS << ",\"cat\":";
+    writeJSONString(OS, getKindName(E.Kind));
+    OS << ",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+       << ",\"ts\":" << llvm::format("%.3f", E.Start * 1e6)
+       << ",\"dur\":" << llvm::format("%.3f", E.Duration * 1e6)
+       << ",\"args\":{\"template\":";
+    writeJSONString(OS, TemplateName);
+    OS << ",\"depth\":" << E.Depth
+       << ",\"memory\":" << E.Memory << "}}";
+  }
+  OS << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+namespace {
+typedef std::pair<std::string, TemplateInstantiationProfiler::Totals>
+  NamedTotals;
+
+struct HigherInclusiveTime {
+  bool operator()(const NamedTotals &X, const NamedTotals &Y) const {
+    if (X.second.InclusiveTime != Y.second.InclusiveTime)
+      return X.second.InclusiveTime > Y.second.InclusiveTime;
+    return X.first < Y.first;
+  }
+};
+}
+
+static void printTop(raw_ostream &OS, StringRef Title,
+                     std::vector<NamedTotals> &Entries, unsigned N) {
+  std::sort(Entries.begin(), Entries.end(), HigherInclusiveTime());
+  if (Entries.size() > N)
+    Entries.resize(N);
+
+  OS << "\n" << Title << " by inclusive time:\n"
+     << "   Inclusive    Exclusive    Inclusive mem    Count  Name\n";
+  for (unsigned I = 0, E = Entries.size(); I != E; ++I) {
+    const TemplateInstantiationProfiler::Totals &T = Entries[I].second;
+    OS << llvm::format("%9.3f ms  %9.3f ms  %15lld  %7u  ",
+                       T.InclusiveTime * 1e3, T.ExclusiveTime * 1e3,
+                       static_cast<long long>(T.InclusiveMemory), T.Count)
+       << Entries[I].first << "\n";
+  }
+}
+
+void TemplateInstantiationProfiler::printSummary(raw_ostream &OS,
+                                                 unsigned N) const {
+  PrintingPolicy Policy = SemaRef.getPrintingPolicy();
+
+  OS << "\n*** Template Instantiation Profile\n"
+     << Events.size() << " template instantiations, "
+     << Templates.size() << " templates, "
+     << Specializations.size() << " specializations\n";
+
+  std::vector<NamedTotals> Entries;
+  for (llvm::DenseMap<const Decl *, Totals>::const_iterator
+         I = Templates.begin(), E = Templates.end(); I != E; ++I)
+    Entries.push_back(NamedTotals(getName(I->first, Policy), I->second));
+  printTop(OS, "Templates", Entries, N);
+
+  Entries.clear();
+  for (llvm::DenseMap<SpecializationKey, Totals>::const_iterator
+         I = Specializations.begin(), E = Specializations.end(); I != E; ++I)
+    Entries.push_back(NamedTotals(
+        getSpecializationName(I->first.first, I->first.second, Policy),
+        I->second));
+  printTop(OS, "Specializations", Entries, N);
+}
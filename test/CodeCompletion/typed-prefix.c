@@ -0,0 +1,24 @@
+struct Widget {
+  int count;
+  int Counter;
+  int color;
+  int countdown;
+  int size;
+};
+
+void test(struct Widget *w) {
+  w->
+}
+
+// RUN: %clang_cc1 -fsyntax-only -code-completion-prefix cou -code-completion-at=%s:10:6 %s -o - | FileCheck -check-prefix=CHECK-PREFIX %s
+// CHECK-PREFIX-NOT: color
+// CHECK-PREFIX: COMPLETION: count : [#int#]count
+// CHECK-PREFIX-NEXT: COMPLETION: countdown : [#int#]countdown
+// CHECK-PREFIX-NEXT: COMPLETION: Counter : [#int#]Counter
+// CHECK-PREFIX-NOT: size
+
+// RUN: %clang_cc1 -fsyntax-only -code-completion-prefix cou -code-completion-max-results 2 -code-completion-at=%s:10:6 %s -o - | FileCheck -check-prefix=CHECK-MAX %s
+// CHECK-MAX-NOT: Counter
+// CHECK-MAX: COMPLETION: count : [#int#]count
+// CHECK-MAX-NEXT: COMPLETION: countdown : [#int#]countdown
+// CHECK-MAX-NOT: Counter
@@ -0,0 +1,11 @@
+struct Counter {
+  int get() { return helper() + 1; }
+  int helper() { return value; }
+  int unused() { return value * 2; }
+  int value;
+};
+
+struct Shape {
+  virtual ~Shape() {}
+  virtual int area() { return 0; }
+};
@@ -0,0 +1,18 @@
+// RUN: %clang_cc1 -triple x86_64-unknown-unknown -emit-llvm -o %t -fdelayed-inline-function-parsing -I %S/Inputs %s
+// RUN: FileCheck %s < %t
+// RUN: FileCheck -check-prefix=CHECK-UNUSED %s < %t
+
+#include "delayed-inline-function-parsing.h"
+
+// Member functions whose bodies were parsed at the end of the translation
+// unit are still emitted, whether they are called directly or only reached
+// through a vtable.
+int use(Counter &c) { return c.get(); }
+Shape *make() { return new Shape; }
+
+// CHECK-DAG: define linkonce_odr i32 @_ZN7Counter3getEv(
+// CHECK-DAG: define linkonce_odr i32 @_ZN7Counter6helperEv(
+// CHECK-DAG: define linkonce_odr void @_ZN5ShapeD0Ev(
+// CHECK-DAG: define linkonce_odr i32 @_ZN5Shape4areaEv(
+
+// CHECK-UNUSED-NOT: @_ZN7Counter6unusedEv
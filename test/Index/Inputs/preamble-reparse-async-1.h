@@ -0,0 +1 @@
+int header_var_1;
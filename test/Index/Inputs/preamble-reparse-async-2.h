@@ -0,0 +1,2 @@
+int header_var_2;
+int header_var_3;
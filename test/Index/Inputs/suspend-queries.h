@@ -0,0 +1,4 @@
+#ifndef SUSPEND_QUERIES_H
+#define SUSPEND_QUERIES_H
+int header_var;
+#endif
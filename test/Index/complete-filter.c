@@ -0,0 +1,28 @@
+// Note: the run lines follow their respective tests, since line/column
+// matter in this test.
+
+int getValue(void);
+int get_value_count;
+int gravity;
+int setValue;
+int GetValue2;
+
+void f() {
+  
+}
+
+// RUN: env CINDEXTEST_COMPLETION_FILTER=gv c-index-test -code-completion-at=%s:11:3 %s | FileCheck -check-prefix=CHECK-GV %s
+// CHECK-GV-NOT: {TypedText setValue}
+// CHECK-GV: {TypedText get_value_count}
+// CHECK-GV: {TypedText getValue}
+// CHECK-GV: {TypedText GetValue2}
+// CHECK-GV: {TypedText gravity}
+// CHECK-GV-NOT: {TypedText setValue}
+
+// Narrow down to nothing, then widen again.
+// RUN: env CINDEXTEST_COMPLETION_FILTER=sv,svx,ge c-index-test -code-completion-at=%s:11:3 %s | FileCheck -check-prefix=CHECK-GE %s
+// CHECK-GE-NOT: {TypedText gravity}
+// CHECK-GE-NOT: {TypedText setValue}
+// CHECK-GE: {TypedText GetValue2}
+// CHECK-GE-NOT: {TypedText gravity}
+// CHECK-GE-NOT: {TypedText setValue}
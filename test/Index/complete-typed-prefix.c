@@ -0,0 +1,45 @@
+// Note: the run lines follow their respective tests, since line/column
+// matter in this test.
+
+struct Widget {
+  int count;
+  int Counter;
+  int color;
+  int countdown;
+  int size;
+};
+
+int getValue(void);
+int get_value_count;
+int gravity;
+int setValue;
+int GetValue2;
+
+void f(struct Widget *w) {
+  w->count;
+  
+}
+
+// RUN: env CINDEXTEST_COMPLETION_PREFIX=cou c-index-test -code-completion-at=%s:19:6 %s | FileCheck -check-prefix=CHECK-MEMBER %s
+// CHECK-MEMBER-NOT: {TypedText color}
+// CHECK-MEMBER: FieldDecl:{ResultType int}{TypedText count} (35)
+// CHECK-MEMBER-NEXT: FieldDecl:{ResultType int}{TypedText countdown} (35)
+// CHECK-MEMBER-NEXT: FieldDecl:{ResultType int}{TypedText Counter} (35)
+// CHECK-MEMBER-NOT: {TypedText size}
+
+// Case-sensitive matches are kept first when the results are limited.
+// RUN: env CINDEXTEST_COMPLETION_PREFIX=cou CINDEXTEST_COMPLETION_MAX_RESULTS=2 c-index-test -code-completion-at=%s:19:6 %s | FileCheck -check-prefix=CHECK-MAX %s
+// CHECK-MAX-NOT: {TypedText Counter}
+// CHECK-MAX: FieldDecl:{ResultType int}{TypedText count} (35)
+// CHECK-MAX-NEXT: FieldDecl:{ResultType int}{TypedText countdown} (35)
+// CHECK-MAX-NOT: {TypedText Counter}
+
+// Cached global results are filtered as well.
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_COMPLETION_CACHING=1 CINDEXTEST_COMPLETION_PREFIX=get c-index-test -code-completion-at=%s:20:3 %s | FileCheck -check-prefix=CHECK-GET %s
+// CHECK-GET-NOT: {TypedText gravity}
+// CHECK-GET-NOT: {TypedText setValue}
+// CHECK-GET: {TypedText get_value_count}
+// CHECK-GET: {TypedText getValue}
+// CHECK-GET: {TypedText GetValue2}
+// CHECK-GET-NOT: {TypedText gravity}
+// CHECK-GET-NOT: {TypedText setValue}
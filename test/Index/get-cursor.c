@@ -12,6 +12,12 @@ int x, y;
 // RUN:              -cursor-at=%s:7:5 \
 // RUN:              -cursor-at=%s:7:8 \
 // RUN:       %s | FileCheck %s
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:1:9 \
+// RUN:              -cursor-at=%s:2:9 \
+// RUN:              -cursor-at=%s:5:9 \
+// RUN:              -cursor-at=%s:7:5 \
+// RUN:              -cursor-at=%s:7:8 \
+// RUN:       %s | FileCheck %s
 
 // CHECK: StructDecl=_MyS:1:8 (Definition)
 // CHECK: FieldDecl=foo:2:7 (Definition)
@@ -70,6 +70,22 @@ void test() {
 // CHECK-CONSTRUCTOR2: CallExpr=X:6:3
 // CHECK-CONSTRUCTOR3: CallExpr=X:4:3
 
+// The cursor extent index must produce the same cursors as the full walk.
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:12:20 %s | FileCheck -check-prefix=CHECK-VALUE-REF %s
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:12:18 %s | FileCheck -check-prefix=CHECK-CONSTRUCTOR1 %s
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:13:18 %s | FileCheck -check-prefix=CHECK-CONSTRUCTOR2 %s
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:23:3 -cursor-at=%s:26:1 %s | FileCheck -check-prefix=CHECK-RETTYPE %s
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:27:10 %s | FileCheck -check-prefix=CHECK-IMPLICIT-MEMREF %s
+// RUN: env CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:35:5 %s | FileCheck -check-prefix=CHECK-DECL %s
+
+// Queries from several threads at once must agree with sequential ones.
+// RUN: env CINDEXTEST_CONCURRENT_QUERIES=4 c-index-test -cursor-at=%s:12:20 -cursor-at=%s:26:7 -cursor-at=%s:27:10 -cursor-at=%s:35:5 %s | FileCheck -check-prefix=CHECK-CONCURRENT %s
+// RUN: env CINDEXTEST_CONCURRENT_QUERIES=4 CINDEXTEST_INDEX_CURSOR_EXTENTS=1 c-index-test -cursor-at=%s:12:20 -cursor-at=%s:26:7 -cursor-at=%s:27:10 -cursor-at=%s:35:5 %s | FileCheck -check-prefix=CHECK-CONCURRENT %s
+// CHECK-CONCURRENT: DeclRefExpr=value:10:12
+// CHECK-CONCURRENT: CXXMethod=getX:26:6
+// CHECK-CONCURRENT: MemberRefExpr=member:21:7
+// CHECK-CONCURRENT: VarDecl=foo:35:5
+
 // RUN: c-index-test -cursor-at=%s:23:3 %s | FileCheck -check-prefix=CHECK-RETTYPE %s
 // RUN: c-index-test -cursor-at=%s:26:1 %s | FileCheck -check-prefix=CHECK-RETTYPE %s
 // CHECK-RETTYPE: TypeRef=struct X:3:8
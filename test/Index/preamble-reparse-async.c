@@ -0,0 +1,36 @@
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_ASYNC_PREAMBLE=1 \
+// RUN:   CINDEXTEST_REMAP_AFTER_TRIAL=1 \
+// RUN:   c-index-test -test-load-source-reparse-memory-usage 2 local \
+// RUN:   "-remap-file=%S/Inputs/preamble-reparse-async-1.h;%S/Inputs/preamble-reparse-async-2.h" \
+// RUN:   %s -I %S/Inputs 2> %t.deferred.txt | FileCheck -check-prefix=DEFERRED %s
+// RUN: FileCheck -check-prefix=DEFERRED-USAGE %s < %t.deferred.txt
+
+// The first reparse builds the preamble and the second finds the header
+// changed and starts rebuilding it in the background. That reparse returns
+// without parsing: the AST still has the old header's declarations and still
+// loads the old preamble.
+
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_ASYNC_PREAMBLE=1 \
+// RUN:   CINDEXTEST_REMAP_AFTER_TRIAL=1 CINDEXTEST_WAIT_FOR_PREAMBLE=1 \
+// RUN:   c-index-test -test-load-source-reparse-memory-usage 3 local \
+// RUN:   "-remap-file=%S/Inputs/preamble-reparse-async-1.h;%S/Inputs/preamble-reparse-async-2.h" \
+// RUN:   %s -I %S/Inputs 2> %t.stderr.txt | FileCheck -check-prefix=ADOPTED %s
+// RUN: FileCheck -check-prefix=ADOPTED-USAGE %s < %t.stderr.txt
+
+// The third reparse waits for the rebuild, loads the new preamble and parses
+// the edit that the second one deferred.
+
+#include "preamble-reparse-async-1.h"
+
+int main_var;
+
+// DEFERRED: preamble-reparse-async-1.h:1:5: VarDecl=header_var_1:1:5
+// DEFERRED-NOT: header_var_3
+// DEFERRED: preamble-reparse-async.c:25:5: VarDecl=main_var:25:5 Extent=[25:1 - 25:13]
+// DEFERRED-USAGE-NOT: error:
+// DEFERRED-USAGE: ExternalASTSource: malloc'ed memory buffers
+
+// ADOPTED: preamble-reparse-async-1.h:2:5: VarDecl=header_var_3:2:5
+// ADOPTED: preamble-reparse-async.c:25:5: VarDecl=main_var:25:5 Extent=[25:1 - 25:13]
+// ADOPTED-USAGE-NOT: error:
+// ADOPTED-USAGE: ExternalASTSource: malloc'ed memory buffers
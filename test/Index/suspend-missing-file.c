@@ -0,0 +1,13 @@
+int main_var;
+
+// Resuming fails once the main file is gone; the translation unit then has
+// no AST to query, rather than a half-built one.
+// RUN: cp %s %t.c
+// RUN: c-index-test -test-resume-missing-file %t.c 2>&1 | FileCheck %s
+// RUN: cp %s %t.c
+// RUN: env CINDEXTEST_EDITING=1 c-index-test -test-resume-missing-file %t.c \
+// RUN:   2>&1 | FileCheck %s
+
+// CHECK-NOT: Unable to
+// CHECK: file found: 0
+// CHECK: translation unit cursor is null: 1
@@ -0,0 +1,22 @@
+#include "suspend-queries.h"
+
+#warning main file warning
+
+int main_var;
+
+// Each query suspends the translation unit first and must resume it.
+// RUN: c-index-test -test-suspended-queries -I %S/Inputs %s 2>&1 \
+// RUN:   | FileCheck %s
+// RUN: env CINDEXTEST_EDITING=1 c-index-test -test-suspended-queries \
+// RUN:   -I %S/Inputs %s 2>&1 | FileCheck %s
+
+// CHECK-NOT: Unable to suspend
+// CHECK: multiple include guarded: 1
+// CHECK: file found: 1
+// CHECK: cursor: VarDecl=header_var:3:5
+// CHECK: file: {{.*}}suspend-queries.c
+// CHECK: file: {{.*}}suspend-queries.h
+// CHECK-NEXT: included by:
+// CHECK-NEXT: {{.*}}suspend-queries.c:1:10
+// CHECK: diagnostics: 1
+// CHECK: translation unit: {{.*}}suspend-queries.c
@@ -0,0 +1,20 @@
+#include "suspend-reparse.h"
+
+int area(struct Shape *s) {
+  return s->sides;
+}
+
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_SUSPEND_AFTER_REPARSE=1 \
+// RUN:   c-index-test -test-load-source-reparse 3 local -I %S/Inputs %s \
+// RUN:   | FileCheck -check-prefix=CHECK-SUSPEND %s
+// CHECK-SUSPEND: suspend-reparse.c:3:5: FunctionDecl=area:3:5 (Definition)
+// CHECK-SUSPEND: suspend-reparse.c:4:3: ReturnStmt=
+
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_SUSPEND_AFTER_REPARSE=1 \
+// RUN:   CINDEXTEST_REMAP_AFTER_TRIAL=1 \
+// RUN:   c-index-test -test-load-source-reparse 3 local -I %S/Inputs \
+// RUN:   "-remap-file=%s;%S/Inputs/suspend-reparse.c.remap" %s \
+// RUN:   | FileCheck -check-prefix=CHECK-REMAP %s
+// CHECK-REMAP-NOT: FunctionDecl=area
+// CHECK-REMAP: suspend-reparse.c:3:5: FunctionDecl=perimeter:3:5 (Definition)
+// CHECK-REMAP-NOT: FunctionDecl=area
@@ -0,0 +1,33 @@
+// RUN: rm -rf %t && mkdir -p %t/include
+// RUN: echo 'struct Cached { int first; };' > %t/include/tu-cache.h
+
+// The first parse fills the cache; the second one loads from it.
+// RUN: env CINDEXTEST_TU_CACHE_DIR=%t/cache \
+// RUN:   c-index-test -test-load-source local -I %t/include %s \
+// RUN:   | FileCheck -check-prefix=CHECK-FIRST %s
+// RUN: ls %t/cache | FileCheck -check-prefix=CHECK-FILES %s
+// RUN: env CINDEXTEST_TU_CACHE_DIR=%t/cache \
+// RUN:   c-index-test -test-load-source local -I %t/include %s \
+// RUN:   | FileCheck -check-prefix=CHECK-FIRST %s
+
+// Changing a header invalidates the cached translation unit.
+// RUN: echo 'struct Cached { int unused; int first; };' \
+// RUN:   > %t/include/tu-cache.h
+// RUN: env CINDEXTEST_TU_CACHE_DIR=%t/cache \
+// RUN:   c-index-test -test-load-source local -I %t/include %s \
+// RUN:   | FileCheck -check-prefix=CHECK-SECOND %s
+
+#include "tu-cache.h"
+
+int get(struct Cached *c) {
+  return c->first;
+}
+
+// CHECK-FIRST: tu-cache.c:22:5: FunctionDecl=get:22:5 (Definition)
+// CHECK-FIRST: tu-cache.c:23:10: MemberRefExpr=first:1:21
+
+// CHECK-FILES: {{[0-9A-F]+}}.ast
+// CHECK-FILES: {{[0-9A-F]+}}.inputs
+
+// CHECK-SECOND: tu-cache.c:22:5: FunctionDecl=get:22:5 (Definition)
+// CHECK-SECOND: tu-cache.c:23:10: MemberRefExpr=first:1:33
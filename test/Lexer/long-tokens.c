@@ -0,0 +1,30 @@
+// RUN: %clang_cc1 -fsyntax-only -trigraphs -verify %s
+
+// The lexer scans identifiers, whitespace runs, line comments and string
+// literals in 16-byte chunks.  Make sure tokens that end inside, at and just
+// past a chunk boundary are still lexed correctly.
+
+int a_very_long_identifier_that_spans_several_chunks_0123456789_ABCDEFGHIJKLMNOPQRSTUVWXYZ;
+int x0123456789abcde; // 16 characters.
+int x0123456789abcdef; // 17 characters.
+int f(void) {
+  return x0123456789abcde + x0123456789abcdef +
+         a_very_long_identifier_that_spans_several_chunks_0123456789_ABCDEFGHIJKLMNOPQRSTUVWXYZ;
+}
+
+int                                                         spaced;
+int	 	 	 	 	 	 	 	 	 	 	 	 	 	 	 	tabbed;
+
+// A line comment that is long enough to be scanned in chunks continues \
+int not_declared_here;
+int g(void) {
+  return not_declared_here; // expected-error {{use of undeclared identifier 'not_declared_here'}}
+}
+
+// expected-warning@+1 {{trigraph converted to '\' character}}
+const char *s1 = "a string literal long enough to be scanned in chunks ??/" with an escaped quote";
+const char *s2 = "a string literal long enough to be scanned in chunks \" with an escaped quote";
+const char *s3 = "a string literal long enough to be scanned in chunks \
+continued on the next line";
+const char s4[] = "0123456789abcdef0123456789abcdef";
+int check_s4[sizeof(s4) == 33 ? 1 : -1];
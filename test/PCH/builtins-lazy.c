@@ -0,0 +1,19 @@
+// Builtins that the header never names must still be recognized when the
+// header comes from a PCH.
+
+// Test this without pch.
+// RUN: %clang_cc1 -include %S/builtins-lazy.h -fsyntax-only -verify %s
+
+// Test with pch.
+// RUN: %clang_cc1 -emit-pch -o %t %S/builtins-lazy.h
+// RUN: %clang_cc1 -include-pch %t -fsyntax-only -verify %s
+
+// expected-no-diagnostics
+
+int check_bswap[__builtin_bswap32(0x01000000) == 1 ? 1 : -1];
+
+int use(int x) {
+  if (__builtin_expect(x == 0, 0))
+    return header_value(x);
+  return __builtin_abs(x);
+}
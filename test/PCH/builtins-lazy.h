@@ -0,0 +1,2 @@
+// Header for PCH test builtins-lazy.c
+int header_value(int x) { return x + 1; }
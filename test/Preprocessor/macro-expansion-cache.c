@@ -0,0 +1,40 @@
+// RUN: %clang_cc1 -fsyntax-only %s 2>&1 | FileCheck %s -strict-whitespace
+// RUN: %clang_cc1 -fsyntax-only -DCHECK_VALUES -verify %s
+
+// Object-like macros that are used repeatedly have their expansions cached.
+// Make sure replayed expansions produce the same tokens and macro backtraces,
+// and that redefining a nested macro invalidates the cache.
+
+#ifdef CHECK_VALUES
+// expected-no-diagnostics
+#define ZERO 0
+#define ONE (ZERO + 1)
+#define TWO (ONE + ONE)
+int a[TWO == 2 ? 1 : -1];
+int b[TWO == 2 ? 1 : -1];
+int c[TWO == 2 ? 1 : -1];
+#undef ZERO
+#define ZERO 10
+int d[TWO == 22 ? 1 : -1];
+int e[TWO == 22 ? 1 : -1];
+int f[TWO == 22 ? 1 : -1];
+int REC1 = 5;
+#define REC1 (REC2 + 0)
+#define REC2 REC1
+int g(void) { return REC1 + REC1 + REC1; }
+#else
+#define DIV_ZERO (1 / 0)
+#define WRAPPED DIV_ZERO + 1
+int f1(void) { return WRAPPED; }
+int f2(void) { return WRAPPED; }
+int f3(void) { return WRAPPED; }
+// CHECK: macro-expansion-cache.c:28:23: warning: division by zero is undefined
+// CHECK: {{.*}}:27:17: note: expanded from macro 'WRAPPED'
+// CHECK: {{.*}}:26:21: note: expanded from macro 'DIV_ZERO'
+// CHECK: macro-expansion-cache.c:29:23: warning: division by zero is undefined
+// CHECK: {{.*}}:27:17: note: expanded from macro 'WRAPPED'
+// CHECK: {{.*}}:26:21: note: expanded from macro 'DIV_ZERO'
+// CHECK: macro-expansion-cache.c:30:23: warning: division by zero is undefined
+// CHECK: {{.*}}:27:17: note: expanded from macro 'WRAPPED'
+// CHECK: {{.*}}:26:21: note: expanded from macro 'DIV_ZERO'
+#endif
@@ -0,0 +1,11 @@
+// A header larger than the source location space is diagnosed rather than
+// silently wrapping the offsets. The header is a sparse file, so it takes no
+// disk space and is never read.
+// REQUIRES: shell
+// RUN: rm -f %t.h
+// RUN: truncate -s 2200000000 %t.h
+// RUN: not %clang_cc1 -fsyntax-only -include %t.h %s 2>&1 | FileCheck %s
+// RUN: rm -f %t.h
+
+// CHECK: fatal error: sorry, this translation unit is too large for clang to process: it needs more than {{[0-9]+}} bytes of source locations
+int x;
@@ -0,0 +1,8 @@
+// RUN: %clang_cc1 -fsyntax-only -verify %s
+
+// Builtins are suggested even when nothing in the translation unit has named
+// them yet.
+void test_unnamed_builtin(double a, double b) {
+  __builtin_isgreatr(a, b); // expected-error{{use of unknown builtin '__builtin_isgreatr'}} \
+                            // expected-note{{did you mean '__builtin_isgreater'?}}
+}
@@ -0,0 +1,25 @@
+struct Unused {
+  // Never used, so never parsed.
+  void f() { undeclared_in_unused_function(); }
+};
+
+struct Used {
+  int get() { return helper(); }
+  int helper() { return undeclared_in_used_function(); } // expected-error {{use of undeclared identifier 'undeclared_in_used_function'}}
+};
+
+struct Virtual {
+  virtual ~Virtual() {}
+  virtual void v() { undeclared_in_virtual_function(); } // expected-error {{use of undeclared identifier 'undeclared_in_virtual_function'}}
+};
+
+struct Fields {
+  Fields() : value(0) {}
+  int read() { return value; }
+private:
+  int value;
+};
+
+struct Constexpr {
+  static constexpr int size() { return 4; }
+};
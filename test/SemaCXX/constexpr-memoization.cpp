@@ -0,0 +1,41 @@
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only -verify %s -fconstexpr-steps 0
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only -print-stats %s -fconstexpr-steps 0 2>&1 | FileCheck %s
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only -verify %s -DLIMITS -fconstexpr-depth 110 -fconstexpr-steps 1000
+
+#ifndef LIMITS
+// expected-no-diagnostics
+
+// Without memoization, this would take around 2^42 calls.
+constexpr unsigned long long fib(unsigned n) {
+  return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+static_assert(fib(60) == 1548008755920ULL, "");
+static_assert(fib(59) + fib(58) == fib(60), "");
+
+// Arguments which point into a string literal are part of the key.
+constexpr unsigned hash(const char *s, unsigned h = 5381) {
+  return *s ? hash(s + 1, h * 33 + *s) : h;
+}
+static_assert(hash("ab") == (5381 * 33 + 'a') * 33 + 'b', "");
+static_assert(hash("ab") != hash("ba"), "");
+
+// CHECK: {{[1-9][0-9]*}}/{{[0-9]+}} memoized constexpr function calls reused
+#else
+
+// A reused result is charged the steps and the depth that evaluating the call
+// took, so the limits accept the same expressions as without memoization.
+constexpr int count(int n) { return n ? 1 + count(n - 1) : 0; }
+constexpr int kGood = count(100);
+
+constexpr int kFive = count(100) + count(100) + count(100) + count(100) + count(100); // expected-error {{must be initialized by a constant expression}} expected-note {{in call to 'count(100)'}}
+// expected-note@27 {{exceeded maximum of 1000 steps}}
+// expected-note@27 0+{{in call to 'count(}}
+// expected-note@27 0+{{skipping}}
+
+constexpr int wrap(int k) { return k ? wrap(k - 1) : count(100); }
+constexpr int kDeep = wrap(20); // expected-error {{must be initialized by a constant expression}} expected-note {{in call to 'wrap(20)'}}
+// expected-note@27 {{exceeded maximum depth of 110 calls}}
+// expected-note@27 0+{{in call to 'count(}}
+// expected-note@27 0+{{skipping}}
+// expected-note@35 0+{{in call to 'wrap(}}
+#endif
@@ -0,0 +1,19 @@
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only -verify %s
+// expected-no-diagnostics
+
+// Only statements and calls count against -fconstexpr-steps, so a table with
+// more elements than the default limit of 1048576 steps is still constant.
+
+#define E16 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+#define E256 E16 E16 E16 E16 E16 E16 E16 E16 \
+             E16 E16 E16 E16 E16 E16 E16 E16
+#define E4K E256 E256 E256 E256 E256 E256 E256 E256 \
+            E256 E256 E256 E256 E256 E256 E256 E256
+#define E64K E4K E4K E4K E4K E4K E4K E4K E4K \
+             E4K E4K E4K E4K E4K E4K E4K E4K
+#define E1M E64K E64K E64K E64K E64K E64K E64K E64K \
+            E64K E64K E64K E64K E64K E64K E64K E64K
+
+constexpr char table[] = { E1M E16 2 };
+static_assert(sizeof(table) == 1048576 + 17, "");
+static_assert(table[1048576 + 16] == 2, "");
@@ -0,0 +1,24 @@
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only -verify %s -fconstexpr-depth 2048 -fconstexpr-steps 1000
+// RUN: %clang -std=c++11 -fsyntax-only -Xclang -verify %s -fconstexpr-depth=2048 -fconstexpr-steps=1000
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only -verify %s -fconstexpr-depth 2048 -fconstexpr-steps 0 -DUNLIMITED
+
+constexpr int count(int n) { return n ? 1 + count(n - 1) : 0; }
+
+constexpr int kGood = count(100);
+
+// The elements of an initializer are not steps of their own.
+#define E16 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+#define E256 E16 E16 E16 E16 E16 E16 E16 E16 \
+             E16 E16 E16 E16 E16 E16 E16 E16
+constexpr int kTable[] = { E256 E256 E256 E256 E256 E256 E256 E256 0 };
+static_assert(kTable[2048] == 0, "");
+
+#ifdef UNLIMITED
+// expected-no-diagnostics
+constexpr int kLong = count(1000);
+#else
+constexpr int kLong = count(1000); // expected-error {{must be initialized by a constant expression}} expected-note {{in call to 'count(1000)'}}
+// expected-note@5 {{exceeded maximum of 1000 steps}}
+// expected-note@5 +{{in call to 'count(}}
+// expected-note@5 {{skipping}}
+#endif
@@ -0,0 +1,15 @@
+// RUN: %clang_cc1 -fsyntax-only -verify -std=c++11 -Wunused-private-field -fdelayed-inline-function-parsing -I %S/Inputs %s
+
+#include "delayed-inline-function-parsing.h"
+
+// Bodies in the main file are parsed as usual.
+struct Local {
+  void f() { undeclared_in_main_file(); } // expected-error {{use of undeclared identifier 'undeclared_in_main_file'}}
+};
+
+int use(Used &u) { return u.get(); }
+
+// Using the vtable uses the virtual functions.
+Virtual *make() { return new Virtual; }
+
+static_assert(Constexpr::size() == 4, "");
@@ -0,0 +1,31 @@
+// RUN: %clang_cc1 -fsyntax-only -verify %s
+// RUN: %clang_cc1 -fsyntax-only -print-stats %s -DNO_ERRORS 2>&1 | FileCheck %s
+
+// Candidates which one argument obviously rules out are rejected before any
+// conversion sequences are built, without changing the result.
+struct A {};
+struct B { B(int); };
+struct C { operator int() const; };
+
+struct Stream {};
+Stream &operator<<(Stream &, A);
+Stream &operator<<(Stream &, int);
+Stream &operator<<(Stream &, const B &);
+
+void test_stream(Stream &s, C c) {
+  s << 1;
+  s << A();
+  s << c;
+}
+
+#ifndef NO_ERRORS
+// The notes for rejected candidates name the first bad argument.
+void f(A, int); // expected-note {{candidate function not viable: no known conversion from 'int' to 'A' for 1st argument}}
+void f(B, A); // expected-note {{candidate function not viable: no known conversion from 'int' to 'A' for 2nd argument}}
+
+void test_notes() {
+  f(1, 2); // expected-error {{no matching function for call to 'f'}}
+}
+#endif
+
+// CHECK: {{[0-9]+}}/{{[0-9]+}} overload candidates viable, {{[1-9][0-9]*}} rejected without building conversions.
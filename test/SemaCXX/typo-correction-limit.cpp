@@ -0,0 +1,21 @@
+// RUN: %clang_cc1 -fsyntax-only -verify -fspell-checking-limit 3 %s
+// RUN: %clang_cc1 -fsyntax-only -verify -fspell-checking-limit 3 -print-stats %s 2>&1 | FileCheck %s
+
+namespace N { int counter; }
+int value; // expected-note 3 {{'value' declared here}}
+
+void f() {
+  valeu = 1; // expected-error {{use of undeclared identifier 'valeu'; did you mean 'value'?}}
+  valeu = 2; // expected-error {{use of undeclared identifier 'valeu'; did you mean 'value'?}}
+
+  // Failed corrections in a namespace are remembered, too.
+  N::zzzzqq = 1; // expected-error {{no member named 'zzzzqq' in namespace 'N'}}
+  N::zzzzqq = 2; // expected-error {{no member named 'zzzzqq' in namespace 'N'}}
+
+  vlue = 3; // expected-error {{use of undeclared identifier 'vlue'; did you mean 'value'?}}
+
+  // We have now made three attempts, so stop trying.
+  valeue = 4; // expected-error {{use of undeclared identifier 'valeue'}}
+}
+
+// CHECK: 3 typo corrections attempted, {{[0-9]+}} answered from the cache, {{[1-9][0-9]*}} skipped over the spell-checking limit.
@@ -0,0 +1,16 @@
+// RUN: %clang_cc1 -fsyntax-only -print-stats %s 2>&1 | FileCheck %s
+
+struct A { A(int); };
+void take(A);
+
+void f(int i) { take(i); }
+
+// Neither completing an unrelated class nor instantiating a template clears
+// the cache, so the second conversion from int to A is reused.
+struct Unrelated { int x; };
+template<typename T> struct Box { T t; };
+Box<int> box;
+
+void g(int j) { take(j); }
+
+// CHECK: 1/2 user-defined conversion sequences reused.
@@ -0,0 +1,35 @@
+// RUN: %clang_cc1 -fsyntax-only -verify %s
+// RUN: %clang_cc1 -fsyntax-only -print-stats %s -DNO_ERRORS 2>&1 | FileCheck %s
+
+struct A { A(int); A(const char *); };
+void take(A);
+
+void test_reuse(int i, int j, long l) {
+  take(i);
+  take(j);
+  take(l);
+  take("a");
+}
+
+// Null pointer constants convert differently from other integers.
+struct P { P(void *); P(int); }; // expected-note +{{candidate constructor}}
+void takeP(P);
+void test_null(long l) {
+  takeP(l);
+#ifndef NO_ERRORS
+  takeP(0L); // expected-error {{ambiguous}}
+#endif
+}
+
+// Completing a class can make a conversion possible.
+struct B {};
+struct D;
+struct X { operator D *() const; };
+void f(B *); // expected-note {{candidate function not viable: no known conversion from 'X' to 'B *' for 1st argument}}
+#ifndef NO_ERRORS
+void test_incomplete(X x) { f(x); } // expected-error {{no matching function for call to 'f'}}
+#endif
+struct D : B {};
+void test_complete(X x) { f(x); }
+
+// CHECK: {{[1-9][0-9]*}}/{{[0-9]+}} user-defined conversion sequences reused.
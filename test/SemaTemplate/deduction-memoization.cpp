@@ -0,0 +1,99 @@
+// RUN: %clang_cc1 -fsyntax-only -std=c++11 -verify %s
+// RUN: %clang_cc1 -fsyntax-only -std=c++11 -print-stats %s -DNO_ERRORS 2>&1 | FileCheck %s
+
+namespace std {
+  template<bool B, typename T = void> struct enable_if { typedef T type; };
+  template<typename T> struct enable_if<false, T> { };
+}
+
+template<typename T>
+typename std::enable_if<sizeof(T) == 4, int>::type four(T);
+template<typename T>
+typename std::enable_if<sizeof(T) != 4, long>::type four(T);
+
+void test_repeated(int i, char c) {
+  int a = four(i);
+  int b = four(i);
+  long d = four(c);
+  long e = four(c);
+}
+
+#ifndef NO_ERRORS
+template<typename T>
+typename std::enable_if<sizeof(T) == 4, int>::type only_four(T); // expected-note 2 {{candidate template ignored: disabled by 'enable_if' [with T = char]}}
+
+void test_failure_replayed(char c) {
+  only_four(c); // expected-error {{no matching function for call to 'only_four'}}
+  only_four(c); // expected-error {{no matching function for call to 'only_four'}}
+}
+#endif
+
+// Failures are not remembered, since completing a class can make a
+// substitution that failed succeed.
+template<typename T> typename T::type get(T *);
+void get(...);
+struct Incomplete;
+void test_incomplete(Incomplete *p) {
+  get(p);
+}
+struct Incomplete { typedef int type; };
+void test_complete(Incomplete *p) {
+  int i = get(p);
+}
+
+// Nor are failures remembered that a later definition of a constexpr
+// function, a static data member or an enumeration can turn into successes.
+namespace late_definitions {
+  constexpr bool ok(int);
+  template<typename T>
+  typename std::enable_if< ::late_definitions::ok(sizeof(T)), int>::type
+  call(T);
+  void call(...);
+  void test_call_before(int i) {
+    call(i);
+  }
+  constexpr bool ok(int) { return true; }
+  void test_call_after(int i) {
+    int n = call(i);
+  }
+
+  struct Late { static const int value; };
+  template<typename T>
+  typename std::enable_if<T::value == 1, int>::type member(T);
+  void member(...);
+  void test_member_before(Late l) {
+    member(l);
+  }
+  const int Late::value = 1;
+  void test_member_after(Late l) {
+    int n = member(l);
+  }
+
+  enum class Opaque : int;
+  template<typename T> auto enumerator(T) -> decltype(T::a);
+  void enumerator(...);
+  void test_enum_before(Opaque e) {
+    enumerator(e);
+  }
+  enum class Opaque : int { a };
+  void test_enum_after(Opaque e) {
+    Opaque o = enumerator(e);
+  }
+}
+
+// A call in the signature can find, by argument-dependent lookup, a function
+// declared after an earlier substitution failed.
+namespace adl {
+  struct S { };
+  template<typename T> auto g(T t) -> decltype(h(t));
+  void g(...);
+  void test_before(S s) {
+    g(s);
+  }
+  int h(S);
+  void test_after(S s) {
+    int i = g(s);
+  }
+}
+
+// CHECK: {{[1-9][0-9]*}}/{{[0-9]+}} substitutions of deduced template arguments reused.
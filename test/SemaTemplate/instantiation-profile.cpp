@@ -0,0 +1,33 @@
+// RUN: %clang_cc1 -fsyntax-only -ftemplate-profile=%t.json -ftemplate-profile-summary=10 %s 2>&1 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -check-prefix=TRACE %s < %t.json
+
+template<typename T> struct S {
+  T value;
+  T get() const { return value; }
+};
+
+template<unsigned N> struct Fact {
+  static const unsigned value = N * Fact<N - 1>::value;
+};
+template<> struct Fact<0> {
+  static const unsigned value = 1;
+};
+
+int f() {
+  S<int> s = { 1 };
+  return s.get() + Fact<3>::value;
+}
+
+// SUMMARY: *** Template Instantiation Profile
+// SUMMARY: Templates by inclusive time:
+// SUMMARY: Inclusive    Exclusive    Inclusive mem    Count  Name
+// SUMMARY-DAG: {{ 1  }}S{{$}}
+// SUMMARY-DAG: {{ 3  }}Fact{{$}}
+// SUMMARY: Specializations by inclusive time:
+// SUMMARY-DAG: S<int>{{$}}
+// SUMMARY-DAG: Fact<3>{{$}}
+
+// TRACE: {"traceEvents":[
+// TRACE: {"name":"S<int>","cat":"instantiation","ph":"X",{{.*}}"args":{"template":"S","depth":0,
+// TRACE: {"name":"Fact<2>",{{.*}}"args":{"template":"Fact","depth":1,
+// TRACE: "displayTimeUnit":"ms"}
@@ -0,0 +1,23 @@
+// RUN: %clang_cc1 -fsyntax-only -std=c++11 -verify %s
+// RUN: %clang_cc1 -fsyntax-only -std=c++11 -print-stats %s 2>&1 | FileCheck %s
+// expected-no-diagnostics
+
+template<typename T, int N> constexpr int a(T) { return N; }
+template<typename T, int N> constexpr int b(T) { return -N; }
+template<typename ...Ts> constexpr int c(Ts...) { return sizeof...(Ts); }
+template<typename ...Ts> constexpr int d(Ts...) { return 0; }
+
+// b<int, 3> and d<int, char> can reuse the arguments of a<int, 3> and
+// c<int, char>.
+static_assert(a<int, 3>(0) == 3, "");
+static_assert(b<int, 3>(0) == -3, "");
+static_assert(a<int, 4>(0) == 4, "");
+static_assert(c(0, 'x') == 2, "");
+static_assert(d(0, 'x') == 0, "");
+
+// Sharing storage does not affect which specialization is found.
+typedef int Int;
+template<> constexpr int a<Int, 5>(Int) { return 50; }
+static_assert(a<int, 5>(0) == 50, "");
+
+// CHECK: {{[1-9][0-9]*}}/{{[0-9]+}} template argument lists shared an existing copy
@@ -3,12 +3,17 @@
 #include "clang-c/Index.h"
 #include "clang-c/CXCompilationDatabase.h"
 #include "llvm/Config/config.h"
+#include "llvm/Config/llvm-config.h"
 #include <ctype.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
 #ifdef CLANG_HAVE_LIBXML
 #include <libxml/parser.h>
 #include <libxml/relaxng.h>
@@ -74,6 +79,10 @@ static unsigned getDefaultParsingOptions() {
     options |= CXTranslationUnit_SkipFunctionBodies;
   if (getenv("CINDEXTEST_COMPLETION_BRIEF_COMMENTS"))
     options |= CXTranslationUnit_IncludeBriefCommentsInCodeCompletion;
+  if (getenv("CINDEXTEST_ASYNC_PREAMBLE"))
+    options |= CXTranslationUnit_AsynchronousPreambleRebuild;
+  if (getenv("CINDEXTEST_INDEX_CURSOR_EXTENTS"))
+    options |= CXTranslationUnit_IndexCursorExtents;
   
   return options;
 }
@@ -1052,6 +1061,93 @@ void PrintInclusionStack(CXTranslationUnit TU) {
   clang_getInclusions(TU, InclusionVisitor, NULL);
 }
 
+/******************************************************************************/
+/* Suspended translation unit testing.                                        */
+/******************************************************************************/
+
+static void FindIncludedFile(CXFile includedFile,
+                             CXSourceLocation *includeStack,
+                             unsigned includeStackLen, CXClientData data) {
+  CXFile *file = (CXFile *)data;
+  if (includeStackLen && !*file)
+    *file = includedFile;
+}
+
+static void SuspendTU(CXTranslationUnit TU) {
+  if (!clang_suspendTranslationUnit(TU))
+    fprintf(stderr, "Unable to suspend translation unit!\n");
+}
+
+/* Suspends the translation unit before each query, so that every one of them
+   has to resume it. */
+static void PrintSuspendedQueries(CXTranslationUnit TU) {
+  CXFile header = 0;
+  char *header_name;
+  CXString str;
+  CXSourceLocation loc;
+
+  clang_getInclusions(TU, FindIncludedFile, &header);
+  if (!header) {
+    fprintf(stderr, "No included file!\n");
+    return;
+  }
+  str = clang_getFileName(header);
+  header_name = strdup(clang_getCString(str));
+  clang_disposeString(str);
+
+  SuspendTU(TU);
+  printf("multiple include guarded: %u\n",
+         clang_isFileMultipleIncludeGuarded(TU, header));
+
+  SuspendTU(TU);
+  header = clang_getFile(TU, header_name);
+  printf("file found: %d\n", header != 0);
+
+  SuspendTU(TU);
+  loc = clang_getLocation(TU, header, 3, 5);
+  printf("cursor: ");
+  PrintCursor(clang_getCursor(TU, loc), NULL);
+  printf("\n");
+
+  SuspendTU(TU);
+  PrintInclusionStack(TU);
+
+  SuspendTU(TU);
+  printf("diagnostics: %u\n", clang_getNumDiagnostics(TU));
+
+  SuspendTU(TU);
+  str = clang_getCursorSpelling(clang_getTranslationUnitCursor(TU));
+  printf("translation unit: %s\n", clang_getCString(str));
+  clang_disposeString(str);
+
+  free(header_name);
+}
+
+/* Suspends the translation unit and deletes its main file, so that resuming
+   it fails; queries must then report that there is no AST. */
+static void PrintQueriesWithoutMainFile(CXTranslationUnit TU) {
+  CXString str;
+  char *main_name;
+  CXCursor cursor;
+
+  str = clang_getTranslationUnitSpelling(TU);
+  main_name = strdup(clang_getCString(str));
+  clang_disposeString(str);
+
+  SuspendTU(TU);
+  if (remove(main_name) != 0) {
+    fprintf(stderr, "Unable to remove %s\n", main_name);
+    free(main_name);
+    return;
+  }
+
+  printf("file found: %d\n", clang_getFile(TU, main_name) != 0);
+  cursor = clang_getTranslationUnitCursor(TU);
+  printf("translation unit cursor is null: %d\n", clang_Cursor_isNull(cursor));
+
+  free(main_name);
+}
+
 /******************************************************************************/
 /* Linkage testing.                                                           */
 /******************************************************************************/
@@ -1259,6 +1355,10 @@ int perform_test_load_source(int argc, const char **argv,
     argv++;
   }
 
+  if (getenv("CINDEXTEST_TU_CACHE_DIR"))
+    clang_CXIndex_setTranslationUnitCacheDirectory(Idx,
+                                          getenv("CINDEXTEST_TU_CACHE_DIR"));
+
   if (parse_remapped_files(argc, argv, 0, &unsaved_files, &num_unsaved_files)) {
     clang_disposeIndex(Idx);
     return -1;
@@ -1293,6 +1393,7 @@ int perform_test_reparse_source(int argc, const char **argv, int trials,
   int result;
   int trial;
   int remap_after_trial = 0;
+  unsigned reparse_options;
   char *endptr = 0;
   
   Idx = clang_createIndex(/* excludeDeclsFromPCH */
@@ -1325,11 +1426,15 @@ int perform_test_reparse_source(int argc, const char **argv, int trials,
         strtol(getenv("CINDEXTEST_REMAP_AFTER_TRIAL"), &endptr, 10);
   }
 
+  reparse_options = clang_defaultReparseOptions(TU);
+  if (getenv("CINDEXTEST_WAIT_FOR_PREAMBLE"))
+    reparse_options |= CXReparse_WaitForPreambleRebuild;
+
   for (trial = 0; trial < trials; ++trial) {
     if (clang_reparseTranslationUnit(TU,
                              trial >= remap_after_trial ? num_unsaved_files : 0,
                              trial >= remap_after_trial ? unsaved_files : 0,
-                                     clang_defaultReparseOptions(TU))) {
+                                     reparse_options)) {
       fprintf(stderr, "Unable to reparse translation unit!\n");
       clang_disposeTranslationUnit(TU);
       free_remapped_files(unsaved_files, num_unsaved_files);
@@ -1339,6 +1444,16 @@ int perform_test_reparse_source(int argc, const char **argv, int trials,
 
     if (checkForErrors(TU) != 0)
       return -1;
+
+    /* Free the AST; the next reparse or query rebuilds it. */
+    if (getenv("CINDEXTEST_SUSPEND_AFTER_REPARSE") &&
+        !clang_suspendTranslationUnit(TU)) {
+      fprintf(stderr, "Unable to suspend translation unit!\n");
+      clang_disposeTranslationUnit(TU);
+      free_remapped_files(unsaved_files, num_unsaved_files);
+      clang_disposeIndex(Idx);
+      return -1;
+    }
   }
   
   result = perform_test_load(Idx, TU, filter, NULL, Visitor, PV, NULL);
@@ -1755,7 +1870,11 @@ int perform_code_completion(int argc, const char **argv, int timing_only) {
   CXTranslationUnit TU = 0;
   unsigned I, Repeats = 1;
   unsigned completionOptions = clang_defaultCodeCompleteOptions();
+  const char *typedPrefix = getenv("CINDEXTEST_COMPLETION_PREFIX");
+  unsigned maxResults = 0;
   
+  if (getenv("CINDEXTEST_COMPLETION_MAX_RESULTS"))
+    maxResults = atoi(getenv("CINDEXTEST_COMPLETION_MAX_RESULTS"));
   if (getenv("CINDEXTEST_CODE_COMPLETE_PATTERNS"))
     completionOptions |= CXCodeComplete_IncludeCodePatterns;
   if (getenv("CINDEXTEST_COMPLETION_BRIEF_COMMENTS"))
@@ -1793,9 +1912,15 @@ int perform_code_completion(int argc, const char **argv, int timing_only) {
   }
   
   for (I = 0; I != Repeats; ++I) {
-    results = clang_codeCompleteAt(TU, filename, line, column,
-                                   unsaved_files, num_unsaved_files,
-                                   completionOptions);
+    if (typedPrefix || maxResults)
+      results = clang_codeCompleteAtWithPrefix(TU, filename, line, column,
+                                               unsaved_files, num_unsaved_files,
+                                               completionOptions, typedPrefix,
+                                               maxResults);
+    else
+      results = clang_codeCompleteAt(TU, filename, line, column,
+                                     unsaved_files, num_unsaved_files,
+                                     completionOptions);
     if (!results) {
       fprintf(stderr, "Unable to perform code completion!\n");
       return 1;
@@ -1811,8 +1936,24 @@ int perform_code_completion(int argc, const char **argv, int timing_only) {
     CXString objCSelector;
     const char *selectorString;
     if (!timing_only) {      
-      /* Sort the code-completion results based on the typed text. */
-      clang_sortCodeCompletionResults(results->Results, results->NumResults);
+      const char *filter = getenv("CINDEXTEST_COMPLETION_FILTER");
+      if (filter) {
+        /* Apply each of the comma-separated filters in turn, as if the user
+           were typing (or deleting) characters. */
+        char *filters = strdup(filter);
+        char *start = filters, *comma;
+        do {
+          comma = strchr(start, ',');
+          if (comma)
+            *comma = 0;
+          n = clang_codeCompleteFilterResults(results, start);
+          start = comma + 1;
+        } while (comma);
+        free(filters);
+      } else {
+        /* Sort the code-completion results based on the typed text. */
+        clang_sortCodeCompletionResults(results->Results, results->NumResults);
+      }
 
       for (i = 0; i != n; ++i)
         print_completion_result(results->Results + i, stdout);
@@ -1873,6 +2014,120 @@ typedef struct {
   unsigned column;
 } CursorSourceLocation;
 
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+/* Mix a string into a hash, then dispose of it. */
+static unsigned long hash_cxstring(unsigned long hash, CXString str) {
+  const char *s = clang_getCString(str);
+  for (; s && *s; ++s)
+    hash = hash * 33 + (unsigned char)*s;
+  clang_disposeString(str);
+  return hash * 33;
+}
+
+/* Ask about the cursor at a location the way an editor answering a hover
+   request would, and summarize the answers as a hash. */
+static unsigned long query_cursor_at(CXTranslationUnit TU,
+                                     const CursorSourceLocation *Location) {
+  CXFile file = clang_getFile(TU, Location->filename);
+  CXCursor Cursor;
+  CXType Type;
+  CXToken *Tokens = 0;
+  unsigned NumTokens = 0, Offset = 0, I;
+  unsigned long hash = 5381;
+
+  if (!file)
+    return 0;
+
+  Cursor = clang_getCursor(TU, clang_getLocation(TU, file, Location->line,
+                                                 Location->column));
+  hash = hash * 33 + clang_getCursorKind(Cursor);
+  hash = hash_cxstring(hash, clang_getCursorSpelling(Cursor));
+  hash = hash_cxstring(hash,
+                       clang_getCursorUSR(clang_getCursorReferenced(Cursor)));
+
+  Type = clang_getCursorType(Cursor);
+  hash = hash * 33 + clang_getCanonicalType(Type).kind;
+  hash = hash_cxstring(hash,
+                       clang_getCursorUSR(clang_getTypeDeclaration(Type)));
+
+  clang_getSpellingLocation(clang_getCursorLocation(Cursor), 0, 0, 0,
+                            &Offset);
+  hash = hash * 33 + Offset;
+
+  clang_tokenize(TU, clang_getCursorExtent(Cursor), &Tokens, &NumTokens);
+  for (I = 0; I != NumTokens; ++I)
+    hash = hash_cxstring(hash, clang_getTokenSpelling(TU, Tokens[I]));
+  clang_disposeTokens(TU, Tokens, NumTokens);
+  return hash;
+}
+
+typedef struct {
+  CXTranslationUnit TU;
+  const CursorSourceLocation *Locations;
+  unsigned NumLocations;
+  const unsigned long *Expected;
+  unsigned Mismatches;
+} ConcurrentQueryInfo;
+
+static void *run_concurrent_queries(void *UserData) {
+  ConcurrentQueryInfo *Info = (ConcurrentQueryInfo *)UserData;
+  unsigned Round, Loc;
+  for (Round = 0; Round != 20; ++Round)
+    for (Loc = 0; Loc != Info->NumLocations; ++Loc)
+      if (query_cursor_at(Info->TU, &Info->Locations[Loc]) !=
+          Info->Expected[Loc])
+        ++Info->Mismatches;
+  return 0;
+}
+#endif
+
+/* Repeat the queries for every location from several threads at once, and
+   check that each thread gets the same answers as a single thread does. */
+static int check_concurrent_queries(CXTranslationUnit TU,
+                                    const CursorSourceLocation *Locations,
+                                    unsigned NumLocations,
+                                    unsigned NumThreads) {
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+  unsigned long *Expected;
+  ConcurrentQueryInfo *Infos;
+  pthread_t *Threads;
+  unsigned I, NumStarted = 0, Mismatches = 0;
+
+  Expected = (unsigned long *)malloc(NumLocations * sizeof(unsigned long));
+  for (I = 0; I != NumLocations; ++I)
+    Expected[I] = query_cursor_at(TU, &Locations[I]);
+
+  Infos = (ConcurrentQueryInfo *)malloc(NumThreads *
+                                        sizeof(ConcurrentQueryInfo));
+  Threads = (pthread_t *)malloc(NumThreads * sizeof(pthread_t));
+  for (I = 0; I != NumThreads; ++I) {
+    Infos[I].TU = TU;
+    Infos[I].Locations = Locations;
+    Infos[I].NumLocations = NumLocations;
+    Infos[I].Expected = Expected;
+    Infos[I].Mismatches = 0;
+    if (pthread_create(&Threads[I], 0, run_concurrent_queries, &Infos[I]))
+      break;
+    ++NumStarted;
+  }
+  for (I = 0; I != NumStarted; ++I) {
+    pthread_join(Threads[I], 0);
+    Mismatches += Infos[I].Mismatches;
+  }
+
+  free(Threads);
+  free(Infos);
+  free(Expected);
+
+  if (Mismatches) {
+    fprintf(stderr, "%u concurrent queries disagreed with sequential ones\n",
+            Mismatches);
+    return 1;
+  }
+#endif
+  return 0;
+}
+
 static int inspect_cursor_at(int argc, const char **argv) {
   CXIndex CIdx;
   int errorCode;
@@ -1926,6 +2181,13 @@ static int inspect_cursor_at(int argc, const char **argv) {
   if (checkForErrors(TU) != 0)
     return -1;
 
+  if (getenv("CINDEXTEST_CONCURRENT_QUERIES") &&
+      check_concurrent_queries(TU, Locations, NumLocations,
+                               atoi(getenv("CINDEXTEST_CONCURRENT_QUERIES")))) {
+    clang_disposeTranslationUnit(TU);
+    return 1;
+  }
+
   for (I = 0; I != Repeats; ++I) {
     if (Repeats > 1 &&
         clang_reparseTranslationUnit(TU, num_unsaved_files, unsaved_files, 
@@ -2606,6 +2868,18 @@ static IndexerCallbacks IndexCB = {
   index_indexEntityReference
 };
 
+static void loadSkippedBodies(CXIndexAction idxAction) {
+  const char *path = getenv("CINDEXTEST_LOAD_SKIPPED_BODIES");
+  if (path && clang_IndexAction_loadSkippedBodies(idxAction, path))
+    fprintf(stderr, "could not load skipped bodies from '%s'\n", path);
+}
+
+static void saveSkippedBodies(CXIndexAction idxAction) {
+  const char *path = getenv("CINDEXTEST_SAVE_SKIPPED_BODIES");
+  if (path && clang_IndexAction_saveSkippedBodies(idxAction, path))
+    fprintf(stderr, "could not save skipped bodies to '%s'\n", path);
+}
+
 static unsigned getIndexOptions(void) {
   unsigned index_opts;
   index_opts = 0;
@@ -2650,6 +2924,53 @@ static int index_compile_args(int num_args, const char **args,
   return result;
 }
 
+static int index_compile_commands_batch(CXCompileCommands CCmds,
+                                       CXIndexAction idxAction,
+                                       const char *check_prefix,
+                                       unsigned num_threads) {
+  IndexData *index_data;
+  CXClientData *client_data;
+  int *results;
+  unsigned i, num_cmds;
+  int result;
+
+  if (num_threads == 0)
+    num_threads = 1;
+  num_cmds = clang_CompileCommands_getSize(CCmds);
+  index_data = (IndexData *)malloc(num_threads * sizeof(IndexData));
+  client_data = (CXClientData *)malloc(num_threads * sizeof(CXClientData));
+  results = (int *)malloc((num_cmds ? num_cmds : 1) * sizeof(int));
+  for (i = 0; i != num_threads; ++i) {
+    index_data[i].check_prefix = check_prefix;
+    index_data[i].first_check_printed = 0;
+    index_data[i].fail_for_error = 0;
+    index_data[i].abort = 0;
+    index_data[i].main_filename = "";
+    index_data[i].importedASTs = 0;
+    client_data[i] = &index_data[i];
+  }
+  for (i = 0; i != num_cmds; ++i)
+    results[i] = 1;
+
+  result = clang_indexSourceFiles(idxAction, client_data, num_threads,
+                                  &IndexCB, sizeof(IndexCB),
+                                  getIndexOptions(), CCmds,
+                                  getDefaultParsingOptions(), results);
+  for (i = 0; i != num_threads; ++i)
+    if (index_data[i].fail_for_error)
+      result = -1;
+
+  /* Print the per-command results after the workers have joined, so they
+     come out in command order regardless of the thread count. */
+  for (i = 0; i != num_cmds; ++i)
+    printf("[indexSourceFiles]: command %u: result %d\n", i, results[i]);
+
+  free(results);
+  free(client_data);
+  free(index_data);
+  return result;
+}
+
 static int index_ast_file(const char *ast_file,
                           CXIndex Idx,
                           CXIndexAction idxAction,
@@ -2703,6 +3024,7 @@ static int index_file(int argc, const char **argv, int full) {
     return 1;
   }
   idxAction = clang_IndexAction_create(Idx);
+  loadSkippedBodies(idxAction);
   importedASTs = 0;
   if (full)
     importedASTs = importedASTs_create();
@@ -2721,6 +3043,7 @@ static int index_file(int argc, const char **argv, int full) {
 
 finished:
   importedASTs_dispose(importedASTs);
+  saveSkippedBodies(idxAction);
   clang_IndexAction_dispose(idxAction);
   clang_disposeIndex(Idx);
   return result;
@@ -2782,6 +3105,7 @@ static int index_compile_db(int argc, const char **argv) {
     return 1;
   }
   idxAction = clang_IndexAction_create(Idx);
+  loadSkippedBodies(idxAction);
 
   {
     const char *database = argv[0];
@@ -2834,6 +3158,12 @@ static int index_compile_db(int argc, const char **argv) {
         goto cdb_end;
       }
 
+      if (getenv("CINDEXTEST_BATCH_INDEX")) {
+        errorCode = index_compile_commands_batch(CCmds, idxAction, check_prefix,
+                                        atoi(getenv("CINDEXTEST_BATCH_INDEX")));
+        goto cdb_end;
+      }
+
       for (i=0; i<numCmds && errorCode == 0; ++i) {
         CCmd = clang_CompileCommands_getCommand(CCmds, i);
 
@@ -2874,6 +3204,7 @@ static int index_compile_db(int argc, const char **argv) {
 
   }
 
+  saveSkippedBodies(idxAction);
   clang_IndexAction_dispose(idxAction);
   clang_disposeIndex(Idx);
   return errorCode;
@@ -3540,7 +3871,9 @@ static void print_usage(void) {
           "<symbol filter> {<args>}*\n"
     "       c-index-test -test-annotate-tokens=<range> {<args>}*\n"
     "       c-index-test -test-inclusion-stack-source {<args>}*\n"
-    "       c-index-test -test-inclusion-stack-tu <AST file>\n");
+    "       c-index-test -test-inclusion-stack-tu <AST file>\n"
+    "       c-index-test -test-suspended-queries {<args>}*\n"
+    "       c-index-test -test-resume-missing-file {<args>}*\n");
   fprintf(stderr,
     "       c-index-test -test-print-linkage-source {<args>}*\n"
     "       c-index-test -test-print-typekind {<args>}*\n"
@@ -3594,10 +3927,15 @@ int cindextest_main(int argc, const char **argv) {
   }
   else if (argc >= 5 && strncmp(argv[1], "-test-load-source-reparse", 25) == 0){
     CXCursorVisitor I = GetVisitor(argv[1] + 25);
+
+    PostVisitTU postVisit = 0;
+    if (strstr(argv[1], "-memory-usage"))
+      postVisit = PrintMemoryUsage;
+
     if (I) {
       int trials = atoi(argv[2]);
       return perform_test_reparse_source(argc - 4, argv + 4, trials, argv[3], I, 
-                                         NULL);
+                                         postVisit);
     }
   }
   else if (argc >= 4 && strncmp(argv[1], "-test-load-source", 17) == 0) {
@@ -3622,6 +3960,12 @@ int cindextest_main(int argc, const char **argv) {
   else if (argc > 2 && strcmp(argv[1], "-test-inclusion-stack-tu") == 0)
     return perform_test_load_tu(argv[2], "all", NULL, NULL,
                                 PrintInclusionStack);
+  else if (argc > 2 && strcmp(argv[1], "-test-suspended-queries") == 0)
+    return perform_test_load_source(argc - 2, argv + 2, "all", NULL,
+                                    PrintSuspendedQueries);
+  else if (argc > 2 && strcmp(argv[1], "-test-resume-missing-file") == 0)
+    return perform_test_load_source(argc - 2, argv + 2, "all", NULL,
+                                    PrintQueriesWithoutMainFile);
   else if (argc > 2 && strcmp(argv[1], "-test-print-linkage-source") == 0)
     return perform_test_load_source(argc - 2, argv + 2, "all", PrintLinkage,
                                     NULL);
@@ -32,6 +32,7 @@
 #include "clang/Lex/Lexer.h"
 #include "clang/Lex/PreprocessingRecord.h"
 #include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSwitch.h"
@@ -41,8 +42,10 @@
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/RWMutex.h"
 #include "llvm/Support/SaveAndRestore.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadLocal.h"
 #include "llvm/Support/Threading.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
@@ -53,6 +56,80 @@ using namespace clang::cxstring;
 using namespace clang::cxtu;
 using namespace clang::cxindex;
 
+static void createCursorExtentIndex(CXTranslationUnit TU);
+static void clearCursorExtentIndex(CXTranslationUnit TU);
+static void disposeCursorExtentIndex(CXTranslationUnit TU);
+
+/// \brief The translation unit that owns each source manager, so that the
+/// functions that only receive a source location can find its lock.
+static llvm::DenseMap<const SourceManager *, CXTranslationUnit>
+  SourceManagerOwners;
+static llvm::sys::RWMutex SourceManagerOwnersMutex;
+
+/// \brief Record \p TU as the owner of its current source manager. Must be
+/// called again whenever parsing gives the translation unit a new one.
+static void registerSourceManager(CXTranslationUnit TU) {
+  const SourceManager *SM =
+    &static_cast<ASTUnit *>(TU->TUData)->getSourceManager();
+  llvm::sys::ScopedWriter Guard(SourceManagerOwnersMutex);
+  SourceManagerOwners[SM] = TU;
+}
+
+/// \brief Forget the source manager of \p TU, before it is destroyed.
+static void unregisterSourceManager(CXTranslationUnit TU) {
+  const SourceManager *SM =
+    &static_cast<ASTUnit *>(TU->TUData)->getSourceManager();
+  llvm::sys::ScopedWriter Guard(SourceManagerOwnersMutex);
+  llvm::DenseMap<const SourceManager *, CXTranslationUnit>::iterator
+    Pos = SourceManagerOwners.find(SM);
+  if (Pos != SourceManagerOwners.end() && Pos->second == TU)
+    SourceManagerOwners.erase(Pos);
+}
+
+/// \brief The translation unit lock that the current thread has borrowed
+/// from the thread that is waiting for it, if any.
+static llvm::sys::ThreadLocal<llvm::sys::Mutex> BorrowedAccessMutex;
+
+cxtu::CXTULock::CXTULock(CXTranslationUnit TU)
+  : M(TU ? static_cast<llvm::sys::Mutex *>(TU->AccessMutex) : 0) {
+  if (M == BorrowedAccessMutex.get())
+    M = 0;
+  if (M)
+    M->acquire();
+}
+
+cxtu::CXTULock::CXTULock(const SourceManager *SM) : M(0) {
+  if (!SM)
+    return;
+
+  {
+    llvm::sys::ScopedReader Guard(SourceManagerOwnersMutex);
+    llvm::DenseMap<const SourceManager *, CXTranslationUnit>::iterator
+      Pos = SourceManagerOwners.find(SM);
+    if (Pos != SourceManagerOwners.end())
+      M = static_cast<llvm::sys::Mutex *>(Pos->second->AccessMutex);
+  }
+  if (M == BorrowedAccessMutex.get())
+    M = 0;
+  if (M)
+    M->acquire();
+}
+
+cxtu::CXTULock::~CXTULock() {
+  if (M)
+    M->release();
+}
+
+cxtu::CXTULockBorrow::CXTULockBorrow(CXTranslationUnit TU)
+  : Prev(BorrowedAccessMutex.get()) {
+  BorrowedAccessMutex.set(
+      TU ? static_cast<llvm::sys::Mutex *>(TU->AccessMutex) : 0);
+}
+
+cxtu::CXTULockBorrow::~CXTULockBorrow() {
+  BorrowedAccessMutex.set(Prev);
+}
+
 CXTranslationUnit cxtu::MakeCXTranslationUnit(CIndexer *CIdx, ASTUnit *TU) {
   if (!TU)
     return 0;
@@ -64,9 +141,58 @@ CXTranslationUnit cxtu::MakeCXTranslationUnit(CIndexer *CIdx, ASTUnit *TU) {
   D->OverridenCursorsPool = createOverridenCXCursorsPool();
   D->FormatContext = 0;
   D->FormatInMemoryUniqueId = 0;
+  D->CursorExtentIndex = 0;
+  D->AccessMutex = new llvm::sys::Mutex(/*recursive=*/true);
+  registerSourceManager(D);
   return D;
 }
 
+bool cxtu::resumeIfSuspended(CXTranslationUnit TU) {
+  if (!TU)
+    return false;
+
+  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  if (!CXXUnit)
+    return false;
+  if (!CXXUnit->isSuspended())
+    return true;
+
+  // Resuming reparses the main file, which replaces its diagnostics.
+  delete static_cast<CXDiagnosticSetImpl*>(TU->Diagnostics);
+  TU->Diagnostics = 0;
+  clearCursorExtentIndex(TU);
+  unregisterSourceManager(TU);
+  // A unit that fails to resume stays suspended, so each query tries again.
+  bool Failed = CXXUnit->Resume();
+  registerSourceManager(TU);
+  return !Failed;
+}
+
+ASTUnit *cxtu::getASTUnit(CXTranslationUnit TU) {
+  if (!TU)
+    return 0;
+
+  if (!resumeIfSuspended(TU))
+    return 0;
+  return static_cast<ASTUnit *>(TU->TUData);
+}
+
+ASTUnit *cxtu::getASTUnit(CXTranslationUnit TU, const FileEntry *&File) {
+  if (!TU)
+    return 0;
+
+  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  if (!File || !CXXUnit || !CXXUnit->isSuspended())
+    return CXXUnit;
+
+  // The old file manager goes away on resume, so remember the name first.
+  std::string Name = File->getName();
+  if (!resumeIfSuspended(TU))
+    return 0;
+  File = CXXUnit->getFileManager().getFile(Name);
+  return CXXUnit;
+}
+
 cxtu::CXTUOwner::~CXTUOwner() {
   if (TU)
     clang_disposeTranslationUnit(TU);
@@ -2479,6 +2605,13 @@ unsigned clang_CXIndex_getGlobalOptions(CXIndex CIdx) {
   return 0;
 }
 
+void clang_CXIndex_setTranslationUnitCacheDirectory(CXIndex CIdx,
+                                                    const char *Path) {
+  if (CIdx)
+    static_cast<CIndexer *>(CIdx)
+      ->setTranslationUnitCacheDirectory(Path ? Path : "");
+}
+
 void clang_toggleCrashRecovery(unsigned isEnabled) {
   if (isEnabled)
     llvm::CrashRecoveryContext::Enable();
@@ -2629,6 +2762,24 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
     Args->push_back("-Xclang");
     Args->push_back("-detailed-preprocessing-record");
   }
+
+  // A translation unit loaded from the cache can't be reparsed, used for code
+  // completion or saved, so only use the cache when none of that was asked
+  // for.
+  bool UseCache = num_unsaved_files == 0 &&
+    !(options & (CXTranslationUnit_PrecompiledPreamble |
+                 CXTranslationUnit_CacheCompletionResults |
+                 CXTranslationUnit_Incomplete |
+                 CXTranslationUnit_ForSerialization));
+  if (UseCache) {
+    if (ASTUnit *Cached
+          = loadCachedTranslationUnit(*CXXIdx, *Args, options, Diags)) {
+      PTUI->result = MakeCXTranslationUnit(CXXIdx, Cached);
+      if (options & CXTranslationUnit_IndexCursorExtents)
+        createCursorExtentIndex(PTUI->result);
+      return;
+    }
+  }
   
   unsigned NumErrors = Diags->getClient()->getNumErrors();
   OwningPtr<ASTUnit> ErrUnit;
@@ -2653,6 +2804,12 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
                                  ForSerialization,
                                  &ErrUnit));
 
+  if (Unit && (options & CXTranslationUnit_AsynchronousPreambleRebuild))
+    Unit->setAsynchronousPreambleRebuild(true);
+
+  if (Unit && UseCache)
+    cacheTranslationUnit(*CXXIdx, *Args, options, *Unit);
+
   if (NumErrors != Diags->getClient()->getNumErrors()) {
     // Make sure to check that 'Unit' is non-NULL.
     if (CXXIdx->getDisplayDiagnostics())
@@ -2660,6 +2817,8 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
   }
 
   PTUI->result = MakeCXTranslationUnit(CXXIdx, Unit.take());
+  if (PTUI->result && (options & CXTranslationUnit_IndexCursorExtents))
+    createCursorExtentIndex(PTUI->result);
 }
 CXTranslationUnit clang_parseTranslationUnit(CXIndex CIdx,
                                              const char *source_filename,
@@ -2720,6 +2879,7 @@ struct SaveTranslationUnitInfo {
 static void clang_saveTranslationUnit_Impl(void *UserData) {
   SaveTranslationUnitInfo *STUI =
     static_cast<SaveTranslationUnitInfo*>(UserData);
+  CXTULockBorrow Borrow(STUI->TU);
 
   CIndexer *CXXIdx = (CIndexer*)STUI->TU->CIdx;
   if (CXXIdx->isOptEnabled(CXGlobalOpt_ThreadBackgroundPriorityForIndexing))
@@ -2734,7 +2894,10 @@ int clang_saveTranslationUnit(CXTranslationUnit TU, const char *FileName,
   if (!TU)
     return CXSaveError_InvalidTU;
 
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  CXTULock Lock(TU);
+  ASTUnit *CXXUnit = getASTUnit(TU);
+  if (!CXXUnit)
+    return CXSaveError_InvalidTU;
   ASTUnit::ConcurrencyCheck Check(*CXXUnit);
   if (!CXXUnit->hasSema())
     return CXSaveError_InvalidTU;
@@ -2778,11 +2941,14 @@ void clang_disposeTranslationUnit(CXTranslationUnit CTUnit) {
     if (static_cast<ASTUnit *>(CTUnit->TUData)->isUnsafeToFree())
       return;
 
+    unregisterSourceManager(CTUnit);
     delete static_cast<ASTUnit *>(CTUnit->TUData);
     disposeCXStringPool(CTUnit->StringPool);
     delete static_cast<CXDiagnosticSetImpl *>(CTUnit->Diagnostics);
     disposeOverridenCXCursorsPool(CTUnit->OverridenCursorsPool);
     delete static_cast<SimpleFormatContext*>(CTUnit->FormatContext);
+    disposeCursorExtentIndex(CTUnit);
+    delete static_cast<llvm::sys::Mutex *>(CTUnit->AccessMutex);
     delete CTUnit;
   }
 }
@@ -2804,14 +2970,18 @@ static void clang_reparseTranslationUnit_Impl(void *UserData) {
     static_cast<ReparseTranslationUnitInfo*>(UserData);
   CXTranslationUnit TU = RTUI->TU;
 
+  // Reparsing replaces the whole AST; clang_reparseTranslationUnit() holds
+  // the lock for us.
+  CXTULockBorrow Borrow(TU);
+
   // Reset the associated diagnostics.
   delete static_cast<CXDiagnosticSetImpl*>(TU->Diagnostics);
   TU->Diagnostics = 0;
+  clearCursorExtentIndex(TU);
 
   unsigned num_unsaved_files = RTUI->num_unsaved_files;
   struct CXUnsavedFile *unsaved_files = RTUI->unsaved_files;
   unsigned options = RTUI->options;
-  (void) options;
   RTUI->result = 1;
 
   if (!TU)
@@ -2839,9 +3009,14 @@ static void clang_reparseTranslationUnit_Impl(void *UserData) {
                                             Buffer));
   }
   
+  if (options & CXReparse_WaitForPreambleRebuild)
+    CXXUnit->waitForPreambleRebuild();
+
+  unregisterSourceManager(TU);
   if (!CXXUnit->Reparse(RemappedFiles->size() ? &(*RemappedFiles)[0] : 0,
                         RemappedFiles->size()))
     RTUI->result = 0;
+  registerSourceManager(TU);
 }
 
 int clang_reparseTranslationUnit(CXTranslationUnit TU,
@@ -2850,6 +3025,7 @@ int clang_reparseTranslationUnit(CXTranslationUnit TU,
                                  unsigned options) {
   ReparseTranslationUnitInfo RTUI = { TU, num_unsaved_files, unsaved_files,
                                       options, 0 };
+  CXTULock Lock(TU);
 
   if (getenv("LIBCLANG_NOTHREADS")) {
     clang_reparseTranslationUnit_Impl(&RTUI);
@@ -2868,6 +3044,22 @@ int clang_reparseTranslationUnit(CXTranslationUnit TU,
   return RTUI.result;
 }
 
+unsigned clang_suspendTranslationUnit(CXTranslationUnit TU) {
+  CXTULock Lock(TU);
+  if (!TU)
+    return 0;
+
+  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  ASTUnit::ConcurrencyCheck Check(*CXXUnit);
+  if (CXXUnit->isUnsafeToFree())
+    return 0;
+
+  // Cursors refer into the AST; none of them may be used from now on.
+  disposeOverridenCXCursorsPool(TU->OverridenCursorsPool);
+  TU->OverridenCursorsPool = createOverridenCXCursorsPool();
+  clearCursorExtentIndex(TU);
+  return !CXXUnit->Suspend();
+}
 
 CXString clang_getTranslationUnitSpelling(CXTranslationUnit CTUnit) {
   if (!CTUnit)
@@ -2878,7 +3070,10 @@ CXString clang_getTranslationUnitSpelling(CXTranslationUnit CTUnit) {
 }
 
 CXCursor clang_getTranslationUnitCursor(CXTranslationUnit TU) {
-  ASTUnit *CXXUnit = static_cast<ASTUnit*>(TU->TUData);
+  CXTULock Lock(TU);
+  ASTUnit *CXXUnit = getASTUnit(TU);
+  if (!CXXUnit)
+    return clang_getNullCursor();
   return MakeCXCursor(CXXUnit->getASTContext().getTranslationUnitDecl(), TU);
 }
 
@@ -2906,21 +3101,28 @@ time_t clang_getFileTime(CXFile SFile) {
 }
 
 CXFile clang_getFile(CXTranslationUnit tu, const char *file_name) {
+  CXTULock Lock(tu);
   if (!tu)
     return 0;
 
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(tu->TUData);
+  ASTUnit *CXXUnit = getASTUnit(tu);
+  if (!CXXUnit)
+    return 0;
 
   FileManager &FMgr = CXXUnit->getFileManager();
   return const_cast<FileEntry *>(FMgr.getFile(file_name));
 }
 
 unsigned clang_isFileMultipleIncludeGuarded(CXTranslationUnit tu, CXFile file) {
+  CXTULock Lock(tu);
   if (!tu || !file)
     return 0;
 
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(tu->TUData);
-  FileEntry *FEnt = static_cast<FileEntry *>(file);
+  const FileEntry *FEnt = static_cast<FileEntry *>(file);
+  ASTUnit *CXXUnit = getASTUnit(tu, FEnt);
+  if (!CXXUnit || !FEnt)
+    return 0;
+
   return CXXUnit->getPreprocessor().getHeaderSearchInfo()
                                           .isFileMultipleIncludeGuarded(FEnt);
 }
@@ -3004,6 +3206,7 @@ extern "C" {
 unsigned clang_visitChildren(CXCursor parent,
                              CXCursorVisitor visitor,
                              CXClientData client_data) {
+  CXTULock Lock(getCursorTU(parent));
   CursorVisitor CursorVis(getCursorTU(parent), visitor, client_data,
                           /*VisitPreprocessorLast=*/false);
   return CursorVis.VisitChildren(parent);
@@ -3083,6 +3286,7 @@ static CXString getDeclSpelling(Decl *D) {
 }
 
 CXString clang_getCursorSpelling(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (clang_isTranslationUnit(C.kind))
     return clang_getTranslationUnitSpelling(
                             static_cast<CXTranslationUnit>(C.data[2]));
@@ -3214,6 +3418,7 @@ CXString clang_getCursorSpelling(CXCursor C) {
 CXSourceRange clang_Cursor_getSpellingNameRange(CXCursor C,
                                                 unsigned pieceIndex,
                                                 unsigned options) {
+  CXTULock Lock(getCursorTU(C));
   if (clang_Cursor_isNull(C))
     return clang_getNullRange();
 
@@ -3293,6 +3498,7 @@ CXSourceRange clang_Cursor_getSpellingNameRange(CXCursor C,
 }
 
 CXString clang_getCursorDisplayName(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return clang_getCursorSpelling(C);
   
@@ -3786,10 +3992,13 @@ static enum CXChildVisitResult GetCursorVisitor(CXCursor cursor,
 }
 
 CXCursor clang_getCursor(CXTranslationUnit TU, CXSourceLocation Loc) {
+  CXTULock Lock(TU);
   if (!TU)
     return clang_getNullCursor();
 
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  ASTUnit *CXXUnit = getASTUnit(TU);
+  if (!CXXUnit)
+    return clang_getNullCursor();
   ASTUnit::ConcurrencyCheck Check(*CXXUnit);
 
   SourceLocation SLoc = cxloc::translateSourceLocation(Loc);
@@ -3911,6 +4120,7 @@ CXCursorKind clang_getCursorKind(CXCursor C) {
 }
 
 CXSourceLocation clang_getCursorLocation(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (clang_isReference(C.kind)) {
     switch (C.kind) {
     case CXCursor_ObjCSuperClassRef: {
@@ -4041,6 +4251,300 @@ CXSourceLocation clang_getCursorLocation(CXCursor C) {
 
 } // end extern "C"
 
+namespace {
+
+/// \brief An index of the extents of the cursors in each file of a
+/// translation unit, used to answer clang_getCursor() without walking the
+/// AST.
+///
+/// The index for a file records every cursor that a CursorVisitor over the
+/// whole file visits, in visitation order, along with its parent. Given a
+/// location, clang_getCursor() only needs the cursors whose extents contain
+/// it, visited in the same order; at each level of the tree, these are
+/// found by binary search over the children sorted by start offset.
+class CursorExtentIndex {
+  struct Node {
+    CXCursor Cursor;
+    CXCursor Parent;
+    SourceRange Extent;
+    /// \brief The extent as offsets into the file, widened to cover the
+    /// expansions of macro locations.
+    unsigned Begin, End;
+    /// \brief Whether Begin and End are meaningful; if not, the node is
+    /// always checked against the location.
+    bool HasOffsets;
+    /// \brief The index of the level holding the children of this node, or
+    /// ~0U if it has none.
+    unsigned Children;
+  };
+
+  /// \brief The children of one node (or the top-level cursors).
+  struct Level {
+    /// \brief The nodes with offsets, sorted by their start offset.
+    std::vector<unsigned> ByBegin;
+    /// \brief MaxEnd[I] is the largest end offset of ByBegin[0..I].
+    std::vector<unsigned> MaxEnd;
+    /// \brief The nodes without offsets.
+    std::vector<unsigned> Unmapped;
+  };
+
+  struct FileIndex {
+    std::vector<Node> Nodes;
+    std::vector<Level> Levels;
+  };
+
+  llvm::DenseMap<FileID, FileIndex *> Files;
+
+  /// \brief The state used while building the index for a file.
+  struct Builder {
+    SourceManager &SM;
+    FileID File;
+    FileIndex &Index;
+    SmallVector<unsigned, 16> Stack;
+
+    Builder(SourceManager &SM, FileID File, FileIndex &Index)
+      : SM(SM), File(File), Index(Index) { }
+
+    bool getOffset(SourceLocation Loc, bool IsEnd, unsigned &Offset) {
+      if (Loc.isMacroID())
+        Loc = IsEnd ? SM.getExpansionRange(Loc).second
+                    : SM.getExpansionRange(Loc).first;
+      std::pair<FileID, unsigned> Decomposed = SM.getDecomposedLoc(Loc);
+      if (Decomposed.first != File)
+        return false;
+      Offset = Decomposed.second;
+      return true;
+    }
+  };
+
+  static enum CXChildVisitResult record(CXCursor Cursor, CXCursor Parent,
+                                        CXClientData ClientData);
+  static bool recordEnd(CXCursor Cursor, CXClientData ClientData);
+
+  FileIndex *getFileIndex(CXTranslationUnit TU, FileID File);
+
+  void collectCandidates(const FileIndex &Index, const Level &L,
+                         unsigned Offset,
+                         SmallVectorImpl<unsigned> &Candidates);
+
+  bool replay(const FileIndex &Index, unsigned LevelIndex, SourceManager &SM,
+              SourceLocation Loc, unsigned Offset, GetCursorData &Data);
+
+public:
+  ~CursorExtentIndex() { clear(); }
+
+  void clear() {
+    for (llvm::DenseMap<FileID, FileIndex *>::iterator I = Files.begin(),
+                                                       E = Files.end();
+         I != E; ++I)
+      delete I->second;
+    Files.clear();
+  }
+
+  /// \brief Find the cursor at \p Loc, which must point at the beginning of
+  /// a token, as clang_getCursor() would.
+  ///
+  /// \returns false if the index can't answer this query, in which case the
+  /// caller should walk the AST as usual.
+  bool lookup(CXTranslationUnit TU, SourceLocation Loc, CXCursor &Result);
+};
+
+}
+
+enum CXChildVisitResult CursorExtentIndex::record(CXCursor Cursor,
+                                                  CXCursor Parent,
+                                                  CXClientData ClientData) {
+  Builder &B = *static_cast<Builder *>(ClientData);
+  FileIndex &Index = B.Index;
+
+  Node N;
+  N.Cursor = Cursor;
+  N.Parent = Parent;
+  N.Extent = getRawCursorExtent(Cursor);
+  N.Begin = N.End = 0;
+  N.HasOffsets = N.Extent.isValid() &&
+                 B.getOffset(N.Extent.getBegin(), /*IsEnd=*/false, N.Begin) &&
+                 B.getOffset(N.Extent.getEnd(), /*IsEnd=*/true, N.End) &&
+                 N.Begin <= N.End;
+  N.Children = ~0U;
+
+  // Add the node to the children of the node we're inside of, or to the
+  // top level.
+  unsigned ParentLevel = 0;
+  if (!B.Stack.empty()) {
+    Node &P = Index.Nodes[B.Stack.back()];
+    if (P.Children == ~0U) {
+      P.Children = Index.Levels.size();
+      Index.Levels.push_back(Level());
+    }
+    ParentLevel = P.Children;
+  }
+
+  unsigned NodeIndex = Index.Nodes.size();
+  Index.Nodes.push_back(N);
+  Level &L = Index.Levels[ParentLevel];
+  if (N.HasOffsets)
+    L.ByBegin.push_back(NodeIndex);
+  else
+    L.Unmapped.push_back(NodeIndex);
+
+  B.Stack.push_back(NodeIndex);
+  return CXChildVisit_Recurse;
+}
+
+bool CursorExtentIndex::recordEnd(CXCursor Cursor, CXClientData ClientData) {
+  Builder &B = *static_cast<Builder *>(ClientData);
+  B.Stack.pop_back();
+  return false;
+}
+
+namespace {
+  struct NodeBeginLess {
+    const std::vector<unsigned> *Begins;
+
+    bool operator()(unsigned X, unsigned Y) const {
+      if ((*Begins)[X] != (*Begins)[Y])
+        return (*Begins)[X] < (*Begins)[Y];
+      return X < Y;
+    }
+  };
+}
+
+CursorExtentIndex::FileIndex *
+CursorExtentIndex::getFileIndex(CXTranslationUnit TU, FileID File) {
+  FileIndex *&Index = Files[File];
+  if (Index)
+    return Index;
+
+  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  SourceManager &SM = CXXUnit->getSourceManager();
+
+  Index = new FileIndex();
+  Index->Levels.push_back(Level());
+  Builder B(SM, File, *Index);
+  SourceRange WholeFile(SM.getLocForStartOfFile(File),
+                        SM.getLocForEndOfFile(File));
+  CursorVisitor CursorVis(TU, record, &B,
+                          /*VisitPreprocessorLast=*/true,
+                          /*VisitIncludedEntities=*/false,
+                          WholeFile,
+                          /*VisitDeclsOnly=*/false,
+                          recordEnd);
+  CursorVis.visitFileRegion();
+
+  std::vector<unsigned> Begins(Index->Nodes.size());
+  for (unsigned I = 0, N = Index->Nodes.size(); I != N; ++I)
+    Begins[I] = Index->Nodes[I].Begin;
+  NodeBeginLess Less = { &Begins };
+
+  for (unsigned I = 0, N = Index->Levels.size(); I != N; ++I) {
+    Level &L = Index->Levels[I];
+    std::sort(L.ByBegin.begin(), L.ByBegin.end(), Less);
+    L.MaxEnd.resize(L.ByBegin.size());
+    unsigned MaxEnd = 0;
+    for (unsigned J = 0, M = L.ByBegin.size(); J != M; ++J) {
+      MaxEnd = std::max(MaxEnd, Index->Nodes[L.ByBegin[J]].End);
+      L.MaxEnd[J] = MaxEnd;
+    }
+  }
+
+  return Index;
+}
+
+void CursorExtentIndex::collectCandidates(const FileIndex &Index,
+                                          const Level &L, unsigned Offset,
+                                       SmallVectorImpl<unsigned> &Candidates) {
+  Candidates.append(L.Unmapped.begin(), L.Unmapped.end());
+
+  // Find the nodes that start at or before Offset, then walk back over them
+  // for as long as one of them might still end at or after it.
+  unsigned Lo = 0, Hi = L.ByBegin.size();
+  while (Lo < Hi) {
+    unsigned Mid = Lo + (Hi - Lo) / 2;
+    if (Index.Nodes[L.ByBegin[Mid]].Begin <= Offset)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  for (unsigned I = Lo; I != 0 && L.MaxEnd[I - 1] >= Offset; --I) {
+    unsigned NodeIndex = L.ByBegin[I - 1];
+    if (Index.Nodes[NodeIndex].End >= Offset)
+      Candidates.push_back(NodeIndex);
+  }
+
+  // Visit them in the order the cursor visitor would.
+  std::sort(Candidates.begin(), Candidates.end());
+}
+
+bool CursorExtentIndex::replay(const FileIndex &Index, unsigned LevelIndex,
+                               SourceManager &SM, SourceLocation Loc,
+                               unsigned Offset, GetCursorData &Data) {
+  SmallVector<unsigned, 8> Candidates;
+  collectCandidates(Index, Index.Levels[LevelIndex], Offset, Candidates);
+
+  for (unsigned I = 0, N = Candidates.size(); I != N; ++I) {
+    const Node &Nd = Index.Nodes[Candidates[I]];
+    // The offsets only narrow things down; this is the check the cursor
+    // visitor makes.
+    if (Nd.Extent.isInvalid() ||
+        RangeCompare(SM, Nd.Extent, SourceRange(Loc, Loc)) != RangeOverlap)
+      continue;
+
+    switch (GetCursorVisitor(Nd.Cursor, Nd.Parent, &Data)) {
+    case CXChildVisit_Break:
+      return true;
+    case CXChildVisit_Continue:
+      break;
+    case CXChildVisit_Recurse:
+      if (Nd.Children != ~0U &&
+          replay(Index, Nd.Children, SM, Loc, Offset, Data))
+        return true;
+      break;
+    }
+  }
+
+  return false;
+}
+
+bool CursorExtentIndex::lookup(CXTranslationUnit TU, SourceLocation Loc,
+                               CXCursor &Result) {
+  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  SourceManager &SM = CXXUnit->getSourceManager();
+
+  // Locations inside macro expansions, and Objective-C method cursors, whose
+  // selector index depends on the location being looked up, are left to the
+  // cursor visitor.
+  if (!Loc.isFileID() || CXXUnit->getLangOpts().ObjC1)
+    return false;
+
+  std::pair<FileID, unsigned> Decomposed = SM.getDecomposedLoc(Loc);
+  FileIndex *Index = getFileIndex(TU, Decomposed.first);
+
+  // Files without declarations of their own are handled by the cursor
+  // visitor, which looks at the file that includes them instead.
+  if (Index->Nodes.empty())
+    return false;
+
+  GetCursorData ResultData(SM, Loc, Result);
+  replay(*Index, 0, SM, Loc, Decomposed.second, ResultData);
+  return true;
+}
+
+static void createCursorExtentIndex(CXTranslationUnit TU) {
+  if (!TU->CursorExtentIndex)
+    TU->CursorExtentIndex = new CursorExtentIndex();
+}
+
+static void clearCursorExtentIndex(CXTranslationUnit TU) {
+  if (TU->CursorExtentIndex)
+    static_cast<CursorExtentIndex *>(TU->CursorExtentIndex)->clear();
+}
+
+static void disposeCursorExtentIndex(CXTranslationUnit TU) {
+  delete static_cast<CursorExtentIndex *>(TU->CursorExtentIndex);
+  TU->CursorExtentIndex = 0;
+}
+
 CXCursor cxcursor::getCursor(CXTranslationUnit TU, SourceLocation SLoc) {
   assert(TU);
 
@@ -4057,6 +4561,11 @@ CXCursor cxcursor::getCursor(CXTranslationUnit TU, SourceLocation SLoc) {
                                     CXXUnit->getASTContext().getLangOpts());
   
   CXCursor Result = MakeCXCursorInvalid(CXCursor_NoDeclFound);
+  if (SLoc.isValid() && TU->CursorExtentIndex &&
+      static_cast<CursorExtentIndex *>(TU->CursorExtentIndex)
+        ->lookup(TU, SLoc, Result))
+    return Result;
+
   if (SLoc.isValid()) {
     GetCursorData ResultData(CXXUnit->getSourceManager(), SLoc, Result);
     CursorVisitor CursorVis(TU, GetCursorVisitor, &ResultData,
@@ -4213,6 +4722,7 @@ static SourceRange getFullCursorExtent(CXCursor C, SourceManager &SrcMgr) {
 extern "C" {
 
 CXSourceRange clang_getCursorExtent(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   SourceRange R = getRawCursorExtent(C);
   if (R.isInvalid())
     return clang_getNullRange();
@@ -4221,6 +4731,7 @@ CXSourceRange clang_getCursorExtent(CXCursor C) {
 }
 
 CXCursor clang_getCursorReferenced(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (clang_isInvalid(C.kind))
     return clang_getNullCursor();
 
@@ -4331,6 +4842,7 @@ CXCursor clang_getCursorReferenced(CXCursor C) {
 }
 
 CXCursor clang_getCursorDefinition(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (clang_isInvalid(C.kind))
     return clang_getNullCursor();
 
@@ -4530,6 +5042,7 @@ unsigned clang_isCursorDefinition(CXCursor C) {
 }
 
 CXCursor clang_getCanonicalCursor(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return C;
   
@@ -4553,6 +5066,7 @@ int clang_Cursor_getObjCSelectorIndex(CXCursor cursor) {
 }
   
 unsigned clang_getNumOverloadedDecls(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (C.kind != CXCursor_OverloadedDeclRef)
     return 0;
   
@@ -4572,6 +5086,7 @@ unsigned clang_getNumOverloadedDecls(CXCursor C) {
 }
 
 CXCursor clang_getOverloadedDecl(CXCursor cursor, unsigned index) {
+  CXTULock Lock(getCursorTU(cursor));
   if (cursor.kind != CXCursor_OverloadedDeclRef)
     return clang_getNullCursor();
 
@@ -4605,6 +5120,7 @@ void clang_getDefinitionSpellingAndExtent(CXCursor C,
                                           unsigned *startColumn,
                                           unsigned *endLine,
                                           unsigned *endColumn) {
+  CXTULock Lock(getCursorTU(C));
   assert(getCursorDecl(C) && "CXCursor has null decl");
   NamedDecl *ND = static_cast<NamedDecl *>(getCursorDecl(C));
   FunctionDecl *FD = dyn_cast<FunctionDecl>(ND);
@@ -4622,6 +5138,7 @@ void clang_getDefinitionSpellingAndExtent(CXCursor C,
 
 CXSourceRange clang_getCursorReferenceNameRange(CXCursor C, unsigned NameFlags,
                                                 unsigned PieceIndex) {
+  CXTULock Lock(getCursorTU(C));
   RefNamePieces Pieces;
   
   switch (C.kind) {
@@ -4697,6 +5214,7 @@ CXTokenKind clang_getTokenKind(CXToken CXTok) {
 }
 
 CXString clang_getTokenSpelling(CXTranslationUnit TU, CXToken CXTok) {
+  CXTULock Lock(TU);
   switch (clang_getTokenKind(CXTok)) {
   case CXToken_Identifier:
   case CXToken_Keyword:
@@ -4717,7 +5235,7 @@ CXString clang_getTokenSpelling(CXTranslationUnit TU, CXToken CXTok) {
 
   // We have to find the starting buffer pointer the hard way, by
   // deconstructing the source location.
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  ASTUnit *CXXUnit = getASTUnit(TU);
   if (!CXXUnit)
     return createCXString("");
 
@@ -4734,7 +5252,8 @@ CXString clang_getTokenSpelling(CXTranslationUnit TU, CXToken CXTok) {
 }
 
 CXSourceLocation clang_getTokenLocation(CXTranslationUnit TU, CXToken CXTok) {
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  CXTULock Lock(TU);
+  ASTUnit *CXXUnit = getASTUnit(TU);
   if (!CXXUnit)
     return clang_getNullLocation();
 
@@ -4743,7 +5262,8 @@ CXSourceLocation clang_getTokenLocation(CXTranslationUnit TU, CXToken CXTok) {
 }
 
 CXSourceRange clang_getTokenExtent(CXTranslationUnit TU, CXToken CXTok) {
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  CXTULock Lock(TU);
+  ASTUnit *CXXUnit = getASTUnit(TU);
   if (!CXXUnit)
     return clang_getNullRange();
 
@@ -4825,12 +5345,13 @@ static void getTokens(ASTUnit *CXXUnit, SourceRange Range,
 
 void clang_tokenize(CXTranslationUnit TU, CXSourceRange Range,
                     CXToken **Tokens, unsigned *NumTokens) {
+  CXTULock Lock(TU);
   if (Tokens)
     *Tokens = 0;
   if (NumTokens)
     *NumTokens = 0;
 
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
+  ASTUnit *CXXUnit = getASTUnit(TU);
   if (!CXXUnit || !Tokens || !NumTokens)
     return;
 
@@ -5398,6 +5919,13 @@ static void clang_annotateTokensImpl(void *UserData) {
   const unsigned NumTokens = ((clang_annotateTokens_Data*)UserData)->NumTokens;
   CXCursor *Cursors = ((clang_annotateTokens_Data*)UserData)->Cursors;
 
+  // This may run on a crash recovery thread, while clang_annotateTokens()
+  // holds the lock.
+  CXTULockBorrow Borrow(TU);
+  if (!resumeIfSuspended(TU))
+    return;
+  ASTUnit::ConcurrencyCheck Check(*CXXUnit);
+
   CIndexer *CXXIdx = (CIndexer*)TU->CIdx;
   if (CXXIdx->isOptEnabled(CXGlobalOpt_ThreadBackgroundPriorityForEditing))
     setThreadBackgroundPriority();
@@ -5511,12 +6039,11 @@ void clang_annotateTokens(CXTranslationUnit TU,
   for (unsigned I = 0; I != NumTokens; ++I)
     Cursors[I] = C;
 
+  CXTULock Lock(TU);
   ASTUnit *CXXUnit = static_cast<ASTUnit *>(TU->TUData);
   if (!CXXUnit)
     return;
 
-  ASTUnit::ConcurrencyCheck Check(*CXXUnit);
-  
   clang_annotateTokens_Data data = { TU, CXXUnit, Tokens, NumTokens, Cursors };
   llvm::CrashRecoveryContext CRC;
   if (!RunSafely(CRC, clang_annotateTokensImpl, &data,
@@ -5533,6 +6060,7 @@ void clang_annotateTokens(CXTranslationUnit TU,
 
 extern "C" {
 CXLinkageKind clang_getCursorLinkage(CXCursor cursor) {
+  CXTULock Lock(getCursorTU(cursor));
   if (!clang_isDeclaration(cursor.kind))
     return CXLinkage_Invalid;
 
@@ -5605,6 +6133,7 @@ static CXLanguageKind getDeclLanguage(const Decl *D) {
 extern "C" {
   
 enum CXAvailabilityKind clang_getCursorAvailability(CXCursor cursor) {
+  CXTULock Lock(getCursorTU(cursor));
   if (clang_isDeclaration(cursor.kind))
     if (Decl *D = cxcursor::getCursorDecl(cursor)) {
       if (isa<FunctionDecl>(D) && cast<FunctionDecl>(D)->isDeleted())
@@ -5651,6 +6180,7 @@ int clang_getCursorPlatformAvailability(CXCursor cursor,
                                         CXString *unavailable_message,
                                         CXPlatformAvailability *availability,
                                         int availability_size) {
+  CXTULock Lock(getCursorTU(cursor));
   if (always_deprecated)
     *always_deprecated = 0;
   if (deprecated_message)
@@ -5736,6 +6266,7 @@ static Decl *maybeGetTemplateCursor(Decl *D) {
 }
 
 CXCursor clang_getCursorSemanticParent(CXCursor cursor) {
+  CXTULock Lock(getCursorTU(cursor));
   if (clang_isDeclaration(cursor.kind)) {
     if (Decl *D = getCursorDecl(cursor)) {
       DeclContext *DC = D->getDeclContext();
@@ -5756,6 +6287,7 @@ CXCursor clang_getCursorSemanticParent(CXCursor cursor) {
 }
 
 CXCursor clang_getCursorLexicalParent(CXCursor cursor) {
+  CXTULock Lock(getCursorTU(cursor));
   if (clang_isDeclaration(cursor.kind)) {
     if (Decl *D = getCursorDecl(cursor)) {
       DeclContext *DC = D->getLexicalDeclContext();
@@ -5781,6 +6313,7 @@ CXFile clang_getIncludedFile(CXCursor cursor) {
 }
 
 CXSourceRange clang_Cursor_getCommentRange(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return clang_getNullRange();
 
@@ -5794,6 +6327,7 @@ CXSourceRange clang_Cursor_getCommentRange(CXCursor C) {
 }
 
 CXString clang_Cursor_getRawCommentText(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return createCXString((const char *) NULL);
 
@@ -5809,6 +6343,7 @@ CXString clang_Cursor_getRawCommentText(CXCursor C) {
 }
 
 CXString clang_Cursor_getBriefCommentText(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return createCXString((const char *) NULL);
 
@@ -5828,6 +6363,7 @@ CXString clang_Cursor_getBriefCommentText(CXCursor C) {
 }
 
 CXComment clang_Cursor_getParsedComment(CXCursor C) {
+  CXTULock Lock(getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return cxcomment::createCXComment(NULL, NULL);
 
@@ -6001,6 +6537,7 @@ const char *clang_getTUResourceUsageName(CXTUResourceUsageKind kind) {
 }
 
 CXTUResourceUsage clang_getCXTUResourceUsage(CXTranslationUnit TU) {
+  CXTULock Lock(TU);
   if (!TU) {
     CXTUResourceUsage usage = { (void*) 0, 0, 0 };
     return usage;
@@ -6008,24 +6545,28 @@ CXTUResourceUsage clang_getCXTUResourceUsage(CXTranslationUnit TU) {
   
   ASTUnit *astUnit = static_cast<ASTUnit*>(TU->TUData);
   OwningPtr<MemUsageEntries> entries(new MemUsageEntries());
-  ASTContext &astContext = astUnit->getASTContext();
-  
-  // How much memory is used by AST nodes and types?
-  createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_AST,
-    (unsigned long) astContext.getASTAllocatedMemory());
 
-  // How much memory is used by identifiers?
-  createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_Identifiers,
-    (unsigned long) astContext.Idents.getAllocator().getTotalMemory());
+  // A suspended translation unit has no AST or preprocessor to report on.
+  if (!astUnit->isSuspended()) {
+    ASTContext &astContext = astUnit->getASTContext();
 
-  // How much memory is used for selectors?
-  createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_Selectors,
-    (unsigned long) astContext.Selectors.getTotalMemory());
-  
-  // How much memory is used by ASTContext's side tables?
-  createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_AST_SideTables,
-    (unsigned long) astContext.getSideTableAllocatedMemory());
+    // How much memory is used by AST nodes and types?
+    createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_AST,
+      (unsigned long) astContext.getASTAllocatedMemory());
+
+    // How much memory is used by identifiers?
+    createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_Identifiers,
+      (unsigned long) astContext.Idents.getAllocator().getTotalMemory());
+
+    // How much memory is used for selectors?
+    createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_Selectors,
+      (unsigned long) astContext.Selectors.getTotalMemory());
   
+    // How much memory is used by ASTContext's side tables?
+    createCXTUResourceUsageEntry(*entries, CXTUResourceUsage_AST_SideTables,
+      (unsigned long) astContext.getSideTableAllocatedMemory());
+  }
+
   // How much memory is used for caching global code completion results?
   unsigned long completionBytes = 0;
   if (GlobalCodeCompletionAllocator *completionAllocator =
@@ -6039,7 +6580,7 @@ CXTUResourceUsage clang_getCXTUResourceUsage(CXTranslationUnit TU) {
   // How much memory is being used by SourceManager's content cache?
   createCXTUResourceUsageEntry(*entries,
           CXTUResourceUsage_SourceManagerContentCache,
-          (unsigned long) astContext.getSourceManager().getContentCacheSize());
+          (unsigned long) astUnit->getSourceManager().getContentCacheSize());
   
   // How much memory is being used by the MemoryBuffer's in SourceManager?
   const SourceManager::MemoryBufferSizes &srcBufs =
@@ -6053,38 +6594,41 @@ CXTUResourceUsage clang_getCXTUResourceUsage(CXTranslationUnit TU) {
                                (unsigned long) srcBufs.mmap_bytes);
   createCXTUResourceUsageEntry(*entries,
                                CXTUResourceUsage_SourceManager_DataStructures,
-                               (unsigned long) astContext.getSourceManager()
+                               (unsigned long) astUnit->getSourceManager()
                                 .getDataStructureSizes());
-  
-  // How much memory is being used by the ExternalASTSource?
-  if (ExternalASTSource *esrc = astContext.getExternalSource()) {
-    const ExternalASTSource::MemoryBufferSizes &sizes =
-      esrc->getMemoryBufferSizes();
+
+  if (!astUnit->isSuspended()) {
+    // How much memory is being used by the ExternalASTSource?
+    ASTContext &astContext = astUnit->getASTContext();
+    if (ExternalASTSource *esrc = astContext.getExternalSource()) {
+      const ExternalASTSource::MemoryBufferSizes &sizes =
+        esrc->getMemoryBufferSizes();
     
+      createCXTUResourceUsageEntry(*entries,
+        CXTUResourceUsage_ExternalASTSource_Membuffer_Malloc,
+                                   (unsigned long) sizes.malloc_bytes);
+      createCXTUResourceUsageEntry(*entries,
+        CXTUResourceUsage_ExternalASTSource_Membuffer_MMap,
+                                   (unsigned long) sizes.mmap_bytes);
+    }
+  
+    // How much memory is being used by the Preprocessor?
+    Preprocessor &pp = astUnit->getPreprocessor();
     createCXTUResourceUsageEntry(*entries,
-      CXTUResourceUsage_ExternalASTSource_Membuffer_Malloc,
-                                 (unsigned long) sizes.malloc_bytes);
-    createCXTUResourceUsageEntry(*entries,
-      CXTUResourceUsage_ExternalASTSource_Membuffer_MMap,
-                                 (unsigned long) sizes.mmap_bytes);
-  }
+                                 CXTUResourceUsage_Preprocessor,
+                                 pp.getTotalMemory());
   
-  // How much memory is being used by the Preprocessor?
-  Preprocessor &pp = astUnit->getPreprocessor();
-  createCXTUResourceUsageEntry(*entries,
-                               CXTUResourceUsage_Preprocessor,
-                               pp.getTotalMemory());
+    if (PreprocessingRecord *pRec = pp.getPreprocessingRecord()) {
+      createCXTUResourceUsageEntry(*entries,
+                                   CXTUResourceUsage_PreprocessingRecord,
+                                   pRec->getTotalMemory());    
+    }
   
-  if (PreprocessingRecord *pRec = pp.getPreprocessingRecord()) {
     createCXTUResourceUsageEntry(*entries,
-                                 CXTUResourceUsage_PreprocessingRecord,
-                                 pRec->getTotalMemory());    
+                                 CXTUResourceUsage_Preprocessor_HeaderSearch,
+                                 pp.getHeaderSearchInfo().getTotalMemory());
   }
-  
-  createCXTUResourceUsageEntry(*entries,
-                               CXTUResourceUsage_Preprocessor_HeaderSearch,
-                               pp.getHeaderSearchInfo().getTotalMemory());
-  
+
   CXTUResourceUsage usage = { (void*) entries.get(),
                             (unsigned) entries->size(),
                             entries->size() ? &(*entries)[0] : 0 };
@@ -35,6 +35,7 @@
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 
@@ -297,6 +298,17 @@ struct AllocatedCXCodeCompleteResults : public CXCodeCompleteResults {
   /// \brief A string containing the Objective-C selector entered thus far for a
   /// message send.
   std::string Selector;
+
+  /// \brief Whether the results have been narrowed down by
+  /// \c clang_codeCompleteFilterResults().
+  bool IsFiltered;
+
+  /// \brief The complete set of results, saved the first time they are
+  /// filtered so that a later filter can widen them again.
+  std::vector<CXCompletionResult> UnfilteredResults;
+
+  /// \brief The filter that was last applied to the results.
+  std::string Filter;
 };
 
 } // end anonymous namespace
@@ -321,7 +333,8 @@ AllocatedCXCodeCompleteResults::AllocatedCXCodeCompleteResults(
     Contexts(CXCompletionContext_Unknown),
     ContainerKind(CXCursor_InvalidCode),
     ContainerUSR(createCXString("")),
-    ContainerIsIncomplete(1)
+    ContainerIsIncomplete(1),
+    IsFiltered(false)
 { 
   if (getenv("LIBCLANG_OBJTRACKING")) {
     llvm::sys::AtomicIncrement(&CodeCompletionResultObjects);
@@ -665,6 +678,8 @@ struct CodeCompleteAtInfo {
   struct CXUnsavedFile *unsaved_files;
   unsigned num_unsaved_files;
   unsigned options;
+  const char *typed_prefix;
+  unsigned max_results;
   CXCodeCompleteResults *result;
 };
 void clang_codeCompleteAt_Impl(void *UserData) {
@@ -687,6 +702,9 @@ void clang_codeCompleteAt_Impl(void *UserData) {
 
   bool EnableLogging = getenv("LIBCLANG_CODE_COMPLETION_LOGGING") != 0;
   
+  // Code completion reparses the main file, so it needs the translation unit
+  // to itself; clang_codeCompleteAtWithPrefix() holds the lock for us.
+  cxtu::CXTULockBorrow Borrow(TU);
   ASTUnit *AST = static_cast<ASTUnit *>(TU->TUData);
   if (!AST)
     return;
@@ -720,6 +738,9 @@ void clang_codeCompleteAt_Impl(void *UserData) {
   // Create a code-completion consumer to capture the results.
   CodeCompleteOptions Opts;
   Opts.IncludeBriefComments = IncludeBriefComments;
+  if (CCAI->typed_prefix)
+    Opts.TypedPrefix = CCAI->typed_prefix;
+  Opts.MaxResults = CCAI->max_results;
   CaptureCompletionResults Capture(Opts, *Results, &TU);
 
   // Perform completion.
@@ -822,9 +843,25 @@ CXCodeCompleteResults *clang_codeCompleteAt(CXTranslationUnit TU,
                                             struct CXUnsavedFile *unsaved_files,
                                             unsigned num_unsaved_files,
                                             unsigned options) {
+  return clang_codeCompleteAtWithPrefix(TU, complete_filename, complete_line,
+                                        complete_column, unsaved_files,
+                                        num_unsaved_files, options, 0, 0);
+}
+
+CXCodeCompleteResults *
+clang_codeCompleteAtWithPrefix(CXTranslationUnit TU,
+                               const char *complete_filename,
+                               unsigned complete_line,
+                               unsigned complete_column,
+                               struct CXUnsavedFile *unsaved_files,
+                               unsigned num_unsaved_files,
+                               unsigned options,
+                               const char *typed_prefix,
+                               unsigned max_results) {
   CodeCompleteAtInfo CCAI = { TU, complete_filename, complete_line,
                               complete_column, unsaved_files, num_unsaved_files,
-                              options, 0 };
+                              options, typed_prefix, max_results, 0 };
+  cxtu::CXTULock Lock(TU);
   llvm::CrashRecoveryContext CRC;
 
   if (!RunSafely(CRC, clang_codeCompleteAt_Impl, &CCAI)) {
@@ -995,3 +1032,121 @@ extern "C" {
     std::stable_sort(Results, Results + NumResults, OrderCompletionResults());
   }
 }
+
+/// \brief Determine how well the typed-text of a completion matches the text
+/// typed so far.
+///
+/// Each character of \p Filter has to appear in \p Name, in order but
+/// ignoring case. Characters are worth more when they match case exactly,
+/// follow the previous match directly, or start a word in \p Name: its
+/// first character, one after an underscore, or an uppercase letter after a
+/// lowercase one. A name that starts with the filter gets an extra bonus.
+///
+/// \returns the score, or zero if \p Name doesn't match \p Filter at all.
+static unsigned scoreCompletionFilterMatch(StringRef Name, StringRef Filter) {
+  if (Filter.empty())
+    return 1;
+
+  unsigned Score = 1;
+  unsigned Matched = 0;
+  bool PrevMatched = false;
+  for (unsigned I = 0, N = Name.size(); I != N && Matched != Filter.size();
+       ++I) {
+    char C = Name[I];
+    if (tolower((unsigned char)C) != tolower((unsigned char)Filter[Matched])) {
+      PrevMatched = false;
+      continue;
+    }
+
+    Score += 1;
+    if (C == Filter[Matched])
+      Score += 1;
+    if (PrevMatched)
+      Score += 2;
+    if (I == 0 || Name[I-1] == '_' ||
+        (islower((unsigned char)Name[I-1]) && isupper((unsigned char)C)))
+      Score += 3;
+    PrevMatched = true;
+    ++Matched;
+  }
+
+  if (Matched != Filter.size())
+    return 0;
+
+  if (Name.size() >= Filter.size() &&
+      Name.substr(0, Filter.size()).equals_lower(Filter))
+    Score += 2 * Filter.size();
+  return Score;
+}
+
+namespace {
+  struct ScoredCompletionResult {
+    CXCompletionResult Result;
+    unsigned Score;
+    unsigned Priority;
+  };
+
+  /// \brief Orders the best match first, then by completion priority.
+  struct OrderScoredCompletionResults {
+    bool operator()(const ScoredCompletionResult &X,
+                    const ScoredCompletionResult &Y) const {
+      if (X.Score != Y.Score)
+        return X.Score > Y.Score;
+      return X.Priority < Y.Priority;
+    }
+  };
+}
+
+extern "C" {
+  unsigned clang_codeCompleteFilterResults(CXCodeCompleteResults *ResultsIn,
+                                           const char *Filter) {
+    AllocatedCXCodeCompleteResults *Results
+      = static_cast<AllocatedCXCodeCompleteResults *>(ResultsIn);
+    if (!Results)
+      return 0;
+
+    StringRef NewFilter = Filter ? Filter : "";
+    if (!Results->IsFiltered) {
+      Results->UnfilteredResults.assign(Results->Results,
+                                        Results->Results + Results->NumResults);
+      Results->IsFiltered = true;
+    }
+
+    // Anything that matches a longer filter also matched the filter it
+    // extends, so in that case only the current results need rescoring.
+    const CXCompletionResult *Begin = Results->Results;
+    const CXCompletionResult *End = Results->Results + Results->NumResults;
+    if (!NewFilter.startswith(Results->Filter)) {
+      Begin = End = 0;
+      if (!Results->UnfilteredResults.empty()) {
+        Begin = &Results->UnfilteredResults[0];
+        End = Begin + Results->UnfilteredResults.size();
+      }
+    }
+
+    SmallVector<ScoredCompletionResult, 64> Matches;
+    SmallString<256> Buffer;
+    for (const CXCompletionResult *R = Begin; R != End; ++R) {
+      CodeCompletionString *String
+        = static_cast<CodeCompletionString *>(R->CompletionString);
+      Buffer.clear();
+      unsigned Score
+        = scoreCompletionFilterMatch(GetTypedName(String, Buffer), NewFilter);
+      if (!Score)
+        continue;
+
+      ScoredCompletionResult Match = { *R, Score, String->getPriority() };
+      Matches.push_back(Match);
+    }
+    std::stable_sort(Matches.begin(), Matches.end(),
+                     OrderScoredCompletionResults());
+
+    // The matches never outnumber the original results, so they fit in the
+    // array that holds them.
+    for (unsigned I = 0, N = Matches.size(); I != N; ++I)
+      Results->Results[I] = Matches[I].Result;
+    Results->NumResults = Matches.size();
+    Results->Filter = NewFilter;
+    return Results->NumResults;
+  }
+}
@@ -364,6 +364,7 @@ void clang_findReferencesInFile(CXCursor cursor, CXFile file,
     return;
   }
 
+  cxtu::CXTULock Lock(cxcursor::getCursorTU(cursor));
   ASTUnit *CXXUnit = cxcursor::getCursorASTUnit(cursor);
   if (!CXXUnit)
     return;
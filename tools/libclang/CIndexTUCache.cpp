@@ -0,0 +1,225 @@
+//===- CIndexTUCache.cpp - On-disk cache of serialized translation units --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the cache of serialized translation units used by
+// clang_parseTranslationUnit when a cache directory has been set with
+// clang_CXIndex_setTranslationUnitCacheDirectory.
+//
+// Each entry consists of two files named after a hash of the cache key: the
+// serialized AST ("<hash>.ast") and a manifest ("<hash>.inputs") holding the
+// full cache key and, for every file the translation unit read, its size and
+// a hash of its contents. An entry is only used if the key matches and every
+// input file still has the same contents.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CIndexer.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+/// \brief A 64-bit FNV-1a hash. Unlike llvm::hash_value, it is guaranteed to
+/// be the same in every process, which the cache relies on.
+static uint64_t hashBytes(StringRef Data) {
+  uint64_t Hash = 14695981039346656037ULL;
+  for (unsigned I = 0, N = Data.size(); I != N; ++I) {
+    Hash ^= static_cast<unsigned char>(Data[I]);
+    Hash *= 1099511628211ULL;
+  }
+  return Hash;
+}
+
+/// \brief Compute the key for a translation unit parsed with the given
+/// arguments and options, or an empty string if it should not be cached.
+static std::string getCacheKey(ArrayRef<const char *> Args, unsigned Options) {
+  // Relative paths in the arguments depend on the working directory.
+  SmallString<256> CWD;
+  if (llvm::sys::fs::current_path(CWD))
+    return std::string();
+
+  std::string Key;
+  llvm::raw_string_ostream OS(Key);
+  OS << getClangFullVersion() << '\n' << CWD.str() << '\n' << Options << '\n';
+  for (unsigned I = 0, N = Args.size(); I != N; ++I)
+    OS << Args[I] << '\0';
+  return OS.str();
+}
+
+static void getCachePaths(StringRef Dir, StringRef Key,
+                          SmallVectorImpl<char> &ASTPath,
+                          SmallVectorImpl<char> &ManifestPath) {
+  std::string Name = llvm::utohexstr(hashBytes(Key));
+  ASTPath.clear();
+  ASTPath.append(Dir.begin(), Dir.end());
+  llvm::sys::path::append(ASTPath, Name + ".ast");
+  ManifestPath.clear();
+  ManifestPath.append(Dir.begin(), Dir.end());
+  llvm::sys::path::append(ManifestPath, Name + ".inputs");
+}
+
+/// \brief Determine whether the file at \p Path still has the given size and
+/// contents hash.
+static bool isInputUnchanged(StringRef Path, uint64_t Size, uint64_t Hash) {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::MemoryBuffer::getFile(Path, Buffer))
+    return false;
+  return Buffer->getBufferSize() == Size &&
+         hashBytes(Buffer->getBuffer()) == Hash;
+}
+
+/// \brief Check the manifest of a cache entry against the key and the input
+/// files on disk.
+static bool isManifestValid(StringRef Manifest, StringRef Key) {
+  // The manifest starts with "key <length>\n<key>\n".
+  if (!Manifest.startswith("key "))
+    return false;
+  Manifest = Manifest.substr(4);
+  std::pair<StringRef, StringRef> LengthAndRest = Manifest.split('\n');
+  unsigned KeyLength;
+  if (LengthAndRest.first.getAsInteger(10, KeyLength) ||
+      KeyLength != Key.size())
+    return false;
+  Manifest = LengthAndRest.second;
+  if (!Manifest.startswith(Key) || Manifest.substr(KeyLength, 1) != "\n")
+    return false;
+  Manifest = Manifest.substr(KeyLength + 1);
+
+  // Then comes one "<hash> <size> <path>" line per input file.
+  while (!Manifest.empty()) {
+    std::pair<StringRef, StringRef> LineAndRest = Manifest.split('\n');
+    StringRef Line = LineAndRest.first;
+    Manifest = LineAndRest.second;
+
+    std::pair<StringRef, StringRef> HashAndRest = Line.split(' ');
+    std::pair<StringRef, StringRef> SizeAndPath = HashAndRest.second.split(' ');
+    uint64_t Hash, Size;
+    if (HashAndRest.first.getAsInteger(16, Hash) ||
+        SizeAndPath.first.getAsInteger(10, Size) ||
+        SizeAndPath.second.empty())
+      return false;
+
+    if (!isInputUnchanged(SizeAndPath.second, Size, Hash))
+      return false;
+  }
+
+  return true;
+}
+
+ASTUnit *clang::loadCachedTranslationUnit(CIndexer &CXXIdx,
+                                          ArrayRef<const char *> Args,
+                                          unsigned Options,
+                                  IntrusiveRefCntPtr<DiagnosticsEngine> Diags) {
+  StringRef Dir = CXXIdx.getTranslationUnitCacheDirectory();
+  if (Dir.empty())
+    return 0;
+
+  std::string Key = getCacheKey(Args, Options);
+  if (Key.empty())
+    return 0;
+
+  SmallString<256> ASTPath, ManifestPath;
+  getCachePaths(Dir, Key, ASTPath, ManifestPath);
+
+  OwningPtr<llvm::MemoryBuffer> Manifest;
+  if (llvm::MemoryBuffer::getFile(ManifestPath.str(), Manifest) ||
+      !isManifestValid(Manifest->getBuffer(), Key))
+    return 0;
+
+  // Declarations are deserialized lazily, as they are needed.
+  return ASTUnit::LoadFromASTFile(ASTPath.str(), Diags, FileSystemOptions(),
+                                  CXXIdx.getOnlyLocalDecls(),
+                                  0, 0,
+                                  /*CaptureDiagnostics=*/true,
+                                  /*AllowPCHWithCompilerErrors=*/false,
+                                  /*UserFilesAreVolatile=*/true);
+}
+
+/// \brief Write \p Contents to \p Path through a temporary file, so that
+/// readers never see a partially-written file.
+static bool writeFileAtomically(StringRef Path, StringRef Contents) {
+  SmallString<256> TempPath;
+  TempPath = Path;
+  TempPath += "-%%%%%%%%";
+  int FD;
+  if (llvm::sys::fs::unique_file(TempPath.str(), FD, TempPath,
+                                 /*makeAbsolute=*/false))
+    return true;
+
+  llvm::raw_fd_ostream Out(FD, /*shouldClose=*/true);
+  Out << Contents;
+  Out.close();
+  bool Failed = Out.has_error();
+  Out.clear_error();
+  if (Failed || llvm::sys::fs::rename(TempPath.str(), Path)) {
+    bool Existed;
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+    return true;
+  }
+  return false;
+}
+
+void clang::cacheTranslationUnit(CIndexer &CXXIdx,
+                                 ArrayRef<const char *> Args,
+                                 unsigned Options,
+                                 ASTUnit &Unit) {
+  StringRef Dir = CXXIdx.getTranslationUnitCacheDirectory();
+  if (Dir.empty())
+    return;
+
+  // A serialized translation unit does not carry the diagnostics produced
+  // while parsing it, so only cache translation units that had none.
+  if (Unit.stored_diag_size() != 0 ||
+      Unit.getDiagnostics().hasErrorOccurred())
+    return;
+
+  std::string Key = getCacheKey(Args, Options);
+  if (Key.empty())
+    return;
+
+  // Record the contents of every file the translation unit read.
+  std::string Manifest;
+  llvm::raw_string_ostream OS(Manifest);
+  OS << "key " << Key.size() << '\n' << Key << '\n';
+  SourceManager &SM = Unit.getSourceManager();
+  for (SourceManager::fileinfo_iterator I = SM.fileinfo_begin(),
+                                        E = SM.fileinfo_end();
+       I != E; ++I) {
+    StringRef Name = I->first->getName();
+    if (Name.find('\n') != StringRef::npos)
+      return;
+
+    OwningPtr<llvm::MemoryBuffer> Buffer;
+    if (llvm::MemoryBuffer::getFile(Name, Buffer))
+      return;
+    OS << llvm::utohexstr(hashBytes(Buffer->getBuffer())) << ' '
+       << Buffer->getBufferSize() << ' ' << Name << '\n';
+  }
+  OS.flush();
+
+  bool Existed;
+  if (llvm::sys::fs::create_directories(Dir, Existed))
+    return;
+
+  SmallString<256> ASTPath, ManifestPath;
+  getCachePaths(Dir, Key, ASTPath, ManifestPath);
+
+  // Write the AST before the manifest that makes it usable.
+  if (Unit.Save(ASTPath.str()))
+    return;
+  writeFileAtomically(ManifestPath.str(), Manifest);
+}
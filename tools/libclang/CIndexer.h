@@ -16,8 +16,11 @@
 #define LLVM_CLANG_CINDEXER_H
 
 #include "clang-c/Index.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Path.h"
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -26,6 +29,7 @@ namespace llvm {
 
 namespace clang {
   class ASTUnit;
+  class DiagnosticsEngine;
 
 class CIndexer {
   bool OnlyLocalDecls;
@@ -33,6 +37,7 @@ class CIndexer {
   unsigned Options; // CXGlobalOptFlags.
 
   llvm::sys::Path ResourcesPath;
+  std::string TranslationUnitCacheDirectory;
 
 public:
  CIndexer() : OnlyLocalDecls(false), DisplayDiagnostics(false),
@@ -58,8 +63,33 @@ public:
 
   /// \brief Get the path of the clang resource files.
   std::string getClangResourcesPath();
+
+  /// \brief The directory in which parsed translation units are cached, or
+  /// an empty string if they aren't.
+  llvm::StringRef getTranslationUnitCacheDirectory() const {
+    return TranslationUnitCacheDirectory;
+  }
+  void setTranslationUnitCacheDirectory(llvm::StringRef Dir) {
+    TranslationUnitCacheDirectory = Dir.str();
+  }
 };
 
+  /// \brief Load a translation unit parsed with the given arguments and
+  /// options from the translation unit cache, if it is there and none of the
+  /// files it was built from have changed.
+  ///
+  /// \returns the translation unit, or null if it could not be loaded.
+  ASTUnit *loadCachedTranslationUnit(CIndexer &CXXIdx,
+                                     llvm::ArrayRef<const char *> Args,
+                                     unsigned Options,
+                           llvm::IntrusiveRefCntPtr<DiagnosticsEngine> Diags);
+
+  /// \brief Save a translation unit parsed with the given arguments and
+  /// options to the translation unit cache.
+  void cacheTranslationUnit(CIndexer &CXXIdx,
+                            llvm::ArrayRef<const char *> Args,
+                            unsigned Options, ASTUnit &Unit);
+
   /**
    * \brief Given a set of "unsaved" files, create temporary files and 
    * construct the clang -cc1 argument list needed to perform the remapping.
@@ -1016,6 +1016,7 @@ unsigned clang_CXCursorSet_insert(CXCursorSet set, CXCursor cursor) {
 }
   
 CXCompletionString clang_getCursorCompletionString(CXCursor cursor) {
+  cxtu::CXTULock Lock(getCursorTU(cursor));
   enum CXCursorKind kind = clang_getCursorKind(cursor);
   if (clang_isDeclaration(kind)) {
     Decl *decl = getCursorDecl(cursor);
@@ -1087,7 +1088,8 @@ void clang_getOverriddenCursors(CXCursor cursor,
 
   if (!clang_isDeclaration(cursor.kind))
     return;
-    
+
+  cxtu::CXTULock Lock(TU);
   OverridenCursorsPool &pool =
     *static_cast<OverridenCursorsPool*>(TU->OverridenCursorsPool);
   
@@ -1142,6 +1144,7 @@ void clang_disposeOverriddenCursors(CXCursor *overridden) {
   
   assert(Vec && TU);
 
+  cxtu::CXTULock Lock(TU);
   OverridenCursorsPool &pool =
     *static_cast<OverridenCursorsPool*>(TU->OverridenCursorsPool);
   
@@ -123,9 +123,13 @@ CXSourceLocation clang_getLocation(CXTranslationUnit tu,
     return clang_getNullLocation();
   
   bool Logging = ::getenv("LIBCLANG_LOGGING");
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(tu->TUData);
-  ASTUnit::ConcurrencyCheck Check(*CXXUnit);
+  cxtu::CXTULock Lock(tu);
   const FileEntry *File = static_cast<const FileEntry *>(file);
+  ASTUnit *CXXUnit = cxtu::getASTUnit(tu, File);
+  if (!CXXUnit || !File)
+    return clang_getNullLocation();
+
+  ASTUnit::ConcurrencyCheck Check(*CXXUnit);
   SourceLocation SLoc = CXXUnit->getLocation(File, line, column);
   if (SLoc.isInvalid()) {
     if (Logging)
@@ -148,10 +152,13 @@ CXSourceLocation clang_getLocationForOffset(CXTranslationUnit tu,
   if (!tu || !file)
     return clang_getNullLocation();
   
-  ASTUnit *CXXUnit = static_cast<ASTUnit *>(tu->TUData);
+  cxtu::CXTULock Lock(tu);
+  const FileEntry *File = static_cast<const FileEntry *>(file);
+  ASTUnit *CXXUnit = cxtu::getASTUnit(tu, File);
+  if (!CXXUnit || !File)
+    return clang_getNullLocation();
 
-  SourceLocation SLoc 
-    = CXXUnit->getLocation(static_cast<const FileEntry *>(file), offset);
+  SourceLocation SLoc = CXXUnit->getLocation(File, offset);
 
   if (SLoc.isInvalid())
     return clang_getNullLocation();
@@ -214,6 +221,7 @@ void clang_getExpansionLocation(CXSourceLocation location,
 
   const SourceManager &SM =
   *static_cast<const SourceManager*>(location.ptr_data[0]);
+  cxtu::CXTULock Lock(&SM);
   SourceLocation ExpansionLoc = SM.getExpansionLoc(Loc);
   
   // Check that the FileID is invalid on the expansion location.
@@ -255,6 +263,7 @@ void clang_getPresumedLocation(CXSourceLocation location,
   else {
     const SourceManager &SM =
     *static_cast<const SourceManager*>(location.ptr_data[0]);
+    cxtu::CXTULock Lock(&SM);
     PresumedLoc PreLoc = SM.getPresumedLoc(Loc);
     
     if (filename)
@@ -294,6 +303,7 @@ void clang_getSpellingLocation(CXSourceLocation location,
   
   const SourceManager &SM =
   *static_cast<const SourceManager*>(location.ptr_data[0]);
+  cxtu::CXTULock Lock(&SM);
   SourceLocation SpellLoc = SM.getFileLoc(Loc);
   std::pair<FileID, unsigned> LocInfo = SM.getDecomposedLoc(SpellLoc);
   FileID FID = LocInfo.first;
@@ -87,6 +87,7 @@ void cxstring::disposeCXStringPool(void *p) {
 }
 
 CXStringBuf *cxstring::getCXStringBuf(CXTranslationUnit TU) {
+  cxtu::CXTULock Lock(TU);
   CXStringPool *pool = static_cast<CXStringPool*>(TU->StringPool);
   if (pool->empty())
     return new CXStringBuf(TU);
@@ -97,8 +98,13 @@ CXStringBuf *cxstring::getCXStringBuf(CXTranslationUnit TU) {
 }
 
 void cxstring::disposeCXStringBuf(CXStringBuf *buf) {
-  if (buf)
-    static_cast<CXStringPool*>(buf->TU->StringPool)->push_back(buf);
+  if (!buf)
+    return;
+
+  // Strings may be disposed of on any thread, so the pool is guarded by the
+  // lock of its translation unit.
+  cxtu::CXTULock Lock(buf->TU);
+  static_cast<CXStringPool*>(buf->TU->StringPool)->push_back(buf);
 }
 
 bool cxstring::isManagedByPool(CXString str) {
@@ -14,6 +14,9 @@
 #ifndef LLVM_CLANG_CXTRANSLATIONUNIT_H
 #define LLVM_CLANG_CXTRANSLATIONUNIT_H
 
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Mutex.h"
+
 extern "C" {
 struct CXTranslationUnitImpl {
   void *CIdx;
@@ -23,16 +26,90 @@ struct CXTranslationUnitImpl {
   void *OverridenCursorsPool;
   void *FormatContext;
   unsigned FormatInMemoryUniqueId;
+  void *CursorExtentIndex;
+  void *AccessMutex;
 };
 }
 
 namespace clang {
   class ASTUnit;
   class CIndexer;
+  class FileEntry;
+  class SourceManager;
 
 namespace cxtu {
 
 CXTranslationUnitImpl *MakeCXTranslationUnit(CIndexer *CIdx, ASTUnit *TU);
+
+/// \brief Rebuild the AST of a translation unit that was suspended with
+/// \c clang_suspendTranslationUnit(), so that it can be queried again.
+///
+/// \returns false if \p TU has no AST to query, e.g. because its main file
+/// could not be read any more; it then stays suspended.
+bool resumeIfSuspended(CXTranslationUnitImpl *TU);
+
+/// \brief Retrieve the AST of \p TU, resuming it first if it was suspended.
+///
+/// Every entry point that needs the AST context, the preprocessor or Sema
+/// goes through this rather than reading \c TUData directly. Returns null if
+/// \p TU could not be resumed.
+ASTUnit *getASTUnit(CXTranslationUnitImpl *TU);
+
+/// \brief Like \c getASTUnit(), for entry points that also receive a file.
+///
+/// Resuming replaces the file manager, so a \p File handed out before \p TU
+/// was suspended is looked up again by name in the new one.
+ASTUnit *getASTUnit(CXTranslationUnitImpl *TU, const FileEntry *&File);
+
+/// \brief Holds the lock of a translation unit for as long as it lives.
+///
+/// Querying an AST is not free of side effects: declarations are
+/// deserialized from the preamble on demand, types are uniqued as they are
+/// formed, and the source manager fills in its line tables and lookup caches
+/// lazily. So every entry point that touches a translation unit holds its
+/// lock, including the queries, and reparsing, saving and suspending hold it
+/// for the whole operation. The lock is recursive, so entry points may call
+/// each other and clients may call back into libclang from a visitor.
+/// Translation units do not share a lock, so they can be used in parallel.
+///
+/// Entry points that do their work on a crash-recovery thread take the lock
+/// on the calling thread, before starting that thread, and lend it to the
+/// new thread with a \c CXTULockBorrow.
+class CXTULock {
+  llvm::sys::Mutex *M;
+
+  CXTULock(const CXTULock &) LLVM_DELETED_FUNCTION;
+  void operator=(const CXTULock &) LLVM_DELETED_FUNCTION;
+
+public:
+  /// \brief Lock \p TU, if it is not null.
+  explicit CXTULock(CXTranslationUnitImpl *TU);
+
+  /// \brief Lock the translation unit whose current source manager is
+  /// \p SM, if there is one. This is how the functions that only receive a
+  /// CXSourceLocation or CXSourceRange find their lock.
+  explicit CXTULock(const SourceManager *SM);
+
+  ~CXTULock();
+};
+
+/// \brief Lets the current thread use a translation unit whose lock is held
+/// by the thread waiting for it to finish.
+///
+/// While it lives, \c CXTULock does not wait for the lock of \p TU on this
+/// thread, so that indexer callbacks and other calls the work makes back into
+/// libclang do not deadlock. The owner of the lock is blocked until the work
+/// is done, so the translation unit is still used by one thread at a time.
+class CXTULockBorrow {
+  llvm::sys::Mutex *Prev;
+
+  CXTULockBorrow(const CXTULockBorrow &) LLVM_DELETED_FUNCTION;
+  void operator=(const CXTULockBorrow &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit CXTULockBorrow(CXTranslationUnitImpl *TU);
+  ~CXTULockBorrow();
+};
   
 class CXTUOwner {
   CXTranslationUnitImpl *TU;
@@ -128,6 +128,7 @@ static inline CXTranslationUnit GetTU(CXType CT) {
 extern "C" {
 
 CXType clang_getCursorType(CXCursor C) {
+  cxtu::CXTULock Lock(cxcursor::getCursorTU(C));
   using namespace cxcursor;
   
   CXTranslationUnit TU = cxcursor::getCursorTU(C);
@@ -198,6 +199,7 @@ CXType clang_getCursorType(CXCursor C) {
 }
 
 CXType clang_getTypedefDeclUnderlyingType(CXCursor C) {
+  cxtu::CXTULock Lock(cxcursor::getCursorTU(C));
   using namespace cxcursor;
   CXTranslationUnit TU = cxcursor::getCursorTU(C);
 
@@ -216,6 +218,7 @@ CXType clang_getTypedefDeclUnderlyingType(CXCursor C) {
 }
 
 CXType clang_getEnumDeclIntegerType(CXCursor C) {
+  cxtu::CXTULock Lock(cxcursor::getCursorTU(C));
   using namespace cxcursor;
   CXTranslationUnit TU = cxcursor::getCursorTU(C);
 
@@ -281,6 +284,7 @@ int clang_getFieldDeclBitWidth(CXCursor C) {
 }
 
 CXType clang_getCanonicalType(CXType CT) {
+  cxtu::CXTULock Lock(GetTU(CT));
   if (CT.kind == CXType_Invalid)
     return CT;
 
@@ -310,6 +314,7 @@ unsigned clang_isRestrictQualifiedType(CXType CT) {
 }
 
 CXType clang_getPointeeType(CXType CT) {
+  cxtu::CXTULock Lock(GetTU(CT));
   QualType T = GetQualType(CT);
   const Type *TP = T.getTypePtrOrNull();
   
@@ -338,6 +343,7 @@ CXType clang_getPointeeType(CXType CT) {
 }
 
 CXCursor clang_getTypeDeclaration(CXType CT) {
+  cxtu::CXTULock Lock(GetTU(CT));
   if (CT.kind == CXType_Invalid)
     return cxcursor::MakeCXCursorInvalid(CXCursor_NoDeclFound);
 
@@ -504,6 +510,7 @@ int clang_getNumArgTypes(CXType X) {
 }
 
 CXType clang_getArgType(CXType X, unsigned i) {
+  cxtu::CXTULock Lock(GetTU(X));
   QualType T = GetQualType(X);
   if (T.isNull())
     return MakeCXType(QualType(), GetTU(X));
@@ -520,6 +527,7 @@ CXType clang_getArgType(CXType X, unsigned i) {
 }
 
 CXType clang_getResultType(CXType X) {
+  cxtu::CXTULock Lock(GetTU(X));
   QualType T = GetQualType(X);
   if (T.isNull())
     return MakeCXType(QualType(), GetTU(X));
@@ -531,6 +539,7 @@ CXType clang_getResultType(CXType X) {
 }
 
 CXType clang_getCursorResultType(CXCursor C) {
+  cxtu::CXTULock Lock(cxcursor::getCursorTU(C));
   if (clang_isDeclaration(C.kind)) {
     Decl *D = cxcursor::getCursorDecl(C);
     if (const ObjCMethodDecl *MD = dyn_cast_or_null<ObjCMethodDecl>(D))
@@ -543,6 +552,7 @@ CXType clang_getCursorResultType(CXCursor C) {
 }
 
 unsigned clang_isPODType(CXType X) {
+  cxtu::CXTULock Lock(GetTU(X));
   QualType T = GetQualType(X);
   if (T.isNull())
     return 0;
@@ -554,6 +564,7 @@ unsigned clang_isPODType(CXType X) {
 }
 
 CXType clang_getElementType(CXType CT) {
+  cxtu::CXTULock Lock(GetTU(CT));
   QualType ET = QualType();
   QualType T = GetQualType(CT);
   const Type *TP = T.getTypePtrOrNull();
@@ -597,6 +608,7 @@ long long clang_getNumElements(CXType CT) {
 }
 
 CXType clang_getArrayElementType(CXType CT) {
+  cxtu::CXTULock Lock(GetTU(CT));
   QualType ET = QualType();
   QualType T = GetQualType(CT);
   const Type *TP = T.getTypePtrOrNull();
@@ -631,6 +643,7 @@ long long clang_getArraySize(CXType CT) {
 }
 
 CXString clang_getDeclObjCTypeEncoding(CXCursor C) {
+  cxtu::CXTULock Lock(cxcursor::getCursorTU(C));
   if (!clang_isDeclaration(C.kind))
     return cxstring::createCXString("");
 
@@ -26,10 +26,21 @@
 #include "clang/Lex/PPConditionalDirectiveRecord.h"
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Sema/SemaConsumer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/config.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
 
 using namespace clang;
 using namespace cxstring;
@@ -49,7 +60,11 @@ namespace {
 // FIXME: On windows it is disabled since current implementation depends on
 // file inodes.
 
-class SessionSkipBodyData { };
+class SessionSkipBodyData {
+public:
+  bool load(StringRef Path) { return true; }
+  bool save(StringRef Path) { return true; }
+};
 
 class TUSkipBodyControl {
 public:
@@ -163,8 +178,118 @@ public:
     llvm::MutexGuard MG(Mux);
     ParsedRegions.insert(Regions.begin(), Regions.end());
   }
+
+  /// \brief Merge the regions stored in the file at \p Path into the session.
+  ///
+  /// \returns true if the file could not be read or is not a valid region
+  /// file, in which case the session is left unchanged.
+  bool load(StringRef Path);
+
+  /// \brief Write the regions of the session to the file at \p Path.
+  ///
+  /// \returns true if an error occurred.
+  bool save(StringRef Path);
 };
 
+//===----------------------------------------------------------------------===//
+// Skipped regions on disk
+//===----------------------------------------------------------------------===//
+
+// The on-disk form is a small header followed by one fixed-size record per
+// region, in host byte order; it is a cache local to the machine that wrote
+// it.  Regions are keyed by device, inode and modification time, so records
+// for files that have since changed are simply never matched again.
+
+static const char SkipBodiesMagic[4] = { 'C', 'X', 'S', 'B' };
+static const uint32_t SkipBodiesVersion = 1;
+
+struct OnDiskPPRegion {
+  uint64_t Dev, Ino, ModTime, Offset;
+};
+
+bool SessionSkipBodyData::load(StringRef Path) {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::MemoryBuffer::getFile(Path, Buffer))
+    return true;
+
+  const char *Ptr = Buffer->getBufferStart();
+  size_t Size = Buffer->getBufferSize();
+  const size_t HeaderSize = sizeof(SkipBodiesMagic) + 2 * sizeof(uint32_t);
+  if (Size < HeaderSize ||
+      memcmp(Ptr, SkipBodiesMagic, sizeof(SkipBodiesMagic)) != 0)
+    return true;
+  Ptr += sizeof(SkipBodiesMagic);
+
+  uint32_t Version, NumRegions;
+  memcpy(&Version, Ptr, sizeof(Version));
+  memcpy(&NumRegions, Ptr + sizeof(Version), sizeof(NumRegions));
+  Ptr += 2 * sizeof(uint32_t);
+  if (Version != SkipBodiesVersion ||
+      (Size - HeaderSize) / sizeof(OnDiskPPRegion) != NumRegions ||
+      (Size - HeaderSize) % sizeof(OnDiskPPRegion) != 0)
+    return true;
+
+  SmallVector<PPRegion, 64> Regions;
+  Regions.reserve(NumRegions);
+  for (uint32_t I = 0; I != NumRegions; ++I, Ptr += sizeof(OnDiskPPRegion)) {
+    OnDiskPPRegion R;
+    memcpy(&R, Ptr, sizeof(R));
+    PPRegion Region(R.Dev, R.Ino, R.Offset, R.ModTime);
+    // Don't let a damaged file smuggle in the set's reserved keys.
+    if (Region.isInvalid() ||
+        Region == llvm::DenseMapInfo<PPRegion>::getEmptyKey() ||
+        Region == llvm::DenseMapInfo<PPRegion>::getTombstoneKey())
+      continue;
+    Regions.push_back(Region);
+  }
+
+  update(Regions);
+  return false;
+}
+
+bool SessionSkipBodyData::save(StringRef Path) {
+  std::vector<PPRegion> Regions;
+  {
+    llvm::MutexGuard MG(Mux);
+    Regions.assign(ParsedRegions.begin(), ParsedRegions.end());
+  }
+
+  // Write to a temporary file and rename it into place, so that concurrent
+  // readers never observe a partially written file.
+  SmallString<128> TempPath;
+  TempPath = Path;
+  TempPath += "-%%%%%%%%";
+  int FD;
+  if (llvm::sys::fs::unique_file(TempPath.str(), FD, TempPath,
+                                 /*makeAbsolute=*/false))
+    return true;
+
+  llvm::raw_fd_ostream Out(FD, /*shouldClose=*/true);
+  uint32_t NumRegions = Regions.size();
+  Out.write(SkipBodiesMagic, sizeof(SkipBodiesMagic));
+  Out.write(reinterpret_cast<const char *>(&SkipBodiesVersion),
+            sizeof(SkipBodiesVersion));
+  Out.write(reinterpret_cast<const char *>(&NumRegions), sizeof(NumRegions));
+  for (unsigned I = 0, N = Regions.size(); I != N; ++I) {
+    OnDiskPPRegion R;
+    R.Dev = Regions[I].getDev();
+    R.Ino = Regions[I].getIno();
+    R.ModTime = Regions[I].getModTime();
+    R.Offset = Regions[I].getOffset();
+    Out.write(reinterpret_cast<const char *>(&R), sizeof(R));
+  }
+  Out.close();
+
+  bool Failed = Out.has_error();
+  Out.clear_error();
+  if (Failed || llvm::sys::fs::rename(TempPath.str(), Path)) {
+    bool Existed;
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+    return true;
+  }
+  return false;
+}
+
 class TUSkipBodyControl {
   SessionSkipBodyData &SessionData;
   PPConditionalDirectiveRecord &PPRec;
@@ -484,6 +609,8 @@ struct IndexSourceFileInfo {
   unsigned num_unsaved_files;
   CXTranslationUnit *out_TU;
   unsigned TU_options;
+  /// \brief The resources path to use, or null to ask the CIndexer for it.
+  const char *resources_path;
   int result;
 };
 
@@ -514,6 +641,7 @@ static void clang_indexSourceFile_Impl(void *UserData) {
   unsigned num_unsaved_files = ITUI->num_unsaved_files;
   CXTranslationUnit *out_TU  = ITUI->out_TU;
   unsigned TU_options = ITUI->TU_options;
+  const char *resources_path = ITUI->resources_path;
   ITUI->result = 1; // init as error.
   
   if (out_TU)
@@ -655,12 +783,15 @@ static void clang_indexSourceFile_Impl(void *UserData) {
   if (!requestedToGetTU && !CInvok->getLangOpts()->Modules)
     PPOpts.DetailedRecord = false;
 
+  std::string ResourcesPath = resources_path ? std::string(resources_path)
+                                             : CXXIdx->getClangResourcesPath();
+
   DiagnosticErrorTrap DiagTrap(*Diags);
   bool Success = ASTUnit::LoadFromCompilerInvocationAction(CInvok.getPtr(), Diags,
                                                        IndexAction.get(),
                                                        Unit,
                                                        Persistent,
-                                                CXXIdx->getClangResourcesPath(),
+                                                       ResourcesPath,
                                                        OnlyLocalDecls,
                                                     /*CaptureDiagnostics=*/true,
                                                        PrecompilePreamble,
@@ -679,6 +810,54 @@ static void clang_indexSourceFile_Impl(void *UserData) {
   ITUI->result = 0; // success.
 }
 
+/// \brief Runs clang_indexSourceFile_Impl under crash recovery, reporting a
+/// crash on stderr, and returns its result.
+static int indexSourceFileSafely(IndexSourceFileInfo &ITUI) {
+  const char *source_filename = ITUI.source_filename;
+  const char *const *command_line_args = ITUI.command_line_args;
+  int num_command_line_args = ITUI.num_command_line_args;
+  struct CXUnsavedFile *unsaved_files = ITUI.unsaved_files;
+  unsigned num_unsaved_files = ITUI.num_unsaved_files;
+  CXTranslationUnit *out_TU = ITUI.out_TU;
+  unsigned TU_options = ITUI.TU_options;
+
+  if (getenv("LIBCLANG_NOTHREADS")) {
+    clang_indexSourceFile_Impl(&ITUI);
+    return ITUI.result;
+  }
+
+  llvm::CrashRecoveryContext CRC;
+
+  if (!RunSafely(CRC, clang_indexSourceFile_Impl, &ITUI)) {
+    fprintf(stderr, "libclang: crash detected during indexing source file: {\n");
+    fprintf(stderr, "  'source_filename' : '%s'\n", source_filename);
+    fprintf(stderr, "  'command_line_args' : [");
+    for (int i = 0; i != num_command_line_args; ++i) {
+      if (i)
+        fprintf(stderr, ", ");
+      fprintf(stderr, "'%s'", command_line_args[i]);
+    }
+    fprintf(stderr, "],\n");
+    fprintf(stderr, "  'unsaved_files' : [");
+    for (unsigned i = 0; i != num_unsaved_files; ++i) {
+      if (i)
+        fprintf(stderr, ", ");
+      fprintf(stderr, "('%s', '...', %ld)", unsaved_files[i].Filename,
+              unsaved_files[i].Length);
+    }
+    fprintf(stderr, "],\n");
+    fprintf(stderr, "  'options' : %d,\n", TU_options);
+    fprintf(stderr, "}\n");
+    
+    return 1;
+  } else if (getenv("LIBCLANG_RESOURCE_USAGE")) {
+    if (out_TU)
+      PrintLibclangResourceUsage(*out_TU);
+  }
+  
+  return ITUI.result;
+}
+
 //===----------------------------------------------------------------------===//
 // clang_indexTranslationUnit Implementation
 //===----------------------------------------------------------------------===//
@@ -784,7 +963,9 @@ static void clang_indexTranslationUnit_Impl(void *UserData) {
   llvm::CrashRecoveryContextCleanupRegistrar<IndexingConsumer>
     IndexConsumerCleanup(IndexConsumer.get());
 
-  ASTUnit *Unit = static_cast<ASTUnit *>(TU->TUData);
+  // clang_indexTranslationUnit() holds the lock for us.
+  CXTULockBorrow Borrow(TU);
+  ASTUnit *Unit = getASTUnit(TU);
   if (!Unit)
     return;
 
@@ -809,6 +990,127 @@ static void clang_indexTranslationUnit_Impl(void *UserData) {
   ITUI->result = 0;
 }
 
+//===----------------------------------------------------------------------===//
+// clang_indexSourceFiles Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// \brief The work shared by the workers of a clang_indexSourceFiles call.
+///
+/// Workers pull the next unindexed command from a shared cursor, so a worker
+/// that finishes a small TU immediately moves on to the next one.
+struct IndexSourceFilesInfo {
+  CXIndexAction idxAction;
+  CXClientData *client_data;
+  IndexerCallbacks *index_callbacks;
+  unsigned index_callbacks_size;
+  unsigned index_options;
+  CXCompileCommands commands;
+  unsigned num_commands;
+  unsigned TU_options;
+  int *results;
+  /// \brief Computed once up front; CIndexer fills its copy in lazily and
+  /// without a lock, so the workers must not ask it.
+  std::string ResourcesPath;
+
+  llvm::sys::Mutex Mux;
+  unsigned NextCommand;
+  bool Failed;
+
+  IndexSourceFilesInfo() : Mux(/*recursive=*/false), NextCommand(0),
+                           Failed(false) {}
+};
+
+struct IndexSourceFilesWorker {
+  IndexSourceFilesInfo *Batch;
+  unsigned WorkerIdx;
+};
+
+} // anonymous namespace
+
+static int indexCompileCommand(IndexSourceFilesInfo &Batch, unsigned WorkerIdx,
+                               CXCompileCommand Cmd) {
+  unsigned NumArgs = clang_CompileCommand_getNumArgs(Cmd);
+  if (NumArgs == 0)
+    return 1;
+
+  SmallVector<CXString, 32> ArgStrs;
+  for (unsigned I = 0; I != NumArgs; ++I)
+    ArgStrs.push_back(clang_CompileCommand_getArg(Cmd, I));
+  CXString Dir = clang_CompileCommand_getDirectory(Cmd);
+
+  // The process has a single current directory, so hand the command's
+  // directory to the frontend instead of chdir'ing into it.
+  SmallVector<const char *, 32> Args;
+  Args.push_back(clang_getCString(ArgStrs[0]));
+  const char *DirStr = clang_getCString(Dir);
+  if (DirStr && *DirStr) {
+    Args.push_back("-working-directory");
+    Args.push_back(DirStr);
+  }
+  for (unsigned I = 1; I != NumArgs; ++I)
+    Args.push_back(clang_getCString(ArgStrs[I]));
+
+  IndexSourceFileInfo ITUI = { Batch.idxAction, Batch.client_data[WorkerIdx],
+                               Batch.index_callbacks,
+                               Batch.index_callbacks_size, Batch.index_options,
+                               /*source_filename=*/0, Args.data(),
+                               static_cast<int>(Args.size()),
+                               /*unsaved_files=*/0, 0, /*out_TU=*/0,
+                               Batch.TU_options, Batch.ResourcesPath.c_str(),
+                               0 };
+  int Result = indexSourceFileSafely(ITUI);
+
+  clang_disposeString(Dir);
+  for (unsigned I = 0; I != NumArgs; ++I)
+    clang_disposeString(ArgStrs[I]);
+  return Result;
+}
+
+static void indexSourceFilesWorker_Impl(void *UserData) {
+  IndexSourceFilesWorker *Worker =
+    static_cast<IndexSourceFilesWorker *>(UserData);
+  IndexSourceFilesInfo &Batch = *Worker->Batch;
+
+  while (true) {
+    unsigned Idx;
+    {
+      llvm::MutexGuard MG(Batch.Mux);
+      if (Batch.NextCommand == Batch.num_commands)
+        break;
+      Idx = Batch.NextCommand++;
+    }
+
+    CXCompileCommand Cmd =
+      clang_CompileCommands_getCommand(Batch.commands, Idx);
+    int Result = indexCompileCommand(Batch, Worker->WorkerIdx, Cmd);
+    if (Batch.results)
+      Batch.results[Idx] = Result;
+    if (Result) {
+      llvm::MutexGuard MG(Batch.Mux);
+      Batch.Failed = true;
+    }
+  }
+}
+
+/// \brief Runs one worker of a clang_indexSourceFiles call.
+///
+/// Each TU is already indexed under its own crash recovery context; this one
+/// catches a crash in the worker itself, which fails the batch instead of
+/// taking down the host.
+static void *indexSourceFilesWorker(void *UserData) {
+  llvm::CrashRecoveryContext CRC;
+  if (!CRC.RunSafely(indexSourceFilesWorker_Impl, UserData)) {
+    IndexSourceFilesInfo &Batch =
+      *static_cast<IndexSourceFilesWorker *>(UserData)->Batch;
+    fprintf(stderr, "libclang: crash detected in indexing worker\n");
+    llvm::MutexGuard MG(Batch.Mux);
+    Batch.Failed = true;
+  }
+  return 0;
+}
+
 //===----------------------------------------------------------------------===//
 // libclang public APIs.
 //===----------------------------------------------------------------------===//
@@ -956,6 +1258,22 @@ void clang_IndexAction_dispose(CXIndexAction idxAction) {
     delete static_cast<IndexSessionData *>(idxAction);
 }
 
+int clang_IndexAction_loadSkippedBodies(CXIndexAction idxAction,
+                                        const char *path) {
+  if (!idxAction || !path)
+    return 1;
+  IndexSessionData *IdxSession = static_cast<IndexSessionData *>(idxAction);
+  return IdxSession->SkipBodyData->load(path);
+}
+
+int clang_IndexAction_saveSkippedBodies(CXIndexAction idxAction,
+                                        const char *path) {
+  if (!idxAction || !path)
+    return 1;
+  IndexSessionData *IdxSession = static_cast<IndexSessionData *>(idxAction);
+  return IdxSession->SkipBodyData->save(path);
+}
+
 int clang_indexSourceFile(CXIndexAction idxAction,
                           CXClientData client_data,
                           IndexerCallbacks *index_callbacks,
@@ -973,43 +1291,72 @@ int clang_indexSourceFile(CXIndexAction idxAction,
                                index_callbacks_size, index_options,
                                source_filename, command_line_args,
                                num_command_line_args, unsaved_files,
-                               num_unsaved_files, out_TU, TU_options, 0 };
+                               num_unsaved_files, out_TU, TU_options,
+                               /*resources_path=*/0, 0 };
 
-  if (getenv("LIBCLANG_NOTHREADS")) {
-    clang_indexSourceFile_Impl(&ITUI);
-    return ITUI.result;
-  }
+  return indexSourceFileSafely(ITUI);
+}
 
-  llvm::CrashRecoveryContext CRC;
+int clang_indexSourceFiles(CXIndexAction idxAction,
+                           CXClientData *client_data,
+                           unsigned num_threads,
+                           IndexerCallbacks *index_callbacks,
+                           unsigned index_callbacks_size,
+                           unsigned index_options,
+                           CXCompileCommands commands,
+                           unsigned TU_options,
+                           int *results) {
+  if (!idxAction || !client_data || !commands)
+    return 1;
 
-  if (!RunSafely(CRC, clang_indexSourceFile_Impl, &ITUI)) {
-    fprintf(stderr, "libclang: crash detected during indexing source file: {\n");
-    fprintf(stderr, "  'source_filename' : '%s'\n", source_filename);
-    fprintf(stderr, "  'command_line_args' : [");
-    for (int i = 0; i != num_command_line_args; ++i) {
-      if (i)
-        fprintf(stderr, ", ");
-      fprintf(stderr, "'%s'", command_line_args[i]);
-    }
-    fprintf(stderr, "],\n");
-    fprintf(stderr, "  'unsaved_files' : [");
-    for (unsigned i = 0; i != num_unsaved_files; ++i) {
-      if (i)
-        fprintf(stderr, ", ");
-      fprintf(stderr, "('%s', '...', %ld)", unsaved_files[i].Filename,
-              unsaved_files[i].Length);
+  IndexSourceFilesInfo Batch;
+  Batch.idxAction = idxAction;
+  Batch.client_data = client_data;
+  Batch.index_callbacks = index_callbacks;
+  Batch.index_callbacks_size = index_callbacks_size;
+  Batch.index_options = index_options;
+  Batch.commands = commands;
+  Batch.num_commands = clang_CompileCommands_getSize(commands);
+  Batch.TU_options = TU_options;
+  Batch.results = results;
+  IndexSessionData *IdxSession = static_cast<IndexSessionData *>(idxAction);
+  Batch.ResourcesPath =
+    static_cast<CIndexer *>(IdxSession->CIdx)->getClangResourcesPath();
+
+  if (num_threads == 0)
+    num_threads = 1;
+  if (num_threads > Batch.num_commands)
+    num_threads = std::max(Batch.num_commands, 1U);
+
+  std::vector<IndexSourceFilesWorker> Workers(num_threads);
+  for (unsigned I = 0; I != num_threads; ++I) {
+    Workers[I].Batch = &Batch;
+    Workers[I].WorkerIdx = I;
+  }
+
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+  // The calling thread acts as worker 0; spawn the rest.  If a thread can't
+  // be created, the remaining workers simply pick up its share.
+  // llvm_execute_on_thread joins the thread before returning, so it can't run
+  // the workers side by side; each TU still gets its own safety thread from
+  // RunSafely.
+  std::vector<pthread_t> Threads;
+  if (!getenv("LIBCLANG_NOTHREADS")) {
+    for (unsigned I = 1; I != num_threads; ++I) {
+      pthread_t Thread;
+      if (::pthread_create(&Thread, 0, indexSourceFilesWorker, &Workers[I]))
+        break;
+      Threads.push_back(Thread);
     }
-    fprintf(stderr, "],\n");
-    fprintf(stderr, "  'options' : %d,\n", TU_options);
-    fprintf(stderr, "}\n");
-    
-    return 1;
-  } else if (getenv("LIBCLANG_RESOURCE_USAGE")) {
-    if (out_TU)
-      PrintLibclangResourceUsage(*out_TU);
   }
-  
-  return ITUI.result;
+  indexSourceFilesWorker(&Workers[0]);
+  for (unsigned I = 0, N = Threads.size(); I != N; ++I)
+    ::pthread_join(Threads[I], 0);
+#else
+  indexSourceFilesWorker(&Workers[0]);
+#endif
+
+  return Batch.Failed;
 }
 
 int clang_indexTranslationUnit(CXIndexAction idxAction,
@@ -1022,6 +1369,7 @@ int clang_indexTranslationUnit(CXIndexAction idxAction,
   IndexTranslationUnitInfo ITUI = { idxAction, client_data, index_callbacks,
                                     index_callbacks_size, index_options, TU,
                                     0 };
+  CXTULock Lock(TU);
 
   if (getenv("LIBCLANG_NOTHREADS")) {
     clang_indexTranslationUnit_Impl(&ITUI);
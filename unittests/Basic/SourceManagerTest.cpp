@@ -159,6 +159,44 @@ TEST_F(SourceManagerTest, getColumnNumber) {
   EXPECT_EQ(1U, SourceMgr.getColumnNumber(MainFileID, 0, NULL));
 }
 
+TEST_F(SourceManagerTest, getFileIDAlternatingLookups) {
+  const char *Source = "int x;\nint y;\nint z;\n";
+  FileID MainFileID =
+    SourceMgr.createMainFileIDForMemBuffer(MemoryBuffer::getMemBuffer(Source));
+  SourceLocation MainStart = SourceMgr.getLocForStartOfFile(MainFileID);
+
+  // Interleave a number of files and expansions so that lookups bounce
+  // between entries that are far apart in the table.
+  std::vector<SourceLocation> Locs;
+  std::vector<FileID> FIDs;
+  for (unsigned I = 0; I != 100; ++I) {
+    SourceLocation Loc;
+    if (I % 3 == 0) {
+      FileID FID = SourceMgr.createFileIDForMemBuffer(
+                                          MemoryBuffer::getMemBuffer(Source));
+      Loc = SourceMgr.getLocForStartOfFile(FID).getLocWithOffset(I % 7);
+    } else {
+      Loc = SourceMgr.createExpansionLoc(MainStart, MainStart, MainStart, 3);
+    }
+    Locs.push_back(Loc);
+    FIDs.push_back(SourceMgr.getFileID(Loc));
+  }
+
+  for (unsigned Round = 0; Round != 3; ++Round) {
+    for (unsigned I = 0; I != Locs.size(); ++I) {
+      unsigned Idx = (I * 37 + Round) % Locs.size();
+      EXPECT_EQ(FIDs[Idx], SourceMgr.getFileID(Locs[Idx]));
+      EXPECT_EQ(MainFileID, SourceMgr.getFileID(MainStart.getLocWithOffset(5)));
+    }
+  }
+
+  // Entries created after the cache was populated must still be found.
+  SourceLocation Late =
+    SourceMgr.createExpansionLoc(MainStart, MainStart, MainStart, 3);
+  EXPECT_NE(SourceMgr.getFileID(Locs.back()), SourceMgr.getFileID(Late));
+  EXPECT_EQ(FIDs.back(), SourceMgr.getFileID(Locs.back()));
+}
+
 #if defined(LLVM_ON_UNIX)
 
 TEST_F(SourceManagerTest, getMacroArgExpandedLocation) {